@@ -0,0 +1,437 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+/**
+ * benchmarks of 3dfier, see README.md
+ * each benchmark runs once to warm up and then --runs times, the median, the
+ * spread and the throughput are printed so runs can be compared
+ */
+
+#include "definitions.h"
+#include "geomtools.h"
+#include "io.h"
+#include "Map3d.h"
+#include "boost/chrono.hpp"
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+#include <cpl_vsi.h>
+#include <cpl_conv.h>
+#include <functional>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//-- a Terrain with the protected point tests of TopoFeature made public
+class BenchTerrain : public Terrain {
+public:
+  BenchTerrain(char *wkt) : Terrain(wkt, "bench", AttributeMap(), "bench", 0, 0, 0) {}
+  using TopoFeature::point_in_polygon;
+  using TopoFeature::within_range;
+};
+
+//-- options of the run
+static int RUNS = 7;
+static int SIZE = 100;
+static double DENSITY = 4;
+static std::string FILTER;
+
+//-- results are added here so the loops that are measured are not optimised away
+static volatile double SINK = 0;
+
+static double seconds_of(const std::function<void()>& fn) {
+  auto start = boost::chrono::steady_clock::now();
+  fn();
+  return boost::chrono::duration<double>(boost::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * run a benchmark, once() returns the seconds of the part that is measured so
+ * the setup of each run is not counted; items are processed in each run
+ */
+static void bench(const std::string& name, double items, const std::function<double()>& once) {
+  if (FILTER.empty() == false && name.find(FILTER) == std::string::npos)
+    return;
+  once();
+  std::vector<double> seconds;
+  for (int i = 0; i < RUNS; i++)
+    seconds.push_back(once());
+  std::sort(seconds.begin(), seconds.end());
+  double median = (seconds.size() % 2 == 1) ? seconds[seconds.size() / 2] :
+    (seconds[seconds.size() / 2 - 1] + seconds[seconds.size() / 2]) / 2;
+  double mean = 0;
+  for (auto& s : seconds)
+    mean += s;
+  mean /= seconds.size();
+  double variance = 0;
+  for (auto& s : seconds)
+    variance += (s - mean) * (s - mean);
+  variance /= std::max<std::size_t>(1, seconds.size() - 1);
+  printf("%-32s %11.3f ms  +/- %5.1f%%  [%.3f .. %.3f]  %14.0f items/s\n", name.c_str(),
+    median * 1000, mean > 0 ? 100 * std::sqrt(variance) / mean : 0.0,
+    seconds.front() * 1000, seconds.back() * 1000, median > 0 ? items / median : 0.0);
+  fflush(stdout);
+}
+
+/**
+ * WKT of a circle with n vertices around (cx, cy)
+ */
+static std::string circle_wkt(int n, double cx, double cy, double r) {
+  TextWriter wkt;
+  wkt << std::setprecision(3) << std::fixed << "POLYGON((";
+  for (int i = 0; i <= n; i++) {
+    double a = 2 * M_PI * (i % n) / n;
+    if (i > 0)
+      wkt << ",";
+    wkt << cx + r * std::cos(a) << " " << cy + r * std::sin(a);
+  }
+  wkt << "))";
+  return wkt.str();
+}
+
+static std::vector<Point2> random_points(std::size_t n, double xmin, double ymin, double xmax, double ymax) {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> x(xmin, xmax), y(ymin, ymax);
+  std::vector<Point2> pts;
+  for (std::size_t i = 0; i < n; i++)
+    pts.push_back(Point2(x(gen), y(gen)));
+  return pts;
+}
+
+//-- the synthetic tessellation: cells of 10 m, rows of road, water, buildings and terrain in between
+static const double CELL = 10;
+static const double X0 = 85000;
+static const double Y0 = 445000;
+
+static std::string cell_class(int i, int j) {
+  if (j % 5 == 0)
+    return "Road";
+  if (i % 7 == 3 && j % 5 == 2)
+    return "Water";
+  if ((i + j) % 2 == 0)
+    return "Building";
+  return "Terrain";
+}
+
+/**
+ * writes the polygons of the tessellation of size x size cells in a GeoJSON in
+ * /vsimem per class, the edges of the cells have 4 segments shared by neighbours
+ */
+static std::vector<PolygonFile> synthetic_polygons(int size) {
+  const char* classes[] = { "Building", "Road", "Water", "Terrain" };
+  std::vector<PolygonFile> files;
+  for (auto& c : classes) {
+    TextWriter json;
+    json << std::setprecision(3) << std::fixed;
+    json << "{\"type\":\"FeatureCollection\",\"name\":\"" << c << "\",\"features\":[";
+    bool first = true;
+    for (int i = 0; i < size; i++) {
+      for (int j = 0; j < size; j++) {
+        if (cell_class(i, j) != c)
+          continue;
+        json << (first ? "" : ",") << "{\"type\":\"Feature\",\"properties\":{\"id\":\"" << c << "." << i << "." << j << "\"},";
+        json << "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[";
+        double x = X0 + i * CELL, y = Y0 + j * CELL;
+        double corners[5][2] = { {x, y}, {x + CELL, y}, {x + CELL, y + CELL}, {x, y + CELL}, {x, y} };
+        for (int k = 0; k < 4; k++) {
+          for (int s = 0; s < 4; s++) {
+            double t = s / 4.0;
+            json << (k + s == 0 ? "" : ",") << "[" << corners[k][0] + t * (corners[k + 1][0] - corners[k][0])
+              << "," << corners[k][1] + t * (corners[k + 1][1] - corners[k][1]) << "]";
+          }
+        }
+        json << ",[" << x << "," << y << "]]]}}";
+        first = false;
+      }
+    }
+    json << "]}";
+    std::string filename = std::string("/vsimem/3dfier_bench_") + c + ".geojson";
+    GByte* data = (GByte*)CPLMalloc(json.str().size());
+    memcpy(data, json.str().data(), json.str().size());
+    VSIFCloseL(VSIFileFromMemBuffer(filename.c_str(), data, json.str().size(), TRUE));
+    PolygonFile file;
+    file.filename = filename;
+    file.idfield = "id";
+    file.heightfield = "";
+    file.handle_multiple_heights = false;
+    file.layers.emplace_back(c, c);
+    files.push_back(file);
+  }
+  return files;
+}
+
+/**
+ * gives the points of the tessellation at DENSITY per m2 to the map, buildings
+ * are 10 to 16 m high, the terrain slopes gently and there is 5 cm of noise
+ */
+static unsigned long add_synthetic_points(Map3d& map3d, int size) {
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> u(0, 1);
+  std::normal_distribution<double> noise(0, 0.05);
+  unsigned long n = (unsigned long)(DENSITY * size * size * CELL * CELL);
+  std::vector<double> xs(n), ys(n), zs(n);
+  std::vector<unsigned char> classes(n);
+  for (unsigned long k = 0; k < n; k++) {
+    double x = u(gen) * size * CELL;
+    double y = u(gen) * size * CELL;
+    int i = std::min(size - 1, int(x / CELL));
+    int j = std::min(size - 1, int(y / CELL));
+    std::string c = cell_class(i, j);
+    double z = 0.5 * std::sin(x / 50) + 0.3 * std::cos(y / 70) + noise(gen);
+    classes[k] = 2;
+    if (c == "Building") {
+      z += 10 + (i % 3) * 3;
+      classes[k] = 6;
+    }
+    else if (c == "Water") {
+      z = -0.5 + noise(gen);
+      classes[k] = 9;
+    }
+    xs[k] = X0 + x;
+    ys[k] = Y0 + y;
+    zs[k] = z;
+  }
+  PointBatch points;
+  points.x = xs.data();
+  points.y = ys.data();
+  points.z = zs.data();
+  points.classification = classes.data();
+  points.size = n;
+  map3d.add_points(points);
+  return n;
+}
+
+/**
+ * reads the synthetic polygons and points in map3d, up to the R-tree if
+ * points is false, the 3dfying and CDT are left to the benchmarks
+ */
+static void load_synthetic(Map3d& map3d, int size, bool points = true) {
+  std::vector<PolygonFile> files = synthetic_polygons(size);
+  map3d.add_polygons_files(files);
+  map3d.save_building_variables();
+  map3d.construct_rtree();
+  if (points)
+    add_synthetic_points(map3d, size);
+}
+
+static void micro_benchmarks() {
+  printf("--- micro benchmarks\n");
+  std::string wkt = circle_wkt(1000, 0, 0, 100);
+  BenchTerrain feature(&wkt[0]);
+  std::vector<Point2> pts = random_points(100000, -100, -100, 100, 100);
+  bench("point_in_polygon", pts.size(), [&]() {
+    int inside = 0;
+    double s = seconds_of([&]() {
+      for (auto& p : pts)
+        inside += feature.point_in_polygon(p);
+    });
+    SINK += inside;
+    return s;
+  });
+  bench("within_range", pts.size(), [&]() {
+    int within = 0;
+    double s = seconds_of([&]() {
+      for (auto& p : pts)
+        within += feature.within_range(p, 1.0);
+    });
+    SINK += within;
+    return s;
+  });
+
+  std::vector<Point3> pts3;
+  for (auto& p : pts)
+    pts3.push_back(Point3(bg::get<0>(p) + X0, bg::get<1>(p) + Y0, 1.234));
+  bench("gen_key_bucket", pts3.size(), [&]() {
+    std::size_t total = 0;
+    double s = seconds_of([&]() {
+      for (auto& p : pts3)
+        total += gen_key_bucket(&p).size();
+    });
+    SINK += total;
+    return s;
+  });
+
+  //-- points inside the circle for the triangulations
+  std::vector<Point3> lidarpts;
+  std::mt19937 gen(3);
+  std::normal_distribution<double> noise(0, 0.3);
+  for (auto& p : pts) {
+    if (feature.point_in_polygon(p))
+      lidarpts.push_back(Point3(bg::get<0>(p), bg::get<1>(p), noise(gen)));
+  }
+  Polygon2* pgn = feature.get_Polygon2();
+  std::vector< std::vector<int> > z(1, std::vector<int>(pgn->outer().size(), 0));
+  bench("getCDT", lidarpts.size(), [&]() {
+    std::vector< std::pair<Point3, std::string> > vertices;
+    std::vector<Triangle> triangles;
+    return seconds_of([&]() { getCDT(pgn, z, vertices, triangles, lidarpts); });
+  });
+  //-- greedy_insert() is internal to geomtools, so the whole CDT is timed with it
+  bench("getCDT (tinsimp 0.5)", lidarpts.size(), [&]() {
+    std::vector< std::pair<Point3, std::string> > vertices;
+    std::vector<Triangle> triangles;
+    return seconds_of([&]() { getCDT(pgn, z, vertices, triangles, lidarpts, 0.5); });
+  });
+
+  //-- a road with outliers along its boundary, lifted without filtering first
+  std::vector<Point2> boundary = random_points(200000, -101, -101, 101, 101);
+  bench("detect_outliers", 1000, [&]() {
+    Road road(&wkt[0], "bench", AttributeMap(), "bench", 0.5, false, false, 0.2);
+    std::mt19937 g(5);
+    std::uniform_real_distribution<double> u(0, 1);
+    for (auto& p : boundary) {
+      Point2 q = p;
+      road.add_elevation_point(q, u(g) < 0.05 ? 5.0 : 0.1 * u(g), 1.0, 2, false);
+    }
+    road.lift();
+    return seconds_of([&]() { road.detect_outliers(false, 0.2); });
+  });
+
+  //-- stitch_one_vertex is measured with the stitching of the whole tessellation
+  bench("stitching (stitch_one_vertex)", double(SIZE) * SIZE, [&]() {
+    Map3d map3d;
+    load_synthetic(map3d, SIZE);
+    map3d.threeDfy(true);
+    return map3d.get_metrics().get_wall_seconds("stitching");
+  });
+}
+
+static void writer_benchmarks() {
+  printf("--- writers (%d x %d cells, in memory)\n", SIZE, SIZE);
+  Map3d map3d;
+  load_synthetic(map3d, SIZE);
+  map3d.threeDfy(true);
+  map3d.construct_CDT();
+  map3d.cleanup_elevations();
+  double n = map3d.get_num_polygons();
+  std::vector< std::pair< std::string, std::function<void(TextWriter&)> > > writers = {
+    { "CityGML", [&](TextWriter& of) { map3d.get_citygml(of); } },
+    { "CityGML-IMGeo", [&](TextWriter& of) { map3d.get_citygml_imgeo(of); } },
+    { "CityJSON", [&](TextWriter& of) { map3d.get_cityjson(of); } },
+    { "OBJ", [&](TextWriter& of) { map3d.get_obj_per_feature(of); } },
+    { "OBJ-NoID", [&](TextWriter& of) { map3d.get_obj_per_class(of); } },
+    { "STL", [&](TextWriter& of) { map3d.get_stl(of); } },
+    { "STL-binary", [&](TextWriter& of) { map3d.get_stl_binary(of); } },
+    { "GLB", [&](TextWriter& of) { map3d.get_gltf(of, "", true); } },
+    { "CSV-BUILDINGS", [&](TextWriter& of) { map3d.get_csv_buildings(of); } },
+    { "PostGIS-COPY", [&](TextWriter& of) { map3d.get_postgis_copy(of); } },
+  };
+  for (auto& w : writers) {
+    bench("write " + w.first, n, [&]() {
+      TextWriter of;
+      return seconds_of([&]() { w.second(of); });
+    });
+  }
+}
+
+static void end_to_end_benchmarks(const std::vector<std::string>& configs, const std::string& exe) {
+  printf("--- end to end\n");
+  for (int size : { SIZE / 4, SIZE / 2, SIZE }) {
+    if (size < 1)
+      continue;
+    bench("synthetic " + std::to_string(size) + "x" + std::to_string(size) + " to OBJ", double(size) * size, [&]() {
+      return seconds_of([&]() {
+        Map3d map3d;
+        load_synthetic(map3d, size);
+        map3d.threeDfy(true);
+        map3d.construct_CDT();
+        map3d.cleanup_elevations();
+        TextWriter of;
+        map3d.get_obj_per_feature(of);
+      });
+    });
+  }
+  //-- the configs are run with 3dfier in the folder of the config, like example_data
+  for (auto& config : configs) {
+    boost::filesystem::path p = boost::filesystem::absolute(config);
+    boost::filesystem::path out = boost::filesystem::temp_directory_path() / "3dfier_bench.obj";
+    std::string command = "cd \"" + p.parent_path().string() + "\" && \"" + exe + "\" \"" + p.filename().string() +
+      "\" --OBJ \"" + out.string() + "\"";
+#ifdef _WIN32
+    command += " > NUL 2>&1";
+#else
+    command += " > /dev/null 2>&1";
+#endif
+    bench(p.filename().string() + " to OBJ", 1, [&]() {
+      int status = 0;
+      double s = seconds_of([&]() { status = std::system(command.c_str()); });
+      if (status != 0)
+        std::cerr << "ERROR: failed: " << command << std::endl;
+      return s;
+    });
+  }
+}
+
+int main(int argc, const char * argv[]) {
+  std::vector<std::string> configs;
+  std::string exe;
+  namespace po = boost::program_options;
+  po::options_description pomain("Allowed options");
+  pomain.add_options()
+    ("help", "View all options")
+    ("runs", po::value<int>(&RUNS)->default_value(7), "Measured runs of each benchmark")
+    ("size", po::value<int>(&SIZE)->default_value(100), "Cells per side of the synthetic tessellation")
+    ("density", po::value<double>(&DENSITY)->default_value(4), "Points per m2 of the synthetic tessellation")
+    ("filter", po::value<std::string>(&FILTER), "Only the benchmarks with this in their name")
+    ("3dfier", po::value<std::string>(&exe), "3dfier executable for the configs")
+    ;
+  po::options_description pohidden("Hidden options");
+  pohidden.add_options()
+    ("config", po::value< std::vector<std::string> >(&configs), "YAML configs for end to end runs")
+    ;
+  po::positional_options_description popos;
+  popos.add("config", -1);
+  po::options_description poall;
+  poall.add(pomain).add(pohidden);
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).options(poall).positional(popos).run(), vm);
+    po::notify(vm);
+  }
+  catch (std::exception& e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  if (vm.count("help")) {
+    std::cout << "Usage: 3dfier_bench [options] [config.yml ...]" << std::endl;
+    std::cout << pomain << std::endl;
+    return EXIT_SUCCESS;
+  }
+  if (exe.empty()) {
+    exe = (boost::filesystem::absolute(argv[0]).parent_path() / "3dfier").string();
+  }
+  GDALAllRegister();
+  //-- the progress of 3dfier is not printed
+  std::clog.rdbuf(NULL);
+
+  printf("3dfier_bench: median of %d runs, spread (stddev / mean), min and max\n", RUNS);
+  micro_benchmarks();
+  writer_benchmarks();
+  end_to_end_benchmarks(configs, exe);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,722 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+/**
+ * generator of synthetic input for 3dfier, see README.md
+ * a city of blocks, roads, canals and bridges is written as polygon layers
+ * with shared boundaries like BGT, with the matching LAS/LAZ tiles and a
+ * config to 3dfy it
+ * the layout is a function of the position and the seed only, so the
+ * polygons are written one row of blocks at a time and the points of each
+ * tile are generated independently; any extent fits in memory
+ */
+
+#include <ogrsf_frmts.h>
+#include <lasreader.hpp>
+#include <laswriter.hpp>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//-- coordinates are integer centimetres, so shared vertices are exactly equal
+typedef long long Coord;
+struct Pt {
+  Coord x, y;
+  bool operator==(const Pt& o) const { return x == o.x && y == o.y; }
+};
+typedef std::vector<Pt> Ring;
+
+enum Layer { BUILDING, ROAD, WATER, TERRAIN, FOREST, BRIDGE, NLAYERS };
+static const char* LAYERNAMES[NLAYERS] = { "pand", "wegdeel", "waterdeel", "onbegroeidterreindeel", "begroeidterreindeel", "overbruggingsdeel" };
+
+struct Polygon {
+  Layer layer;
+  int level;
+  Ring ring;
+};
+
+//-- options of the run
+static double AREA = 1;
+static double DENSITY = 8;
+static int COMPLEXITY = 1;
+static int CANAL = 8;
+static int FLYOVER = 10;
+static int TILE = 1000;
+static unsigned long long SEED = 1;
+static double ORIGIN_X = 85000;
+static double ORIGIN_Y = 445000;
+
+//-- the layout in cm: block pitch, road width, depth of the parcels and of their front yard
+static Coord B = 10000;
+static Coord W = 1000;
+static Coord L = 9000;
+static Coord D = 2000;
+static const Coord F = 300;
+static int NB = 10;
+
+//-- heights in m of the water, of the bridge decks over the canals and of the two levels of flyovers
+static const double WATER_Z = -1.0;
+static const double DECK_Z[3] = { 1.5, 6.5, 11.5 };
+
+static unsigned long long mix(unsigned long long z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static unsigned long long hash(long long a, long long b, long long c, long long d = 0) {
+  return mix(mix(mix(mix(SEED ^ (unsigned long long)a) ^ (unsigned long long)b) ^ (unsigned long long)c) ^ (unsigned long long)d);
+}
+
+static Coord floor_div(Coord a, Coord b) {
+  return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+static bool block_exists(long long bx, long long by) {
+  return bx >= 0 && bx < NB && by >= 0 && by < NB;
+}
+
+//-- every CANAL-th column of blocks is water, the roads crossing it are bridges
+static bool is_canal(long long bx) {
+  return CANAL > 0 && bx >= 0 && bx < NB && (bx % CANAL) == CANAL - 1;
+}
+
+/**
+ * flyover at intersection (bx, by): level 1 is along the road in x and spans
+ * half of the road segments on both sides, level 2 is along the road in y
+ */
+static bool has_flyover(long long bx, long long by, int level) {
+  if (FLYOVER <= 0 || hash(bx, by, 7) % FLYOVER != 0)
+    return false;
+  if (bx < 1 || bx >= NB || by < 1 || by >= NB || is_canal(bx - 1) || is_canal(bx))
+    return false;
+  return level == 1 || hash(bx, by, 8) % 2 == 0;
+}
+
+//-- parcels along one side of a block, u along the side and v inwards from the road
+struct Parcel {
+  Coord u0, u1;
+  Coord height;
+  std::vector<Coord> depths;
+};
+
+static std::vector<Parcel> get_parcels(long long bx, long long by, int side) {
+  std::vector<Parcel> parcels;
+  Coord len = L - 2 * D;
+  Coord maxdepth = D - F - 200;
+  Coord u = 0;
+  for (int k = 0; u < len; k++) {
+    unsigned long long h = hash(bx, by, side, k);
+    Parcel p;
+    p.u0 = u;
+    p.u1 = u + (6 + h % 9) * 100;
+    if (len - p.u1 < 600)
+      p.u1 = len;
+    p.height = (2 + (h >> 32) % 5) * 300;
+    for (int i = 0; i < COMPLEXITY; i++)
+      p.depths.push_back(600 + (mix(h + i + 1) % ((maxdepth - 600) / 100 + 1)) * 100);
+    parcels.push_back(p);
+    u = p.u1;
+  }
+  return parcels;
+}
+
+//-- start of step i of the back of the building of a parcel
+static Coord step_u(const Parcel& p, int i) {
+  return p.u0 + (p.u1 - p.u0) * i / COMPLEXITY;
+}
+
+static Pt to_world(long long bx, long long by, int side, Coord u, Coord v) {
+  Coord ox = bx * B + W;
+  Coord oy = by * B + W;
+  switch (side) {
+  case 0: return { ox + D + u, oy + v };
+  case 1: return { ox + L - v, oy + D + u };
+  case 2: return { ox + L - D - u, oy + L - v };
+  default: return { ox + v, oy + L - D - u };
+  }
+}
+
+static void add_point(Ring& r, const Pt& p) {
+  if (r.empty() || !(r.back() == p))
+    r.push_back(p);
+}
+
+static Ring rectangle(Coord x0, Coord y0, Coord x1, Coord y1) {
+  return Ring{ { x0, y0 }, { x1, y0 }, { x1, y1 }, { x0, y1 } };
+}
+
+//-- vertices of a block on its edge along a road, empty for water and outside the extent
+static std::vector<Pt> get_edge_vertices(long long bx, long long by, int side) {
+  std::vector<Pt> pts;
+  if (!block_exists(bx, by) || is_canal(bx))
+    return pts;
+  pts.push_back(to_world(bx, by, side, -D, 0));
+  for (auto& p : get_parcels(bx, by, side))
+    pts.push_back(to_world(bx, by, side, p.u0, 0));
+  pts.push_back(to_world(bx, by, side, L - 2 * D, 0));
+  pts.push_back(to_world(bx, by, side, L - D, 0));
+  return pts;
+}
+
+//-- add a and the points strictly inside the axis-parallel edge a-b, ordered from a to b
+static void add_edge(Ring& r, const Pt& a, const Pt& b, const std::vector<Pt>& pts) {
+  add_point(r, a);
+  std::vector<Pt> inside;
+  for (auto& p : pts) {
+    if (a.y == b.y && p.y == a.y && p.x > std::min(a.x, b.x) && p.x < std::max(a.x, b.x))
+      inside.push_back(p);
+    else if (a.x == b.x && p.x == a.x && p.y > std::min(a.y, b.y) && p.y < std::max(a.y, b.y))
+      inside.push_back(p);
+  }
+  std::sort(inside.begin(), inside.end(), [&a](const Pt& p, const Pt& q) {
+    return std::abs(p.x - a.x) + std::abs(p.y - a.y) < std::abs(q.x - a.x) + std::abs(q.y - a.y);
+  });
+  for (auto& p : inside)
+    add_point(r, p);
+}
+
+/**
+ * insert in the edges of polygons [first, end) the vertices of the others
+ * that lie on them, so neighbours share all their boundary vertices and
+ * there are no T-junctions; all edges are parallel to the axes
+ */
+static void share_vertices(std::vector<Polygon>& polys, size_t first) {
+  std::unordered_map<Coord, std::vector<Pt>> onx, ony;
+  for (size_t i = first; i < polys.size(); i++) {
+    for (auto& p : polys[i].ring) {
+      onx[p.x].push_back(p);
+      ony[p.y].push_back(p);
+    }
+  }
+  for (size_t i = first; i < polys.size(); i++) {
+    Ring& ring = polys[i].ring;
+    Ring shared;
+    for (size_t j = 0; j < ring.size(); j++) {
+      const Pt& a = ring[j];
+      const Pt& b = ring[(j + 1) % ring.size()];
+      add_edge(shared, a, b, (a.x == b.x) ? onx[a.x] : ony[a.y]);
+    }
+    ring.swap(shared);
+  }
+}
+
+//-- the polygons of block (bx, by)
+static void add_block(std::vector<Polygon>& polys, long long bx, long long by) {
+  Coord ox = bx * B + W;
+  Coord oy = by * B + W;
+  if (is_canal(bx)) {
+    polys.push_back({ WATER, 0, rectangle(ox, oy, ox + L, oy + L) });
+    return;
+  }
+  size_t first = polys.size();
+  polys.push_back({ TERRAIN, 0, rectangle(ox, oy, ox + D, oy + D) });
+  polys.push_back({ TERRAIN, 0, rectangle(ox + L - D, oy, ox + L, oy + D) });
+  polys.push_back({ TERRAIN, 0, rectangle(ox + L - D, oy + L - D, ox + L, oy + L) });
+  polys.push_back({ TERRAIN, 0, rectangle(ox, oy + L - D, ox + D, oy + L) });
+  polys.push_back({ FOREST, 0, rectangle(ox + D, oy + D, ox + L - D, oy + L - D) });
+  for (int side = 0; side < 4; side++) {
+    for (auto& p : get_parcels(bx, by, side)) {
+      Polygon front = { TERRAIN, 0, Ring() };
+      add_point(front.ring, to_world(bx, by, side, p.u0, 0));
+      add_point(front.ring, to_world(bx, by, side, p.u1, 0));
+      add_point(front.ring, to_world(bx, by, side, p.u1, F));
+      add_point(front.ring, to_world(bx, by, side, p.u0, F));
+      polys.push_back(front);
+      //-- the back of the building is a staircase of COMPLEXITY steps, shared with the back yard
+      Polygon building = { BUILDING, 0, Ring() };
+      add_point(building.ring, to_world(bx, by, side, p.u0, F));
+      add_point(building.ring, to_world(bx, by, side, p.u1, F));
+      for (int i = COMPLEXITY - 1; i >= 0; i--) {
+        add_point(building.ring, to_world(bx, by, side, step_u(p, i + 1), F + p.depths[i]));
+        add_point(building.ring, to_world(bx, by, side, step_u(p, i), F + p.depths[i]));
+      }
+      polys.push_back(building);
+      Polygon yard = { FOREST, 0, Ring() };
+      for (int i = 0; i < COMPLEXITY; i++) {
+        add_point(yard.ring, to_world(bx, by, side, step_u(p, i), F + p.depths[i]));
+        add_point(yard.ring, to_world(bx, by, side, step_u(p, i + 1), F + p.depths[i]));
+      }
+      add_point(yard.ring, to_world(bx, by, side, p.u1, D));
+      add_point(yard.ring, to_world(bx, by, side, p.u0, D));
+      polys.push_back(yard);
+    }
+  }
+  share_vertices(polys, first);
+}
+
+//-- the road segment in x between the intersections (bx, by) and (bx + 1, by)
+static void add_road_x(std::vector<Polygon>& polys, long long bx, long long by) {
+  Coord x0 = bx * B + W, x1 = (bx + 1) * B;
+  Coord y0 = by * B, y1 = by * B + W;
+  Ring ring;
+  add_edge(ring, { x0, y0 }, { x1, y0 }, get_edge_vertices(bx, by - 1, 2));
+  add_edge(ring, { x1, y0 }, { x1, y1 }, std::vector<Pt>());
+  add_edge(ring, { x1, y1 }, { x0, y1 }, get_edge_vertices(bx, by, 0));
+  add_edge(ring, { x0, y1 }, { x0, y0 }, std::vector<Pt>());
+  if (is_canal(bx)) {
+    //-- as in BGT the water continues below the bridge deck
+    polys.push_back({ WATER, -1, ring });
+    polys.push_back({ BRIDGE, 0, ring });
+  }
+  else
+    polys.push_back({ ROAD, 0, ring });
+}
+
+//-- the road segment in y between the intersections (bx, by) and (bx, by + 1)
+static void add_road_y(std::vector<Polygon>& polys, long long bx, long long by) {
+  Coord x0 = bx * B, x1 = bx * B + W;
+  Coord y0 = by * B + W, y1 = (by + 1) * B;
+  Ring ring;
+  add_edge(ring, { x0, y0 }, { x1, y0 }, std::vector<Pt>());
+  add_edge(ring, { x1, y0 }, { x1, y1 }, get_edge_vertices(bx, by, 3));
+  add_edge(ring, { x1, y1 }, { x0, y1 }, std::vector<Pt>());
+  add_edge(ring, { x0, y1 }, { x0, y0 }, get_edge_vertices(bx - 1, by, 1));
+  polys.push_back({ ROAD, 0, ring });
+}
+
+//-- the intersection (bx, by) and its flyovers, which overlap the roads below
+static void add_intersection(std::vector<Polygon>& polys, long long bx, long long by) {
+  Coord x = bx * B, y = by * B;
+  polys.push_back({ ROAD, 0, rectangle(x, y, x + W, y + W) });
+  if (has_flyover(bx, by, 1))
+    polys.push_back({ BRIDGE, 1, rectangle(x - L / 2, y, x + W + L / 2, y + W) });
+  if (has_flyover(bx, by, 2))
+    polys.push_back({ BRIDGE, 2, rectangle(x, y - L / 2, x + W, y + W + L / 2) });
+}
+
+//-- the polygons of row by: the roads along its bottom and, except for the last row, its blocks
+static std::vector<Polygon> get_row(long long by) {
+  std::vector<Polygon> polys;
+  for (long long bx = 0; bx <= NB; bx++) {
+    add_intersection(polys, bx, by);
+    if (bx < NB)
+      add_road_x(polys, bx, by);
+    if (by < NB) {
+      add_road_y(polys, bx, by);
+      if (bx < NB)
+        add_block(polys, bx, by);
+    }
+  }
+  return polys;
+}
+
+static bool write_polygons(const std::string& filename, unsigned long long counts[NLAYERS]) {
+  if (GDALGetDriverCount() == 0)
+    GDALAllRegister();
+  GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("GPKG");
+  if (driver == NULL) {
+    std::cerr << "ERROR: GDAL driver GPKG not available.\n";
+    return false;
+  }
+  GDALDataset* dataSource = driver->Create(filename.c_str(), 0, 0, 0, GDT_Unknown, NULL);
+  if (dataSource == NULL) {
+    std::cerr << "ERROR: could not create " << filename << std::endl;
+    return false;
+  }
+  OGRSpatialReference srs;
+  srs.importFromEPSG(28992);
+  OGRLayer* layers[NLAYERS];
+  for (int i = 0; i < NLAYERS; i++) {
+    layers[i] = dataSource->CreateLayer(LAYERNAMES[i], &srs, wkbPolygon, NULL);
+    if (layers[i] == NULL) {
+      std::cerr << "ERROR: could not create layer " << LAYERNAMES[i] << std::endl;
+      GDALClose(dataSource);
+      return false;
+    }
+    OGRFieldDefn oField("gml_id", OFTString);
+    OGRFieldDefn oLevel("relatievehoogteligging", OFTInteger);
+    layers[i]->CreateField(&oField);
+    layers[i]->CreateField(&oLevel);
+    counts[i] = 0;
+  }
+  for (long long by = 0; by <= NB; by++) {
+    dataSource->StartTransaction();
+    for (auto& poly : get_row(by)) {
+      OGRLinearRing ring;
+      for (auto& p : poly.ring)
+        ring.addPoint(ORIGIN_X + p.x / 100.0, ORIGIN_Y + p.y / 100.0, 0);
+      ring.closeRings();
+      OGRPolygon polygon;
+      polygon.addRing(&ring);
+      OGRFeature* f = OGRFeature::CreateFeature(layers[poly.layer]->GetLayerDefn());
+      std::string id = std::string(LAYERNAMES[poly.layer]) + "." + std::to_string(++counts[poly.layer]);
+      f->SetField("gml_id", id.c_str());
+      f->SetField("relatievehoogteligging", poly.level);
+      f->SetGeometry(&polygon);
+      OGRErr err = layers[poly.layer]->CreateFeature(f);
+      OGRFeature::DestroyFeature(f);
+      if (err != OGRERR_NONE) {
+        std::cerr << "ERROR: could not write " << id << std::endl;
+        dataSource->RollbackTransaction();
+        GDALClose(dataSource);
+        return false;
+      }
+    }
+    dataSource->CommitTransaction();
+  }
+  GDALClose(dataSource);
+  return true;
+}
+
+static double ground_z(double x, double y) {
+  return 0.3 * std::sin(x / 170.0) + 0.3 * std::cos(y / 230.0);
+}
+
+/**
+ * height and LAS class of the top surface at (x, y) in m from the lower-left
+ * corner, which is what is seen from above by the last return
+ */
+static void get_surface(double x, double y, double& z, int& c) {
+  thread_local long long cbx = -1, cby = -1;
+  thread_local int cside = -1;
+  thread_local std::vector<Parcel> parcels;
+  Coord cx = (Coord)std::floor(x * 100);
+  Coord cy = (Coord)std::floor(y * 100);
+  long long bx = floor_div(cx, B);
+  long long by = floor_div(cy, B);
+  Coord lx = cx - bx * B;
+  Coord ly = cy - by * B;
+  //-- the flyovers are above everything else
+  z = -1e9;
+  c = 26;
+  if (ly < W) {
+    for (long long i = bx; i <= bx + 1; i++)
+      if (has_flyover(i, by, 1) && cx >= i * B - L / 2 && cx < i * B + W + L / 2)
+        z = DECK_Z[1];
+  }
+  if (lx < W) {
+    for (long long i = by; i <= by + 1; i++)
+      if (has_flyover(bx, i, 2) && cy >= i * B - L / 2 && cy < i * B + W + L / 2)
+        z = DECK_Z[2];
+  }
+  if (z > -1e9)
+    return;
+  if (lx < W || ly < W) {
+    if (ly < W && lx >= W && is_canal(bx))
+      z = DECK_Z[0];
+    else {
+      z = ground_z(x, y);
+      c = 2;
+    }
+    return;
+  }
+  if (is_canal(bx)) {
+    z = WATER_Z;
+    c = 9;
+    return;
+  }
+  //-- inside the block: corners and courtyard are ground, the sides are parcels
+  z = ground_z(x, y);
+  c = 2;
+  //-- x and y are floored to the cm, the mirrored sides subtract 1 to stay on the side of a boundary the polygons have
+  Coord ux = lx - W;
+  Coord uy = ly - W;
+  int side;
+  Coord u, v;
+  if (uy < D && ux >= D && ux < L - D) {
+    side = 0; u = ux - D; v = uy;
+  }
+  else if (ux >= L - D && uy >= D && uy < L - D) {
+    side = 1; u = uy - D; v = L - 1 - ux;
+  }
+  else if (uy >= L - D && ux >= D && ux < L - D) {
+    side = 2; u = L - D - 1 - ux; v = L - 1 - uy;
+  }
+  else if (ux < D && uy >= D && uy < L - D) {
+    side = 3; u = L - D - 1 - uy; v = ux;
+  }
+  else
+    return;
+  if (v < F)
+    return;
+  if (bx != cbx || by != cby || side != cside) {
+    parcels = get_parcels(bx, by, side);
+    cbx = bx;
+    cby = by;
+    cside = side;
+  }
+  for (auto& p : parcels) {
+    if (u < p.u0 || u >= p.u1)
+      continue;
+    int i = (int)((u - p.u0) * COMPLEXITY / (p.u1 - p.u0));
+    if (i >= COMPLEXITY)
+      i = COMPLEXITY - 1;
+    if (v < F + p.depths[i]) {
+      z = p.height / 100.0;
+      c = 6;
+    }
+    return;
+  }
+}
+
+//-- points of tile (tx, ty), generated per cell of 10 m so the parcels of a block side are reused
+static bool write_tile(const std::string& filename, int tx, int ty, double extent, unsigned long long& n) {
+  double x0 = (double)tx * TILE;
+  double y0 = (double)ty * TILE;
+  double x1 = std::min(x0 + TILE, extent);
+  double y1 = std::min(y0 + TILE, extent);
+  LASheader header;
+  header.x_scale_factor = 0.01;
+  header.y_scale_factor = 0.01;
+  header.z_scale_factor = 0.01;
+  header.x_offset = ORIGIN_X + x0;
+  header.y_offset = ORIGIN_Y + y0;
+  header.z_offset = 0;
+  header.point_data_format = 0;
+  header.point_data_record_length = 20;
+  LASwriteOpener laswriteopener;
+  laswriteopener.set_file_name(filename.c_str());
+  LASwriter* laswriter = laswriteopener.open(&header);
+  if (laswriter == 0) {
+    std::cerr << "ERROR: could not write " << filename << std::endl;
+    return false;
+  }
+  LASpoint laspt;
+  laspt.init(&header, header.point_data_format, header.point_data_record_length, 0);
+  std::mt19937_64 rng(hash(tx, ty, 9));
+  std::uniform_real_distribution<double> unif(0, 1);
+  std::normal_distribution<double> noise(0, 0.02);
+  n = 0;
+  const double cell = 10;
+  for (double y = y0; y < y1; y += cell) {
+    for (double x = x0; x < x1; x += cell) {
+      double w = std::min(cell, x1 - x);
+      double h = std::min(cell, y1 - y);
+      std::poisson_distribution<int> count(DENSITY * w * h);
+      for (int k = count(rng); k > 0; k--) {
+        double px = x + unif(rng) * w;
+        double py = y + unif(rng) * h;
+        double pz;
+        int c;
+        get_surface(px, py, pz, c);
+        laspt.set_x(ORIGIN_X + px);
+        laspt.set_y(ORIGIN_Y + py);
+        laspt.set_z(pz + noise(rng));
+        laspt.classification = c;
+        laspt.return_number = 1;
+        laspt.number_of_returns = 1;
+        laswriter->write_point(&laspt);
+        laswriter->update_inventory(&laspt);
+        n++;
+      }
+    }
+  }
+  laswriter->update_header(&header, TRUE);
+  laswriter->close();
+  delete laswriter;
+  return true;
+}
+
+static bool write_config(const std::string& filename, const std::string& extension) {
+  std::ofstream of(filename);
+  if (!of)
+    return false;
+  of << "input_polygons:\n"
+     << "  - datasets:\n"
+     << "      - ./polygons.gpkg\n"
+     << "    uniqueid: gml_id\n"
+     << "    height_field: relatievehoogteligging\n"
+     << "    lifting_per_layer:\n"
+     << "      waterdeel: Water\n"
+     << "      onbegroeidterreindeel: Terrain\n"
+     << "      wegdeel: Road\n"
+     << "      pand: Building\n"
+     << "      begroeidterreindeel: Forest\n"
+     << "  - datasets:\n"
+     << "      - ./polygons.gpkg\n"
+     << "    uniqueid: gml_id\n"
+     << "    height_field: relatievehoogteligging\n"
+     << "    handle_multiple_heights: true\n"
+     << "    lifting_per_layer:\n"
+     << "      overbruggingsdeel: Bridge/Overpass\n"
+     << "\n"
+     << "lifting_options:\n"
+     << "  Building:\n"
+     << "    lod: 1\n"
+     << "    floor: true\n"
+     << "    inner_walls: true\n"
+     << "    triangulate: false\n"
+     << "    ground:\n"
+     << "      height: percentile-10\n"
+     << "      use_LAS_classes: [2, 9]\n"
+     << "    roof:\n"
+     << "      height: percentile-90\n"
+     << "      use_LAS_classes: [6]\n"
+     << "  Terrain:\n"
+     << "    simplification_tinsimp: 0.1\n"
+     << "    use_LAS_classes: [2, 9]\n"
+     << "  Forest:\n"
+     << "    simplification_tinsimp: 0.1\n"
+     << "    use_LAS_classes: [2, 9]\n"
+     << "  Water:\n"
+     << "    height: percentile-10\n"
+     << "    use_LAS_classes: [9]\n"
+     << "  Road:\n"
+     << "    height: percentile-50\n"
+     << "    use_LAS_classes: [2]\n"
+     << "  Bridge/Overpass:\n"
+     << "    height: percentile-50\n"
+     << "    use_LAS_classes: [26]\n"
+     << "\n"
+     << "input_elevation:\n"
+     << "  - datasets:\n"
+     << "      - ./points/*" << extension << "\n"
+     << "    omit_LAS_classes:\n"
+     << "      - 0\n"
+     << "      - 1\n"
+     << "    thinning: 0\n"
+     << "\n"
+     << "options:\n"
+     << "  building_radius_vertex_elevation: 3.0\n"
+     << "  radius_vertex_elevation: 1.0\n"
+     << "  threshold_jump_edges: 0.5\n";
+  return true;
+}
+
+int main(int argc, const char * argv[]) {
+  namespace po = boost::program_options;
+  std::string folder;
+  std::string format;
+  double block, road, depth;
+  unsigned int threads;
+  po::options_description pomain("Allowed options");
+  pomain.add_options()
+    ("help", "View all options")
+    ("output", po::value<std::string>(&folder), "Folder for the polygons, the points and config.yml")
+    ("area", po::value<double>(&AREA)->default_value(1), "Area in km2, a square")
+    ("density", po::value<double>(&DENSITY)->default_value(8), "Points per m2")
+    ("complexity", po::value<int>(&COMPLEXITY)->default_value(1), "Steps in the back of each building (1 to 50)")
+    ("block", po::value<double>(&block)->default_value(100), "Distance between the roads in m")
+    ("road", po::value<double>(&road)->default_value(10), "Width of the roads in m")
+    ("depth", po::value<double>(&depth)->default_value(20), "Depth of the parcels along the roads in m")
+    ("canal", po::value<int>(&CANAL)->default_value(8), "Every nth column of blocks is a canal, 0 for none")
+    ("flyover", po::value<int>(&FLYOVER)->default_value(10), "One in n intersections has a flyover, 0 for none")
+    ("tile", po::value<int>(&TILE)->default_value(1000), "Size of the point tiles in m")
+    ("format", po::value<std::string>(&format)->default_value("laz"), "Points as las or laz")
+    ("origin_x", po::value<double>(&ORIGIN_X)->default_value(85000), "x of the lower-left corner")
+    ("origin_y", po::value<double>(&ORIGIN_Y)->default_value(445000), "y of the lower-left corner")
+    ("seed", po::value<unsigned long long>(&SEED)->default_value(1), "Seed of the layout and the points")
+    ("threads", po::value<unsigned int>(&threads)->default_value(std::max(1u, std::thread::hardware_concurrency())), "Threads writing the point tiles")
+    ;
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, pomain), vm);
+    po::notify(vm);
+  }
+  catch (std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    std::cout << pomain << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (vm.count("help") || folder.empty()) {
+    std::cout << "=== 3dfier_generate help ===" << std::endl;
+    std::cout << "Usage:   3dfier_generate --output folder [options]" << std::endl;
+    std::cout << pomain << std::endl;
+    return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  B = (Coord)std::llround(block * 100);
+  W = (Coord)std::llround(road * 100);
+  D = (Coord)std::llround(depth * 100);
+  L = B - W;
+  if (D < F + 800 || L - 2 * D < 600 || W <= 0) {
+    std::cerr << "ERROR: --depth must be at least 11 m and --block at least --road + 2 * --depth + 6 m.\n";
+    return EXIT_FAILURE;
+  }
+  if (COMPLEXITY < 1 || COMPLEXITY > 50 || AREA <= 0 || DENSITY <= 0 || TILE <= 0 || threads == 0) {
+    std::cerr << "ERROR: --complexity must be 1 to 50, --area, --density, --tile and --threads positive.\n";
+    return EXIT_FAILURE;
+  }
+  if (format != "las" && format != "laz") {
+    std::cerr << "ERROR: --format must be las or laz.\n";
+    return EXIT_FAILURE;
+  }
+  NB = std::max(1, (int)std::lround(std::sqrt(AREA) * 1000 * 100 / B));
+  double extent = (NB * B + W) / 100.0;
+
+  boost::filesystem::path out(folder);
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(out / "points", ec);
+  if (ec) {
+    std::cerr << "ERROR: could not create " << (out / "points").string() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Generating " << NB << " x " << NB << " blocks, " << extent << " m x " << extent << " m" << std::endl;
+
+  unsigned long long counts[NLAYERS];
+  boost::filesystem::path gpkg = out / "polygons.gpkg";
+  boost::filesystem::remove(gpkg, ec);
+  if (write_polygons(gpkg.string(), counts) == false)
+    return EXIT_FAILURE;
+  for (int i = 0; i < NLAYERS; i++)
+    std::cout << "\t" << LAYERNAMES[i] << ": " << counts[i] << " polygons" << std::endl;
+
+  //-- tiles are written in parallel, each thread takes the next tile
+  int ntiles = (int)std::ceil(extent / TILE);
+  std::atomic<int> next(0);
+  std::atomic<unsigned long long> npts(0);
+  std::atomic<bool> failed(false);
+  std::vector<std::thread> pool;
+  for (unsigned int t = 0; t < std::min(threads, (unsigned int)(ntiles * ntiles)); t++) {
+    pool.emplace_back([&]() {
+      for (int i = next++; i < ntiles * ntiles; i = next++) {
+        int tx = i % ntiles;
+        int ty = i / ntiles;
+        std::string name = "tile_" + std::to_string(tx) + "_" + std::to_string(ty) + "." + format;
+        unsigned long long n = 0;
+        if (write_tile((out / "points" / name).string(), tx, ty, extent, n) == false)
+          failed = true;
+        else
+          npts += n;
+      }
+    });
+  }
+  for (auto& t : pool)
+    t.join();
+  if (failed)
+    return EXIT_FAILURE;
+  std::cout << "\t" << npts << " points in " << ntiles * ntiles << " tiles" << std::endl;
+
+  if (write_config((out / "config.yml").string(), "." + format) == false) {
+    std::cerr << "ERROR: could not write " << (out / "config.yml").string() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Written " << (out / "config.yml").string() << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""
+Drives a local 3dfier --server: starts it on a config, sends the requests for
+a grid of cells of an extent, checks the replies and writes the outputs.
+
+  python3 3dfier_client.py ../../build/3dfier config.yml \
+    --extent 84000 446000 85000 447000 --grid 4 --format CityJSON --output cell
+"""
+import argparse
+import json
+import subprocess
+import sys
+import time
+
+
+def read_reply(server):
+  line = server.stdout.readline()
+  if not line:
+    sys.exit("ERROR: the server stopped, see its log")
+  reply = json.loads(line)
+  data = server.stdout.read(reply.get("bytes", 0))
+  if len(data) != reply.get("bytes", 0):
+    sys.exit("ERROR: the server sent %d bytes instead of %d" % (len(data), reply["bytes"]))
+  return reply, data
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Drive a local 3dfier --server")
+  parser.add_argument("threedfier", help="path of the 3dfier program")
+  parser.add_argument("config", help="YAML config file")
+  parser.add_argument("--extent", nargs=4, type=float, required=True, metavar=("XMIN", "YMIN", "XMAX", "YMAX"))
+  parser.add_argument("--grid", type=int, default=1, help="split the extent in grid x grid requests")
+  parser.add_argument("--format", default="CityJSON")
+  parser.add_argument("--repeat", type=int, default=1, help="send the requests this many times")
+  parser.add_argument("--output", help="write the outputs to OUTPUT_i_j.ext")
+  parser.add_argument("--log", default="3dfier_server.log", help="file for the log of the server")
+  args = parser.parse_args()
+
+  with open(args.log, "w") as log:
+    start = time.time()
+    server = subprocess.Popen([args.threedfier, args.config, "--server"],
+                              stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=log)
+    xmin, ymin, xmax, ymax = args.extent
+    dx = (xmax - xmin) / args.grid
+    dy = (ymax - ymin) / args.grid
+    failed = 0
+    seconds = []
+    for r in range(args.repeat):
+      for i in range(args.grid):
+        for j in range(args.grid):
+          request = {"id": "%d_%d" % (i, j), "format": args.format,
+                     "extent": [xmin + i * dx, ymin + j * dy, xmin + (i + 1) * dx, ymin + (j + 1) * dy]}
+          sent = time.time()
+          server.stdin.write((json.dumps(request) + "\n").encode())
+          server.stdin.flush()
+          reply, data = read_reply(server)
+          seconds.append(time.time() - sent)
+          if reply["status"] != "ok":
+            failed += 1
+            print("%s: %s" % (reply.get("id"), reply.get("message")))
+            continue
+          print("%s: %d features, %d bytes in %.2f s" % (reply["id"], reply["features"], reply["bytes"], seconds[-1]))
+          if args.output and r == 0:
+            with open("%s_%s.%s" % (args.output, reply["id"], args.format.lower()), "wb") as f:
+              f.write(data)
+    server.stdin.write(b'{"command": "quit"}\n')
+    server.stdin.close()
+    server.wait()
+
+  seconds.sort()
+  print("%d requests, %d failed, %.2f s in total with the start of the server" % (len(seconds), failed, time.time() - start))
+  if seconds:
+    print("latency: median %.2f s, max %.2f s" % (seconds[len(seconds) // 2], seconds[-1]))
+  return 1 if failed > 0 or server.returncode != 0 else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
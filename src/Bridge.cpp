@@ -83,7 +83,7 @@ void Bridge::get_cityjson(nlohmann::json& j, std::unordered_map<std::string,unsi
   j["CityObjects"][this->get_id()] = f;
 }
 
-void Bridge::get_citygml(std::wostream& of) {
+void Bridge::get_citygml(TextWriter& of) {
   of << "<cityObjectMember>";
   of << "<bri:Bridge gml:id=\"" << this->get_id() << "\">";
   get_citygml_attributes(of, _attributes);
@@ -99,7 +99,7 @@ void Bridge::get_citygml(std::wostream& of) {
   of << "</cityObjectMember>";
 }
 
-void Bridge::get_citygml_imgeo(std::wostream& of) {
+void Bridge::get_citygml_imgeo(TextWriter& of) {
   of << "<cityObjectMember>";
   of << "<bri:BridgeConstructionElement gml:id=\"" << this->get_id() << "\">";
   get_imgeo_attributes(of, this->get_id());
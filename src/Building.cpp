@@ -302,7 +302,32 @@ void Building::cleanup_elevations() {
   //Do not cleanup buildings since CSV output uses the elevation vectors
 }
 
-void Building::get_csv(std::wostream& of) {
+void Building::add_memory_usage(Metrics::MemoryUsage& usage) {
+  Flat::add_memory_usage(usage);
+  usage["zvaluesground"] += _zvaluesground.capacity() * sizeof(int);
+}
+
+void Building::reset() {
+  Flat::reset();
+  _zvaluesground.clear();
+}
+
+//-- the elevations are kept too, the CSV outputs use them
+void Building::write_state(std::ostream& os) {
+  Flat::write_state(os);
+  write_binary(os, _height_base);
+  write_binary(os, _zvaluesinside);
+  write_binary(os, _zvaluesground);
+}
+
+bool Building::read_state(std::istream& is) {
+  return Flat::read_state(is) &&
+    read_binary(is, _height_base) &&
+    read_binary(is, _zvaluesinside) &&
+    read_binary(is, _zvaluesground);
+}
+
+void Building::get_csv(TextWriter& of) {
   of << this->get_id() << "," <<
     std::setprecision(2) << std::fixed <<
     this->get_height_roof_at_percentile(_heightref_top) / 100.0 << "," <<
@@ -470,6 +495,60 @@ void Building::get_stl(std::unordered_map< std::string, unsigned long > &dPts, i
 }
 
 
+unsigned long Building::get_stl_binary(int lod, const Point2& offset, std::string* fs) {
+  unsigned long count = 0;
+  if (lod == 1) {
+    count += TopoFeature::get_stl_binary(offset, fs);
+    if (_building_include_floor) {
+      //-- reverse orientation for floor polygon
+      count += get_stl_binary_flat(z_to_float(this->get_height_base()), true, offset, fs);
+    }
+  }
+  else if (lod == 0) {
+    count += get_stl_binary_flat(z_to_float(this->get_height_base()), false, offset, fs);
+  }
+  return count;
+}
+
+/**
+ * the triangles of the polygon flat at height z, for the floor and LoD0
+ */
+unsigned long Building::get_stl_binary_flat(float z, bool reverse, const Point2& offset, std::string* fs) {
+  unsigned long count = 0;
+  for (auto& t : _triangles) {
+    std::pair<long long, long long> a = xy_mm(_vertices[t.v0].first);
+    std::pair<long long, long long> b = xy_mm(_vertices[t.v1].first);
+    std::pair<long long, long long> c = xy_mm(_vertices[t.v2].first);
+    if ((a != b) && (a != c) && (b != c)) {
+      if (fs != NULL) {
+        Point3 pa(_vertices[t.v0].first.get<0>(), _vertices[t.v0].first.get<1>(), z);
+        Point3 pb(_vertices[t.v1].first.get<0>(), _vertices[t.v1].first.get<1>(), z);
+        Point3 pc(_vertices[t.v2].first.get<0>(), _vertices[t.v2].first.get<1>(), z);
+        if (reverse)
+          stl_binary_prep(pa, pc, pb, offset, *fs);
+        else
+          stl_binary_prep(pa, pb, pc, offset, *fs);
+      }
+      count++;
+    }
+  }
+  return count;
+}
+
+void Building::get_mesh(int lod, const Point3& centre, float featureid, Mesh& mesh) {
+  float z = z_to_float(this->get_height_base());
+  if (lod == 1) {
+    TopoFeature::get_mesh(centre, featureid, mesh);
+    if (_building_include_floor) {
+      //-- reverse orientation for floor polygon
+      add_mesh_triangles(_vertices, _triangles, centre, featureid, mesh, &z, true);
+    }
+  }
+  else if (lod == 0) {
+    add_mesh_triangles(_vertices, _triangles, centre, featureid, mesh, &z);
+  }
+}
+
 void Building::get_cityjson(nlohmann::json& j, std::unordered_map<std::string, unsigned long> &dPts) {
   nlohmann::json b;
   b["type"] = "Building";
@@ -520,7 +599,7 @@ void Building::get_cityjson(nlohmann::json& j, std::unordered_map<std::string, u
   j["CityObjects"][this->get_id()] = b;
 }
 
-void Building::get_citygml(std::wostream& of) {
+void Building::get_citygml(TextWriter& of) {
   float h = z_to_float(this->get_height());
   float hbase = z_to_float(this->get_height_base());
   of << "<cityObjectMember>";
@@ -547,7 +626,7 @@ void Building::get_citygml(std::wostream& of) {
   of << "</cityObjectMember>";
 }
 
-void Building::get_citygml_imgeo(std::wostream& of) {
+void Building::get_citygml_imgeo(TextWriter& of) {
   float h = z_to_float(this->get_height());
   float hbase = z_to_float(this->get_height_base());
   of << "<cityObjectMember>";
@@ -568,7 +647,7 @@ void Building::get_citygml_imgeo(std::wostream& of) {
   of << "</cityObjectMember>";
 }
 
-void Building::get_citygml_lod1(std::wostream& of) {
+void Building::get_citygml_lod1(TextWriter& of) {
   //-- LOD1 Solid
   of << "<bui:lod1Solid>";
   of << "<gml:Solid>";
@@ -594,7 +673,7 @@ void Building::get_citygml_lod1(std::wostream& of) {
   of << "</bui:lod1Solid>";
 }
 
-void Building::get_imgeo_nummeraanduiding(std::wostream& of) {
+void Building::get_imgeo_nummeraanduiding(TextWriter& of) {
   std::string attribute;
   bool btekst, bplaatsingspunt, bhoek, blaagnr, bhoognr;
   std::string tekst, plaatsingspunt, hoek, laagnr, hoognr;
@@ -651,110 +730,38 @@ void Building::get_imgeo_nummeraanduiding(std::wostream& of) {
   }
 }
 
-bool Building::get_shape(OGRLayer* layer, bool writeAttributes, const AttributeMap& extraAttributes) {
-  OGRFeatureDefn *featureDefn = layer->GetLayerDefn();
-  OGRFeature *feature = OGRFeature::CreateFeature(featureDefn);
-  OGRMultiPolygon multipolygon = OGRMultiPolygon();
-  Point3 p;
-
-  //-- add all triangles to the layer
-  for (auto& t : _triangles) {
-    OGRPolygon polygon = OGRPolygon();
-    OGRLinearRing ring = OGRLinearRing();
-
-    p = _vertices[t.v0].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-    p = _vertices[t.v1].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-    p = _vertices[t.v2].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-
-    ring.closeRings();
-    polygon.addRing(&ring);
-    multipolygon.addGeometry(&polygon);
-  }
-
-  //-- add all vertical wall triangles to the layer
-  for (auto& t : _triangles_vw) {
-    OGRPolygon polygon = OGRPolygon();
-    OGRLinearRing ring = OGRLinearRing();
-
-    p = _vertices_vw[t.v0].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-    p = _vertices_vw[t.v1].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-    p = _vertices_vw[t.v2].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-
-    ring.closeRings();
-    polygon.addRing(&ring);
-    multipolygon.addGeometry(&polygon);
-  }
-
-  //-- add all floor triangles to the layer
+void Building::get_wkb(std::string& wkb, int srid) {
+  TopoFeature::get_wkb(wkb, srid);
   if (_building_include_floor) {
+    //-- reverse orientation for floor polygon
     float z = z_to_float(this->get_height_base());
-    for (auto& t : _triangles) {
-      OGRPolygon polygon = OGRPolygon();
-      OGRLinearRing ring = OGRLinearRing();
-
-      // reverse orientation for floor polygon, v0-v2-v1 instead of v0-v1-v2.
-      p = _vertices[t.v0].first;
-      ring.addPoint(p.get<0>(), p.get<1>(), z);
-      p = _vertices[t.v2].first;
-      ring.addPoint(p.get<0>(), p.get<1>(), z);
-      p = _vertices[t.v1].first;
-      ring.addPoint(p.get<0>(), p.get<1>(), z);
-
-      ring.closeRings();
-      polygon.addRing(&ring);
-      multipolygon.addGeometry(&polygon);
-    }
+    add_wkb_triangles(wkb, _vertices, _triangles, srid > 0, &z, true);
   }
+}
 
-  if (feature->SetGeometry(&multipolygon) != OGRERR_NONE) {
-    std::cerr << "Creating feature geometry failed.\n";
-    OGRFeature::DestroyFeature(feature);
-    return false;
-  }
-  if (!writeAttribute(feature, featureDefn, "3df_id", this->get_id())) {
-    return false;
-  }
-  if (!writeAttribute(feature, featureDefn, "3df_class", "Building")) {
-    return false;
+bool Building::get_shape(OGRLayer* layer, bool writeAttributes, const AttributeMap& extraAttributes) {
+  return TopoFeature::get_multipolygon_features(layer, "Building", writeAttributes, extraAttributes);
+}
+
+OGRFeature* Building::get_ogr_feature(OGRFeatureDefn* featureDefn, std::string className, bool writeAttributes, const AttributeMap& extraAttributes) {
+  OGRFeature *feature = TopoFeature::get_ogr_feature(featureDefn, className, writeAttributes, extraAttributes);
+  if (feature == NULL) {
+    return NULL;
   }
   int fi = featureDefn->GetFieldIndex("baseheight");
   if (fi == -1) {
     std::cerr << "Failed to write attribute " << "baseheight" << ".\n";
-    return false;
+    OGRFeature::DestroyFeature(feature);
+    return NULL;
   }
   float hbase = z_to_float(this->get_height_base());
   feature->SetField(fi, hbase);
   fi = featureDefn->GetFieldIndex("roofheight");
   if (fi == -1) {
     std::cerr << "Failed to write attribute " << "roofheight" << ".\n";
-    return false;
-  }
-  feature->SetField(fi, z_to_float(this->get_height()) - hbase);
-  if (writeAttributes) {
-    for (auto attr : _attributes) {
-      if (!(attr.second.first == OFTDateTime && attr.second.second == "0000/00/00 00:00:00")) {
-        if (!writeAttribute(feature, featureDefn, attr.first, attr.second.second)) {
-          return false;
-        }
-      }
-    }
-    for (auto attr : extraAttributes) {
-      if (!writeAttribute(feature, featureDefn, attr.first, attr.second.second)) {
-        return false;
-      }
-    }
-  }
-  if (layer->CreateFeature(feature) != OGRERR_NONE) {
-    std::cerr << "Failed to create feature " << this->get_id() << ".\n";
     OGRFeature::DestroyFeature(feature);
-    return false;
+    return NULL;
   }
-  OGRFeature::DestroyFeature(feature);
-  return true;
+  feature->SetField(fi, z_to_float(this->get_height()) - hbase);
+  return feature;
 }
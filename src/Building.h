@@ -41,18 +41,26 @@ public:
   void          construct_building_walls(const NodeColumn& nc);
   void          get_obj(std::unordered_map< std::string, unsigned long > &dPts, int lod, std::string mtl, std::string &fs);
   void          get_stl(std::unordered_map< std::string, unsigned long > &dPts, int lod, std::string &fs);
-  void          get_citygml(std::wostream& of);
-  void          get_citygml_imgeo(std::wostream& of);
-  void          get_citygml_lod1(std::wostream& of);
-  void          get_imgeo_nummeraanduiding(std::wostream& of);
-  void          get_csv(std::wostream& of);
+  unsigned long get_stl_binary(int lod, const Point2& offset, std::string* fs);
+  void          get_mesh(int lod, const Point3& centre, float featureid, Mesh& mesh);
+  void          get_citygml(TextWriter& of);
+  void          get_citygml_imgeo(TextWriter& of);
+  void          get_citygml_lod1(TextWriter& of);
+  void          get_imgeo_nummeraanduiding(TextWriter& of);
+  void          get_csv(TextWriter& of);
   void          get_cityjson(nlohmann::json& j, std::unordered_map<std::string, unsigned long> &dPts);
   std::string   get_all_z_values();
   std::string   get_mtl();
   bool          get_shape(OGRLayer* layer, bool writeAttributes, const AttributeMap& extraAttributes = AttributeMap());
+  OGRFeature*   get_ogr_feature(OGRFeatureDefn* featureDefn, std::string className, bool writeAttributes, const AttributeMap& extraAttributes = AttributeMap());
+  void          get_wkb(std::string& wkb, int srid = 0);
   TopoClass     get_class();
   bool          is_hard();
   void          cleanup_elevations();
+  void          add_memory_usage(Metrics::MemoryUsage& usage);
+  void          reset();
+  void          write_state(std::ostream& os);
+  bool          read_state(std::istream& is);
   int           get_height_base();
   int           get_height_ground_at_percentile(float percentile);
   int           get_height_roof_at_percentile(float percentile);
@@ -69,6 +77,8 @@ private:
   static bool          _building_inner_walls;
   static std::set<int> _las_classes_roof;
   static std::set<int> _las_classes_ground;
+
+  unsigned long get_stl_binary_flat(float z, bool reverse, const Point2& offset, std::string* fs);
 };
 
 #endif /* Building_h */
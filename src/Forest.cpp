@@ -67,7 +67,7 @@ void Forest::get_cityjson(nlohmann::json& j, std::unordered_map<std::string,unsi
   j["CityObjects"][this->get_id()] = f;
 }
 
-void Forest::get_citygml(std::wostream& of) {
+void Forest::get_citygml(TextWriter& of) {
   of << "<cityObjectMember>";
   of << "<veg:PlantCover gml:id=\"" << this->get_id() << "\">";
   get_citygml_attributes(of, _attributes);
@@ -83,7 +83,7 @@ void Forest::get_citygml(std::wostream& of) {
   of << "</cityObjectMember>";
 }
 
-void Forest::get_citygml_imgeo(std::wostream& of) {
+void Forest::get_citygml_imgeo(TextWriter& of) {
   of << "<cityObjectMember>";
   of << "<veg:PlantCover gml:id=\"" << this->get_id() << "\">";
   get_imgeo_attributes(of, this->get_id());
@@ -34,6 +34,21 @@
 
 #include "Map3d.h"
 #include <ogrsf_frmts.h>
+#include "boost/chrono.hpp"
+#include "boost/filesystem.hpp"
+#include <numeric>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+
+//-- names of the classes, in the order of TopoClass
+static const char* CLASSNAMES[] = { "Building", "Water", "Bridge", "Road", "Terrain", "Forest", "Separation" };
+
+//-- seconds since start, for the costs of the features
+static double seconds_since(const boost::chrono::steady_clock::time_point& start) {
+  return boost::chrono::duration<double>(boost::chrono::steady_clock::now() - start).count();
+}
 
 Map3d::Map3d() {
   OGRRegisterAll();
@@ -64,14 +79,22 @@ Map3d::Map3d() {
   _requestedExtent = Box2(Point2(0, 0), Point2(0, 0));
   _bbox = Box2(Point2(9999999, 9999999), Point2(-9999999, -9999999));
   _minxradius = 9999999;
-  _maxxradius = 9999999;
-  _minyradius = -9999999;
+  _maxxradius = -9999999;
+  _minyradius = 9999999;
   _maxyradius = -9999999;
   _max_angle_curvepolygon = 0;
+  _single_tin = false;
+  _profile_features = false;
+  _max_memory = 0;
+  _num_deleted_features = 0;
+  _metrics.set_memory_usage([this]() { return get_memory_usage(); });
 }
 
 Map3d::~Map3d() {
+  for (auto& f : (_lsAllFeatures.empty() ? _lsFeatures : _lsAllFeatures))
+    delete f;
   _lsFeatures.clear();
+  _lsAllFeatures.clear();
 }
 
 void Map3d::set_building_heightref_roof(float h) {
@@ -182,19 +205,98 @@ void Map3d::set_max_angle_curvepolygon(double max_angle) {
   _max_angle_curvepolygon = max_angle;
 }
 
+void Map3d::set_single_tin(bool single_tin) {
+  _single_tin = single_tin;
+}
+
+void Map3d::set_srs(std::string srs) {
+  _srs = srs;
+}
+
+/**
+ * time lifting, stitching, walls and CDT of each feature and count its points,
+ * see get_feature_profile()
+ */
+void Map3d::set_profile_features(bool profile) {
+  _profile_features = profile;
+}
+
 Box2 Map3d::get_bbox() {
   return _bbox;
 }
 
+Metrics& Map3d::get_metrics() {
+  return _metrics;
+}
+
+Progress& Map3d::get_progress() {
+  return _progress;
+}
+
+/**
+ * resident bytes allowed before the writers flush early, see check_memory()
+ */
+void Map3d::set_max_memory(unsigned long long bytes) {
+  _max_memory = bytes;
+}
+
+/**
+ * approximate bytes held per subsystem: the features and their rings, the
+ * elevations and points collected from the LiDAR, the triangulations, the
+ * NodeColumns, the rtrees and the largest batch of output buffers so far
+ */
+Metrics::MemoryUsage Map3d::get_memory_usage() {
+  Metrics::MemoryUsage usage;
+  usage["polygons"] = _lsFeatures.capacity() * sizeof(TopoFeature*);
+  for (auto& f : _lsFeatures)
+    f->add_memory_usage(usage);
+  unsigned long long nodecolumns = 0;
+  for (auto nc : { &_nc, &_nc_building_walls }) {
+    nodecolumns += nc->bucket_count() * sizeof(void*);
+    for (auto& it : *nc)
+      nodecolumns += sizeof(it) + 2 * sizeof(void*) + it.first.capacity() + it.second.capacity() * sizeof(int);
+  }
+  usage["node_columns"] = nodecolumns;
+  //-- the rstar nodes hold at most 16 entries, count them as full
+  usage["rtree"] = (_rtree.size() + _rtree_buildings.size()) * (sizeof(PairIndexed) + sizeof(PairIndexed) / 16);
+  usage["writer_buffers"] = parallel_buffer_peak();
+  return usage;
+}
+
+/**
+ * compare the resident memory with the budget of set_max_memory(), over it
+ * print the bytes per subsystem and make the writers flush smaller batches;
+ * returns false when over the budget
+ */
+bool Map3d::check_memory(const std::string& stage) {
+  if (_max_memory == 0)
+    return true;
+  unsigned long long rss = Metrics::current_rss();
+  //-- the writers may buffer what is left of the budget, at least 1MB
+  unsigned long long left = (rss < _max_memory) ? _max_memory - rss : 0;
+  parallel_buffer_budget() = std::max<unsigned long long>(left, 1 << 20);
+  if (rss <= _max_memory)
+    return true;
+  std::cerr << "WARNING: " << rss / (1 << 20) << "MB resident after " << stage
+    << " exceeds --max-memory of " << _max_memory / (1 << 20) << "MB\n";
+  for (auto& it : get_memory_usage())
+    std::cerr << "\t" << it.first << ": " << it.second / (1 << 20) << "MB\n";
+  return false;
+}
+
+/**
+ * whether the box intersects the bbox of the polygons grown by the radius
+ * (see construct_rtree()), points outside it cannot lift any vertex
+ */
 bool Map3d::check_bounds(const double xmin, const double xmax, const double ymin, const double ymax) {
-  if ((xmin < _maxxradius || xmax > _minxradius) &&
-    (ymin < _maxyradius || ymax > _minyradius)) {
+  if (xmin <= _maxxradius && xmax >= _minxradius &&
+    ymin <= _maxyradius && ymax >= _minyradius) {
     return true;
   }
   return false;
 }
 
-bool Map3d::get_cityjson(std::wostream& of) {
+bool Map3d::get_cityjson(TextWriter& of) {
   nlohmann::json j;
   j["type"] = "CityJSON";
   j["version"] = "1.0";
@@ -210,6 +312,7 @@ bool Map3d::get_cityjson(std::wostream& of) {
   std::unordered_map< std::string, unsigned long > dPts;
   for (auto& f : _lsFeatures) {
     f->get_cityjson(j, dPts);
+    _progress.add();
   }
   //-- vertices
   std::vector<std::string> thepts;
@@ -226,67 +329,252 @@ bool Map3d::get_cityjson(std::wostream& of) {
   return true;
 }
 
-void Map3d::get_citygml(std::wostream& of) {
-  create_citygml_header(of);
+/**
+ * write the top slowest features (lifting + stitching + walls + CDT) as CSV
+ * the CDT of the Terrain and Forest features is not timed with a single TIN,
+ * it is built for all of them at once
+ */
+bool Map3d::get_feature_profile(std::string filename, int top) {
+  std::vector< std::pair<double, TopoFeature*> > totals;
   for (auto& f : _lsFeatures) {
-    f->get_citygml(of);
-    of << "\n";
+    Metrics::FeatureCosts& costs = _featurecosts[f];
+    totals.push_back(std::make_pair(costs.lifting + costs.stitching + costs.walls + costs.cdt, f));
   }
-  of << "</CityModel>\n";
+  std::size_t n = std::min(totals.size(), (std::size_t)std::max(top, 0));
+  std::partial_sort(totals.begin(), totals.begin() + n, totals.end(),
+    [](const std::pair<double, TopoFeature*>& a, const std::pair<double, TopoFeature*>& b) { return a.first > b.first; });
+
+  TextWriter of;
+  if (of.open(filename) == false) {
+    std::cerr << "ERROR: cannot write feature profile " << filename << std::endl;
+    return false;
+  }
+  of << "id,layer,class,seconds,lifting,stitching,walls,cdt,vertices,points,triangles,greedy_iterations\n";
+  of << std::setprecision(6) << std::fixed;
+  for (std::size_t i = 0; i < n; i++) {
+    TopoFeature* f = totals[i].second;
+    Metrics::FeatureCosts& costs = _featurecosts[f];
+    of << f->get_id() << "," << f->get_layername() << "," << CLASSNAMES[f->get_class()] << ","
+      << totals[i].first << "," << costs.lifting << "," << costs.stitching << "," << costs.walls << "," << costs.cdt << ","
+      << f->get_number_vertices() << "," << costs.points << "," << f->get_number_triangles() << "," << costs.iterations << "\n";
+  }
+  of.close();
+  return true;
 }
 
-void Map3d::get_citygml_multifile(std::string ofname) {
-  std::unordered_map<std::string, std::wofstream*> ofs;
+/**
+ * the formats that get_outputs() writes
+ */
+bool Map3d::is_single_pass_format(const std::string& format) {
+  return (format == "CityGML" || format == "CityGML-IMGeo" || format == "OBJ" || format == "STL" ||
+    format == "CSV-BUILDINGS" || format == "CSV-BUILDINGS-MULTIPLE" || format == "CSV-BUILDINGS-ALL-Z");
+}
 
-  for (auto& f : _lsFeatures) {
-    std::string filename = ofname + f->get_layername() + ".gml";
-    if (ofs.find(filename) == ofs.end()) {
-      std::wofstream* of = new std::wofstream();
-      of->open(filename);
-      ofs.emplace(filename, of);
-      create_citygml_header(*ofs[filename]);
-    }
-    f->get_citygml(*ofs[filename]);
-    *ofs[filename] << "\n";
-  }
-  for (auto it = ofs.begin(); it != ofs.end(); it++) {
-    std::wofstream& of = *(it->second);
-    of << "</CityModel>\n";
-    of.close();
+/**
+ * write several outputs (format -> file) with a single pass over the features
+ * only the walk over the features is shared: OBJ numbers all the vertices first
+ * (see get_obj_vertices()), STL numbers the vertices of each feature on its own
+ * to skip degenerate triangles
+ * the output of a range of features is written to the files concurrently,
+ * the files split over the threads with parallel_for()
+ */
+void Map3d::get_outputs(const std::map<std::string, TextWriter*>& outputs) {
+  enum { CITYGML, IMGEO, OBJ, STL, CSV, CSVMULTIPLE, CSVALLZ, NSINKS };
+  static const char* formats[NSINKS] = { "CityGML", "CityGML-IMGeo", "OBJ", "STL", "CSV-BUILDINGS", "CSV-BUILDINGS-MULTIPLE", "CSV-BUILDINGS-ALL-Z" };
+  TextWriter* sinks[NSINKS];
+  for (int s = 0; s < NSINKS; s++) {
+    auto it = outputs.find(formats[s]);
+    sinks[s] = (it == outputs.end()) ? NULL : it->second;
   }
+
+  if (sinks[CITYGML] != NULL)
+    create_citygml_header(*sinks[CITYGML]);
+  if (sinks[IMGEO] != NULL)
+    create_citygml_imgeo_header(*sinks[IMGEO]);
+  if (sinks[CSV] != NULL)
+    *sinks[CSV] << "id,roof,ground\n";
+  if (sinks[CSVMULTIPLE] != NULL)
+    get_csv_multiple_heights_header(*sinks[CSVMULTIPLE]);
+  if (sinks[CSVALLZ] != NULL)
+    *sinks[CSVALLZ] << "id,allzvalues" << std::endl;
+  std::vector<std::string> faces;
+  std::vector< std::vector<unsigned long> > ids;
+  if (sinks[OBJ] != NULL)
+    get_obj_vertices(*sinks[OBJ], _lsFeatures, faces, ids);
+  //-- STL is written per class, the facets are kept until the end like in get_stl()
+  std::string stl[7];
+
+  parallel_ordered<OutputsBuffer>(_lsFeatures.size(),
+    [&](std::size_t begin, std::size_t end, OutputsBuffer& buffer) {
+      TextWriter ss[NSINKS];
+      for (int s = 0; s < NSINKS; s++) {
+        if (sinks[s] != NULL)
+          ss[s].copyfmt(*sinks[s]);
+      }
+      for (std::size_t i = begin; i < end; i++) {
+        TopoFeature* p = _lsFeatures[i];
+        if (sinks[CITYGML] != NULL) {
+          p->get_citygml(ss[CITYGML]);
+          ss[CITYGML] << "\n";
+        }
+        if (sinks[IMGEO] != NULL) {
+          p->get_citygml_imgeo(ss[IMGEO]);
+          ss[IMGEO] << "\n";
+        }
+        if (sinks[OBJ] != NULL) {
+          buffer.sink[OBJ] += "o "; buffer.sink[OBJ] += p->get_id(); buffer.sink[OBJ] += "\n";
+          renumber_obj_faces(faces[i], ids[i], buffer.sink[OBJ]);
+          std::string().swap(faces[i]);
+          std::vector<unsigned long>().swap(ids[i]);
+        }
+        if (sinks[STL] != NULL) {
+          //-- the vertices of the feature are only numbered to skip degenerate facets
+          std::unordered_map< std::string, unsigned long > dPts;
+          if (p->get_class() == BUILDING) {
+            Building* b = dynamic_cast<Building*>(p);
+            b->get_stl(dPts, _building_lod, buffer.stl[BUILDING]);
+          }
+          else {
+            p->get_stl(dPts, buffer.stl[p->get_class()]);
+          }
+        }
+        if (p->get_class() == BUILDING) {
+          Building* b = dynamic_cast<Building*>(p);
+          if (sinks[CSV] != NULL)
+            b->get_csv(ss[CSV]);
+          if (sinks[CSVMULTIPLE] != NULL)
+            get_csv_multiple_heights(b, ss[CSVMULTIPLE]);
+          if (sinks[CSVALLZ] != NULL)
+            ss[CSVALLZ] << b->get_id() << "," << b->get_all_z_values() << std::endl;
+        }
+      }
+      for (int s = 0; s < NSINKS; s++) {
+        if (sinks[s] != NULL && s != OBJ && s != STL)
+          buffer.sink[s].swap(ss[s].str());
+      }
+    },
+    [&](std::size_t begin, std::size_t end, OutputsBuffer& buffer) {
+      _progress.add(end - begin);
+      for (int c = 0; c < 7; c++)
+        stl[c] += buffer.stl[c];
+      std::vector<int> towrite;
+      for (int s = 0; s < NSINKS; s++) {
+        if (sinks[s] != NULL && buffer.sink[s].empty() == false)
+          towrite.push_back(s);
+      }
+      if (towrite.size() == 1) {
+        sinks[towrite[0]]->write(buffer.sink[towrite[0]].data(), buffer.sink[towrite[0]].size());
+        return;
+      }
+      parallel_for(towrite.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t k = begin; k < end; k++)
+          sinks[towrite[k]]->write(buffer.sink[towrite[k]].data(), buffer.sink[towrite[k]].size());
+      });
+    },
+    1024);
+
+  if (sinks[CITYGML] != NULL)
+    *sinks[CITYGML] << "</CityModel>\n";
+  if (sinks[IMGEO] != NULL)
+    *sinks[IMGEO] << "</CityModel>\n";
+  if (sinks[OBJ] != NULL)
+    *sinks[OBJ] << std::endl;
+  if (sinks[STL] != NULL)
+    write_stl_solids(*sinks[STL], stl);
+}
+
+void Map3d::get_citygml(TextWriter& of) {
+  create_citygml_header(of);
+  get_citygml_features(of, false);
+  of << "</CityModel>\n";
 }
 
-void Map3d::get_citygml_imgeo(std::wostream& of) {
+void Map3d::get_citygml_multifile(std::string ofname) {
+  get_citygml_features_multifile(ofname, false);
+}
+
+void Map3d::get_citygml_imgeo(TextWriter& of) {
   create_citygml_imgeo_header(of);
-  for (auto& f : _lsFeatures) {
-    f->get_citygml_imgeo(of);
-    of << "\n";
-  }
+  get_citygml_features(of, true);
   of << "</CityModel>\n";
 }
 
 void Map3d::get_citygml_imgeo_multifile(std::string ofname) {
-  std::unordered_map<std::string, std::wofstream*> ofs;
+  get_citygml_features_multifile(ofname, true);
+}
 
-  for (auto& f : _lsFeatures) {
-    std::string filename = ofname + f->get_layername() + ".gml";
-    if (ofs.find(filename) == ofs.end()) {
-      std::wofstream* of = new std::wofstream();
-      of->open(filename);
-      ofs.emplace(filename, of);
-      create_citygml_imgeo_header(*ofs[filename]);
-    }
-    f->get_citygml_imgeo(*ofs[filename]);
-    *ofs[filename] << "\n";
-  }
+/**
+ * the cityObjectMembers of all features, rendered in parallel and written in feature order
+ * each thread renders in its own stream with the formatting of of
+ */
+void Map3d::get_citygml_features(TextWriter& of, bool imgeo) {
+  parallel_ordered<std::string>(_lsFeatures.size(),
+    [&](std::size_t begin, std::size_t end, std::string& buffer) {
+      TextWriter ss;
+      ss.copyfmt(of);
+      for (std::size_t i = begin; i < end; i++) {
+        if (imgeo)
+          _lsFeatures[i]->get_citygml_imgeo(ss);
+        else
+          _lsFeatures[i]->get_citygml(ss);
+        ss << "\n";
+      }
+      buffer.swap(ss.str());
+    },
+    [&](std::size_t begin, std::size_t end, std::string& buffer) {
+      _progress.add(end - begin);
+      of << buffer;
+    });
+}
+
+/**
+ * same as get_citygml_features() with one file per layer, each feature is
+ * rendered in a buffer of its own so it can be written to the file of its layer
+ */
+void Map3d::get_citygml_features_multifile(std::string ofname, bool imgeo) {
+  std::unordered_map<std::string, TextWriter*> ofs;
+  //-- a compressed output compresses each file
+  std::string compression = TextWriter::split_compression_suffix(ofname);
+
+  parallel_ordered< std::vector<std::string> >(_lsFeatures.size(),
+    [&](std::size_t begin, std::size_t end, std::vector<std::string>& buffer) {
+      for (std::size_t i = begin; i < end; i++) {
+        TextWriter ss;
+        ss << std::setprecision(3) << std::fixed;
+        if (imgeo)
+          _lsFeatures[i]->get_citygml_imgeo(ss);
+        else
+          _lsFeatures[i]->get_citygml(ss);
+        ss << "\n";
+        buffer.push_back(std::string());
+        buffer.back().swap(ss.str());
+      }
+    },
+    [&](std::size_t begin, std::size_t end, std::vector<std::string>& buffer) {
+      _progress.add(end - begin);
+      for (std::size_t i = begin; i < end; i++) {
+        std::string filename = ofname + _lsFeatures[i]->get_layername() + ".gml" + compression;
+        if (ofs.find(filename) == ofs.end()) {
+          TextWriter* of = new TextWriter();
+          of->open(filename);
+          ofs.emplace(filename, of);
+          if (imgeo)
+            create_citygml_imgeo_header(*ofs[filename]);
+          else
+            create_citygml_header(*ofs[filename]);
+        }
+        *ofs[filename] << buffer[i - begin];
+      }
+    });
   for (auto it = ofs.begin(); it != ofs.end(); it++) {
-    std::wofstream& of = *(it->second);
+    TextWriter& of = *(it->second);
     of << "</CityModel>\n";
     of.close();
+    delete it->second;
   }
 }
 
-void Map3d::create_citygml_header(std::wostream& of) {
+void Map3d::create_citygml_header(TextWriter& of) {
     of << std::setprecision(3) << std::fixed;
     get_xml_header(of);
     get_citygml_namespaces(of);
@@ -304,7 +592,7 @@ void Map3d::create_citygml_header(std::wostream& of) {
     of << "</gml:boundedBy>\n";
 }
 
-void Map3d::create_citygml_imgeo_header(std::wostream& of) {
+void Map3d::create_citygml_imgeo_header(TextWriter& of) {
     of << std::setprecision(3) << std::fixed;
     get_xml_header(of);
     get_citygml_imgeo_namespaces(of);
@@ -322,17 +610,18 @@ void Map3d::create_citygml_imgeo_header(std::wostream& of) {
     of << "</gml:boundedBy>\n";
 }
 
-void Map3d::get_csv_buildings(std::wostream& of) {
+void Map3d::get_csv_buildings(TextWriter& of) {
   of << "id,roof,ground\n";
   for (auto& p : _lsFeatures) {
     if (p->get_class() == BUILDING) {
       Building* b = dynamic_cast<Building*>(p);
       b->get_csv(of);
     }
+    _progress.add();
   }
 }
 
-void Map3d::get_csv_buildings_all_elevation_points(std::wostream& of) {
+void Map3d::get_csv_buildings_all_elevation_points(TextWriter& of) {
   of << "id,allzvalues" << std::endl;
   for (auto& p : _lsFeatures) {
     if (p->get_class() == BUILDING) {
@@ -341,130 +630,825 @@ void Map3d::get_csv_buildings_all_elevation_points(std::wostream& of) {
       of << b->get_all_z_values();
       of << std::endl;
     }
+    _progress.add();
+  }
+}
+
+void Map3d::get_csv_buildings_multiple_heights(TextWriter& of) {
+  get_csv_multiple_heights_header(of);
+  for (auto& p : _lsFeatures) {
+    if (p->get_class() == BUILDING) {
+      Building* b = dynamic_cast<Building*>(p);
+      get_csv_multiple_heights(b, of);
+    }
+    _progress.add();
   }
 }
 
-void Map3d::get_csv_buildings_multiple_heights(std::wostream& of) {
-  //-- ground heights
-  std::vector<float> gpercentiles = {0.0f, 0.1f, 0.2f, 0.3f, 0.4f, 0.5f};
-  std::vector<float> rpercentiles = {0.0f, 0.1f, 0.25f, 0.5f, 0.75f, 0.9f, 0.95f, 0.99f};
+//-- ground and roof heights of CSV-BUILDINGS-MULTIPLE
+static const std::vector<float> CSV_GROUND_PERCENTILES = {0.0f, 0.1f, 0.2f, 0.3f, 0.4f, 0.5f};
+static const std::vector<float> CSV_ROOF_PERCENTILES = {0.0f, 0.1f, 0.25f, 0.5f, 0.75f, 0.9f, 0.95f, 0.99f};
+
+void Map3d::get_csv_multiple_heights_header(TextWriter& of) {
   of << std::setprecision(2) << std::fixed;
   of << "id";
-  for (auto& each : gpercentiles)
+  for (auto& each : CSV_GROUND_PERCENTILES)
     of << ",ground-" << each;
-  for (auto& each : rpercentiles)
+  for (auto& each : CSV_ROOF_PERCENTILES)
     of << ",roof-" << each;
   of << std::endl;
-  for (auto& p : _lsFeatures) {
-    if (p->get_class() == BUILDING) {
-      Building* b = dynamic_cast<Building*>(p);
-      of << b->get_id();
-      for (auto& each : gpercentiles) {
-        int h = b->get_height_ground_at_percentile(each);
-        of << "," << float(h)/100;
-      }
-      for (auto& each : rpercentiles) {
-        int h = b->get_height_roof_at_percentile(each);
-        of << "," << float(h)/100;
+}
+
+void Map3d::get_csv_multiple_heights(Building* b, TextWriter& of) {
+  of << b->get_id();
+  for (auto& each : CSV_GROUND_PERCENTILES) {
+    int h = b->get_height_ground_at_percentile(each);
+    of << "," << float(h)/100;
+  }
+  for (auto& each : CSV_ROOF_PERCENTILES) {
+    int h = b->get_height_roof_at_percentile(each);
+    of << "," << float(h)/100;
+  }
+  of << std::endl;
+}
+
+void Map3d::get_obj_per_feature(TextWriter& of) {
+  get_obj(of, _lsFeatures, true);
+}
+
+void Map3d::get_obj_per_class(TextWriter& of) {
+  std::vector<TopoFeature*> features;
+  for (int c = 0; c < 7; c++) {
+    for (auto& p : _lsFeatures) {
+      if (p->get_class() == c) {
+        features.push_back(p);
       }
-      of << std::endl;
     }
   }
+  get_obj(of, features, false);
 }
 
-void Map3d::get_obj_per_feature(std::wostream& of) {
-  std::unordered_map< std::string, unsigned long > dPts;
-  std::string fs;
-  
-  for (auto& p : _lsFeatures) {
-    fs += "o "; fs += p->get_id(); fs += "\n";
-    if (p->get_class() == BUILDING) {
-      Building* b = dynamic_cast<Building*>(p);
-      b->get_obj(dPts, _building_lod, b->get_mtl(), fs);
-    }
-    else {
-      p->get_obj(dPts, p->get_mtl(), fs);
-    }
+void Map3d::get_obj_feature(TopoFeature* p, std::unordered_map< std::string, unsigned long >& dPts, std::string& fs) {
+  if (p->get_class() == BUILDING) {
+    Building* b = dynamic_cast<Building*>(p);
+    b->get_obj(dPts, _building_lod, b->get_mtl(), fs);
   }
+  else {
+    p->get_obj(dPts, p->get_mtl(), fs);
+  }
+}
+
+/**
+ * write the features as OBJ, with an object per feature if objects is set
+ * 1. each feature is rendered once in parallel, numbering its own vertices
+ * 2. these are numbered in feature order, so the indices are the same as when
+ *    the features are written one after the other
+ * 3. the faces are renumbered in parallel and written in order
+ */
+void Map3d::get_obj(TextWriter& of, const std::vector<TopoFeature*>& features, bool objects) {
+  std::vector<std::string> faces;
+  std::vector< std::vector<unsigned long> > ids;
+  get_obj_vertices(of, features, faces, ids);
+
+  parallel_ordered<std::string>(features.size(),
+    [&](std::size_t begin, std::size_t end, std::string& fs) {
+      for (std::size_t i = begin; i < end; i++) {
+        if (objects) {
+          fs += "o "; fs += features[i]->get_id(); fs += "\n";
+        }
+        renumber_obj_faces(faces[i], ids[i], fs);
+        std::string().swap(faces[i]);
+        std::vector<unsigned long>().swap(ids[i]);
+      }
+    },
+    [&](std::size_t begin, std::size_t end, std::string& fs) {
+      _progress.add(end - begin);
+      of << fs;
+    });
+  of << std::endl;
+}
 
-  //-- sort the points in the map: simpler to copy to a vector
+/**
+ * steps 1 and 2 of get_obj(), the vertices are written to of
+ * faces[i] are the faces of features[i] with its vertices numbered from 1 in
+ * order of first use, ids[i] the numbers of these vertices in the file
+ */
+void Map3d::get_obj_vertices(TextWriter& of, const std::vector<TopoFeature*>& features, std::vector<std::string>& faces, std::vector< std::vector<unsigned long> >& ids) {
+  std::vector< std::vector<std::string> > keys(features.size());
+  faces.assign(features.size(), std::string());
+  ids.assign(features.size(), std::vector<unsigned long>());
+  parallel_for(features.size(), [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+      std::unordered_map< std::string, unsigned long > dPts;
+      get_obj_feature(features[i], dPts, faces[i]);
+      keys[i].resize(dPts.size());
+      for (auto& p : dPts)
+        keys[i][p.second - 1] = p.first;
+    }
+  });
+
+  std::unordered_map< std::string, unsigned long > dPts;
   std::vector<std::string> thepts;
-  thepts.resize(dPts.size());
-  for (auto& p : dPts)
-    thepts[p.second - 1] = p.first;
+  for (std::size_t i = 0; i < features.size(); i++) {
+    ids[i].reserve(keys[i].size());
+    for (auto& k : keys[i]) {
+      auto it = dPts.find(k);
+      if (it == dPts.end()) {
+        thepts.push_back(k);
+        it = dPts.emplace(k, thepts.size()).first;
+      }
+      ids[i].push_back(it->second);
+    }
+    std::vector<std::string>().swap(keys[i]);
+  }
   dPts.clear();
 
   of << "mtllib ./3dfier.mtl" << "\n";
   for (auto& p : thepts) {
     of << "v " << p << "\n";
   }
-  of << fs << std::endl;
 }
 
-void Map3d::get_obj_per_class(std::wostream& of) {
-  std::unordered_map< std::string, unsigned long > dPts;
-  std::string fs;
+/**
+ * step 3 of get_obj(), fs is appended to out with the vertex numbers of its
+ * "f" lines replaced by ids (ids[0] for vertex 1), the other lines are copied
+ */
+void Map3d::renumber_obj_faces(const std::string& fs, const std::vector<unsigned long>& ids, std::string& out) {
+  out.reserve(out.size() + fs.size() + fs.size() / 4);
+  std::size_t pos = 0;
+  while (pos < fs.size()) {
+    std::size_t eol = fs.find('\n', pos);
+    if (eol == std::string::npos)
+      eol = fs.size();
+    if (fs.compare(pos, 2, "f ") != 0) {
+      out.append(fs, pos, eol - pos);
+    }
+    else {
+      out += "f";
+      for (std::size_t i = pos + 1; i < eol; ) {
+        while (i < eol && fs[i] == ' ')
+          i++;
+        unsigned long n = 0;
+        while (i < eol && fs[i] >= '0' && fs[i] <= '9')
+          n = n * 10 + (fs[i++] - '0');
+        out += " "; out += std::to_string(ids[n - 1]);
+      }
+    }
+    out += "\n";
+    pos = eol + 1;
+  }
+}
+
+/**
+ * write the features as ASCII STL with a solid per class
+ * the facets are rendered in parallel and written in feature order; a map of
+ * vertices per feature is enough since it is only used to skip degenerate triangles
+ */
+void Map3d::get_stl(TextWriter& of) {
+  std::string fs[7];
+  
   for (int c = 0; c < 7; c++) {
+    std::vector<TopoFeature*> features;
     for (auto& p : _lsFeatures) {
       if (p->get_class() == c) {
-        if (p->get_class() == BUILDING) {
-          Building* b = dynamic_cast<Building*>(p);
-          b->get_obj(dPts, _building_lod, b->get_mtl(), fs);
-        }
-        else {
-          p->get_obj(dPts, p->get_mtl(), fs);
-        }
+        features.push_back(p);
       }
     }
+    parallel_ordered<std::string>(features.size(),
+      [&](std::size_t begin, std::size_t end, std::string& buffer) {
+        for (std::size_t i = begin; i < end; i++) {
+          std::unordered_map< std::string, unsigned long > dPts;
+          if (c == BUILDING) {
+            Building* b = dynamic_cast<Building*>(features[i]);
+            b->get_stl(dPts, _building_lod, buffer);
+          }
+          else {
+            features[i]->get_stl(dPts, buffer);
+          }
+        }
+      },
+      [&](std::size_t begin, std::size_t end, std::string& buffer) {
+        _progress.add(end - begin);
+        fs[c] += buffer;
+      });
   }
 
-  //-- sort the points in the map: simpler to copy to a vector
-  std::vector<std::string> thepts;
-  thepts.resize(dPts.size());
-  for (auto& p : dPts)
-    thepts[p.second - 1] = p.first;
-  dPts.clear();
+  write_stl_solids(of, fs);
+}
 
-  of << "mtllib ./3dfier.mtl\n";
-  for (auto& p : thepts) {
-    of << "v " << p << std::endl;
+/**
+ * write the facets of each class (fs[class]) as a separate solid
+ */
+void Map3d::write_stl_solids(TextWriter& of, const std::string* fs) {
+  for (int c = 0; c < 7; c++) {
+    of << "solid " << CLASSNAMES[c] << "\n" << fs[c] << "endsolid " << CLASSNAMES[c] << std::endl;
   }
-  of << fs << std::endl;
 }
 
-void Map3d::get_stl(std::wostream& of) {
-  std::unordered_map< std::string, unsigned long > dPts;
-  std::string fs[7];
-  
+
+unsigned long Map3d::get_stl_binary_feature(TopoFeature* p, const Point2& offset, std::string* fs) {
+  if (p->get_class() == BUILDING) {
+    Building* b = dynamic_cast<Building*>(p);
+    return b->get_stl_binary(_building_lod, offset, fs);
+  }
+  return p->get_stl_binary(offset, fs);
+}
+
+/**
+ * write the features as binary STL, in one solid sorted per class with the
+ * class in the attribute bytes of each triangle
+ * the coordinates are float32 so x/y are relative to the integer lower-left corner
+ * of the bbox, this offset is written in the header
+ * the triangles are counted first since the count precedes them, then the records
+ * are rendered in parallel and written in feature order
+ */
+void Map3d::get_stl_binary(TextWriter& of) {
+  Point2 offset(std::floor(bg::get<bg::min_corner, 0>(_bbox)), std::floor(bg::get<bg::min_corner, 1>(_bbox)));
+  std::vector<TopoFeature*> features;
   for (int c = 0; c < 7; c++) {
     for (auto& p : _lsFeatures) {
       if (p->get_class() == c) {
-        if (p->get_class() == BUILDING) {
-          Building* b = dynamic_cast<Building*>(p);
-          b->get_stl(dPts, _building_lod, fs[0]);
-        }
-        else {
-          p->get_stl(dPts, fs[c]);
-        }
+        features.push_back(p);
       }
     }
   }
 
-  // Is there a better way to handle this?
-  // Define each class as a separate solid
-  fs[0] = "solid Building\n"   + fs[0]; fs[0] += "endsolid Building";
-  fs[1] = "solid Water\n"      + fs[1]; fs[1] += "endsolid Water";
-  fs[2] = "solid Bridge\n"     + fs[2]; fs[2] += "endsolid Bridge";
-  fs[3] = "solid Road\n"       + fs[3]; fs[3] += "endsolid Road";
-  fs[4] = "solid Terrain\n"    + fs[4]; fs[4] += "endsolid Terrain";
-  fs[5] = "solid Forest\n"     + fs[5]; fs[5] += "endsolid Forest";
-  fs[6] = "solid Separation\n" + fs[6]; fs[6] += "endsolid Separation";
+  std::vector<unsigned long> counts(features.size());
+  parallel_for(features.size(), [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++)
+      counts[i] = get_stl_binary_feature(features[i], offset, NULL);
+  });
+  unsigned long long total = 0;
+  for (auto& c : counts)
+    total += c;
+  if (total > 0xFFFFFFFFULL) {
+    std::cerr << "WARNING: more than 2^32 triangles, the binary STL triangle count is truncated.\n";
+  }
+
+  char header[80];
+  std::memset(header, ' ', sizeof(header));
+  int n = std::snprintf(header, sizeof(header), "3dfier binary STL; attribute=class; offset %.0f %.0f", offset.x(), offset.y());
+  if (n > 0 && n < int(sizeof(header)))
+    header[n] = ' ';
+  of.write(header, sizeof(header));
+  uint32_t count = uint32_t(total);
+  of.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+  parallel_ordered<std::string>(features.size(),
+    [&](std::size_t begin, std::size_t end, std::string& buffer) {
+      buffer.reserve(50 * std::accumulate(counts.begin() + begin, counts.begin() + end, 0UL));
+      for (std::size_t i = begin; i < end; i++)
+        get_stl_binary_feature(features[i], offset, &buffer);
+    },
+    [&](std::size_t begin, std::size_t end, std::string& buffer) {
+      _progress.add(end - begin);
+      of.write(buffer.data(), buffer.size());
+    });
+}
+
+void Map3d::get_mesh_feature(TopoFeature* p, const Point3& centre, float featureid, Mesh& mesh) {
+  if (p->get_class() == BUILDING) {
+    Building* b = dynamic_cast<Building*>(p);
+    b->get_mesh(_building_lod, centre, featureid, mesh);
+  }
+  else {
+    p->get_mesh(centre, featureid, mesh);
+  }
+}
 
+/**
+ * write the features as glTF 2.0, as GLB if binary or else as JSON with the
+ * buffer in a .bin file next to it
+ * the vertices are relative to the centre of the bbox (RTC), the root node moves
+ * them back and turns the z-up coordinates into the y-up of glTF
+ */
+bool Map3d::get_gltf(TextWriter& of, std::string ofname, bool binary) {
+  Point3 centre((bg::get<bg::min_corner, 0>(_bbox) + bg::get<bg::max_corner, 0>(_bbox)) / 2,
+                (bg::get<bg::min_corner, 1>(_bbox) + bg::get<bg::max_corner, 1>(_bbox)) / 2,
+                0);
+  if (binary) {
+    return get_gltf_features(of, _lsFeatures, centre);
+  }
+  std::string binpath = ofname;
+  std::size_t dot = binpath.find_last_of('.');
+  std::size_t slash = binpath.find_last_of("/\\");
+  if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+    binpath = binpath.substr(0, dot);
+  }
+  return get_gltf_features(of, _lsFeatures, centre, binpath + ".bin");
+}
+
+/**
+ * a mesh per class with POSITION, _FEATURE_ID_0 (EXT_mesh_features) and indices,
+ * the feature ids are the index in the list of ids in the extras of the mesh,
+ * stored as float so a class can have at most MESH_MAX_FEATURES features
+ * the meshes of the features are built in parallel and appended in order
+ * without binpath a GLB is written, otherwise the JSON and the buffer in binpath
+ * zrange is set to the lowest and highest z of the vertices
+ */
+bool Map3d::get_gltf_features(TextWriter& of, const std::vector<TopoFeature*>& features, const Point3& centre, std::string binpath, double* zrange) {
+  //-- diffuse colours of resources/3dfier.mtl
+  static const double colours[][3] = { {0.87, 0.26, 0.28}, {0.35, 0.65, 0.90}, {0.80, 0.60, 0.20},
+    {0.60, 0.60, 0.60}, {0.90, 0.90, 0.75}, {0.34, 0.70, 0.35}, {0.32, 0.16, 0.40} };
+  std::vector<Mesh> meshes(7);
+  std::vector< std::vector<std::string> > ids(7);
   for (int c = 0; c < 7; c++) {
-    of << fs[c] << std::endl;
+    std::vector<TopoFeature*> cfeatures;
+    for (auto& p : features) {
+      if (p->get_class() == c) {
+        cfeatures.push_back(p);
+        ids[c].push_back(p->get_id());
+      }
+    }
+    if (cfeatures.size() > MESH_MAX_FEATURES) {
+      std::cerr << "ERROR: glTF feature ids are exact up to " << MESH_MAX_FEATURES << " features per class, "
+        << CLASSNAMES[c] << " has " << cfeatures.size() << std::endl;
+      return false;
+    }
+    Mesh& cmesh = meshes[c];
+    parallel_ordered<Mesh>(cfeatures.size(),
+      [&](std::size_t begin, std::size_t end, Mesh& mesh) {
+        for (std::size_t i = begin; i < end; i++)
+          get_mesh_feature(cfeatures[i], centre, float(i), mesh);
+      },
+      [&](std::size_t begin, std::size_t end, Mesh& mesh) {
+        _progress.add(end - begin);
+        unsigned int base = (unsigned int)(cmesh.positions.size() / 3);
+        cmesh.positions.insert(cmesh.positions.end(), mesh.positions.begin(), mesh.positions.end());
+        cmesh.featureids.insert(cmesh.featureids.end(), mesh.featureids.begin(), mesh.featureids.end());
+        cmesh.indices.reserve(cmesh.indices.size() + mesh.indices.size());
+        for (auto& i : mesh.indices)
+          cmesh.indices.push_back(base + i);
+      });
+  }
+
+  nlohmann::json j;
+  j["asset"] = { {"version", "2.0"}, {"generator", "3dfier"} };
+  j["extensionsUsed"] = { "EXT_mesh_features" };
+  j["scene"] = 0;
+  j["scenes"] = { { {"nodes", {0}} } };
+  j["nodes"].push_back({ {"name", "3dfier"},
+    {"matrix", { 1, 0, 0, 0,  0, 0, -1, 0,  0, 1, 0, 0,
+                 centre.get<0>(), centre.get<2>(), -centre.get<1>(), 1 }} });
+  std::size_t byteLength = 0;
+  if (zrange != NULL) {
+    zrange[0] = zrange[1] = centre.get<2>();
+  }
+  for (int c = 0; c < 7; c++) {
+    Mesh& mesh = meshes[c];
+    if (mesh.indices.empty())
+      continue;
+    std::size_t nv = mesh.positions.size() / 3;
+    float min[3], max[3];
+    for (int k = 0; k < 3; k++) {
+      min[k] = max[k] = mesh.positions[k];
+    }
+    for (std::size_t i = 0; i < nv; i++) {
+      for (int k = 0; k < 3; k++) {
+        min[k] = std::min(min[k], mesh.positions[3 * i + k]);
+        max[k] = std::max(max[k], mesh.positions[3 * i + k]);
+      }
+    }
+    if (zrange != NULL) {
+      if (byteLength == 0 || min[2] + centre.get<2>() < zrange[0])
+        zrange[0] = min[2] + centre.get<2>();
+      if (byteLength == 0 || max[2] + centre.get<2>() > zrange[1])
+        zrange[1] = max[2] + centre.get<2>();
+    }
+    std::size_t accessor = j["accessors"].size();
+    std::size_t sizes[] = { mesh.positions.size() * sizeof(float), mesh.featureids.size() * sizeof(float), mesh.indices.size() * sizeof(unsigned int) };
+    for (int k = 0; k < 3; k++) {
+      j["bufferViews"].push_back({ {"buffer", 0}, {"byteOffset", byteLength}, {"byteLength", sizes[k]}, {"target", k < 2 ? 34962 : 34963} });
+      byteLength += sizes[k];
+    }
+    j["accessors"].push_back({ {"bufferView", accessor}, {"componentType", 5126}, {"count", nv}, {"type", "VEC3"},
+      {"min", { min[0], min[1], min[2] }}, {"max", { max[0], max[1], max[2] }} });
+    j["accessors"].push_back({ {"bufferView", accessor + 1}, {"componentType", 5126}, {"count", nv}, {"type", "SCALAR"} });
+    j["accessors"].push_back({ {"bufferView", accessor + 2}, {"componentType", 5125}, {"count", mesh.indices.size()}, {"type", "SCALAR"} });
+    std::size_t material = j["materials"].size();
+    j["materials"].push_back({ {"name", CLASSNAMES[c]},
+      {"pbrMetallicRoughness", { {"baseColorFactor", { std::pow(colours[c][0], 2.2), std::pow(colours[c][1], 2.2), std::pow(colours[c][2], 2.2), 1.0 }},
+                                 {"metallicFactor", 0.0}, {"roughnessFactor", 1.0} }} });
+    nlohmann::json primitive = { {"attributes", { {"POSITION", accessor}, {"_FEATURE_ID_0", accessor + 1} }},
+      {"indices", accessor + 2}, {"material", material}, {"mode", 4} };
+    primitive["extensions"]["EXT_mesh_features"]["featureIds"] = { { {"featureCount", ids[c].size()}, {"attribute", 0} } };
+    j["meshes"].push_back({ {"name", CLASSNAMES[c]}, {"primitives", { primitive }}, {"extras", { {"ids", ids[c]} }} });
+    j["nodes"][0]["children"].push_back(j["nodes"].size());
+    j["nodes"].push_back({ {"name", CLASSNAMES[c]}, {"mesh", j["meshes"].size() - 1} });
+  }
+  if (byteLength > 0) {
+    j["buffers"].push_back({ {"byteLength", byteLength} });
+  }
+
+  TextWriter bin;
+  TextWriter* ob = &of;
+  if (binpath.empty()) {
+    //-- GLB: header, JSON chunk padded with spaces and BIN chunk padded with zeros
+    std::string json = j.dump();
+    json.append((4 - json.size() % 4) % 4, ' ');
+    uint32_t binLength = uint32_t((byteLength + 3) / 4 * 4);
+    uint32_t header[5] = { 0x46546C67, 2, 0, uint32_t(json.size()), 0x4E4F534A };
+    header[2] = uint32_t(12 + 8 + json.size() + (byteLength > 0 ? 8 + binLength : 0));
+    of.write(reinterpret_cast<const char*>(header), sizeof(header));
+    of << json;
+    if (byteLength > 0) {
+      uint32_t chunk[2] = { binLength, 0x004E4942 };
+      of.write(reinterpret_cast<const char*>(chunk), sizeof(chunk));
+    }
+  }
+  else {
+    if (byteLength > 0) {
+      std::size_t slash = binpath.find_last_of("/\\");
+      j["buffers"][0]["uri"] = (slash == std::string::npos) ? binpath : binpath.substr(slash + 1);
+      if (bin.open(binpath) == false) {
+        std::cerr << "ERROR: cannot write the glTF buffer " << binpath << std::endl;
+        return false;
+      }
+      ob = &bin;
+    }
+    of << j.dump() << "\n";
+  }
+  for (auto& mesh : meshes) {
+    if (mesh.indices.empty())
+      continue;
+    ob->write(reinterpret_cast<const char*>(mesh.positions.data()), mesh.positions.size() * sizeof(float));
+    ob->write(reinterpret_cast<const char*>(mesh.featureids.data()), mesh.featureids.size() * sizeof(float));
+    ob->write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+  }
+  if (binpath.empty() && byteLength % 4 != 0) {
+    ob->write("\0\0\0", 4 - byteLength % 4);
+  }
+  bin.close();
+  return true;
+}
+
+/**
+ * matrix (column-major) from the projected srs to ECEF, with a local
+ * east-north-up frame at centre
+ * the vertical datum is ignored: the heights (NAP for the Dutch data) are used
+ * as heights above the ellipsoid, there is no geoid model to convert them
+ */
+static bool get_ecef_transform(const std::string& srs, const Point2& centre, double matrix[16]) {
+  OGRSpatialReference source, wgs84;
+  if (srs.empty()) {
+    std::cerr << "ERROR: the SRS of the input polygons is unknown, set it with the option 'srs'.\n";
+    return false;
+  }
+  if (source.SetFromUserInput(srs.c_str()) != OGRERR_NONE) {
+    std::cerr << "ERROR: the SRS '" << srs << "' is unknown.\n";
+    return false;
+  }
+  if (source.IsProjected() == false) {
+    std::cerr << "ERROR: the SRS '" << srs << "' is not projected.\n";
+    return false;
+  }
+  if (source.IsCompound())
+    source.StripVertical();
+  if (wgs84.importFromEPSG(4326) != OGRERR_NONE)
+    return false;
+#if GDAL_VERSION_MAJOR >= 3
+  source.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+  wgs84.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+#endif
+  OGRCoordinateTransformation* ct = OGRCreateCoordinateTransformation(&source, &wgs84);
+  double lon = centre.x(), lat = centre.y();
+  bool ok = ct != NULL && ct->Transform(1, &lon, &lat) != 0;
+  if (ct != NULL)
+    OGRCoordinateTransformation::DestroyCT(ct);
+  if (ok == false) {
+    std::cerr << "ERROR: cannot transform the centre of the data from '" << srs << "' to WGS84.\n";
+    return false;
+  }
+  lon *= M_PI / 180.0;
+  lat *= M_PI / 180.0;
+  const double a = 6378137.0;
+  const double e2 = 6.69437999014e-3;
+  double n = a / std::sqrt(1 - e2 * std::sin(lat) * std::sin(lat));
+  double p[3] = { n * std::cos(lat) * std::cos(lon), n * std::cos(lat) * std::sin(lon), n * (1 - e2) * std::sin(lat) };
+  double east[3] = { -std::sin(lon), std::cos(lon), 0 };
+  double north[3] = { -std::sin(lat) * std::cos(lon), -std::sin(lat) * std::sin(lon), std::cos(lat) };
+  double up[3] = { std::cos(lat) * std::cos(lon), std::cos(lat) * std::sin(lon), std::sin(lat) };
+  for (int k = 0; k < 3; k++) {
+    matrix[k] = east[k];
+    matrix[4 + k] = north[k];
+    matrix[8 + k] = up[k];
+    matrix[12 + k] = p[k] - east[k] * centre.x() - north[k] * centre.y();
+  }
+  matrix[3] = matrix[7] = matrix[11] = 0;
+  matrix[15] = 1;
+  return true;
+}
+
+/**
+ * write the features as 3D Tiles 1.1 in the folder ofname: a quadtree of tiles
+ * with a GLB per leaf in tiles/ and the tileset.json
+ * the tiles are split with the rtrees until they have at most TILEFEATURES
+ * features, each feature is in the tile with the centre of its bbox, which
+ * bounds the memory needed per tile; the leaves are written in parallel
+ */
+bool Map3d::get_3dtiles(std::string ofname) {
+  const std::size_t TILEFEATURES = 2000;
+  const int TILEDEPTH = 12;
+  struct Tile {
+    Box2                      box;     //-- the quadrant, for the assignment of the features
+    Box2                      bounds;  //-- bbox of its features
+    double                    zrange[2];
+    std::string               name;
+    int                       depth;
+    std::vector<TopoFeature*> features;
+    std::vector<std::size_t>  children;
+  };
+  double matrix[16];
+  if (get_ecef_transform(_srs, Point2((bg::get<bg::min_corner, 0>(_bbox) + bg::get<bg::max_corner, 0>(_bbox)) / 2,
+                                      (bg::get<bg::min_corner, 1>(_bbox) + bg::get<bg::max_corner, 1>(_bbox)) / 2), matrix) == false) {
+    return false;
+  }
+  boost::system::error_code ec;
+  boost::filesystem::create_directories(boost::filesystem::path(ofname) / "tiles", ec);
+  if (ec) {
+    std::cerr << "ERROR: cannot create the folder " << ofname << ": " << ec.message() << std::endl;
+    return false;
+  }
+
+  double rootmax[2] = { bg::get<bg::max_corner, 0>(_bbox), bg::get<bg::max_corner, 1>(_bbox) };
+  auto in_box = [&](const Box2& featurebox, const Box2& box) {
+    double c[2] = { (bg::get<bg::min_corner, 0>(featurebox) + bg::get<bg::max_corner, 0>(featurebox)) / 2,
+                    (bg::get<bg::min_corner, 1>(featurebox) + bg::get<bg::max_corner, 1>(featurebox)) / 2 };
+    return c[0] >= bg::get<bg::min_corner, 0>(box) && (c[0] < bg::get<bg::max_corner, 0>(box) || bg::get<bg::max_corner, 0>(box) == rootmax[0]) &&
+           c[1] >= bg::get<bg::min_corner, 1>(box) && (c[1] < bg::get<bg::max_corner, 1>(box) || bg::get<bg::max_corner, 1>(box) == rootmax[1]);
+  };
+  auto query = [&](Tile& tile) {
+    std::vector<PairIndexed> re;
+    _rtree.query(bgi::intersects(tile.box), std::back_inserter(re));
+    _rtree_buildings.query(bgi::intersects(tile.box), std::back_inserter(re));
+    for (auto& v : re) {
+      if (in_box(v.first, tile.box)) {
+        tile.features.push_back(v.second);
+        if (tile.features.size() == 1)
+          tile.bounds = v.first;
+        else
+          bg::expand(tile.bounds, v.first);
+      }
+    }
+  };
+
+  std::vector<Tile> tiles(1);
+  tiles[0].box = _bbox;
+  tiles[0].bounds = _bbox;
+  tiles[0].zrange[0] = tiles[0].zrange[1] = 0;
+  tiles[0].name = "0";
+  tiles[0].depth = 0;
+  query(tiles[0]);
+  for (std::size_t t = 0; t < tiles.size(); t++) {
+    if (tiles[t].features.size() <= TILEFEATURES || tiles[t].depth == TILEDEPTH)
+      continue;
+    double mid[2] = { (bg::get<bg::min_corner, 0>(tiles[t].box) + bg::get<bg::max_corner, 0>(tiles[t].box)) / 2,
+                      (bg::get<bg::min_corner, 1>(tiles[t].box) + bg::get<bg::max_corner, 1>(tiles[t].box)) / 2 };
+    for (int q = 0; q < 4; q++) {
+      Tile child;
+      child.box = Box2(
+        Point2(q % 2 == 0 ? bg::get<bg::min_corner, 0>(tiles[t].box) : mid[0], q < 2 ? bg::get<bg::min_corner, 1>(tiles[t].box) : mid[1]),
+        Point2(q % 2 == 0 ? mid[0] : bg::get<bg::max_corner, 0>(tiles[t].box), q < 2 ? mid[1] : bg::get<bg::max_corner, 1>(tiles[t].box)));
+      child.bounds = child.box;
+      child.zrange[0] = child.zrange[1] = 0;
+      child.name = tiles[t].name + "_" + std::to_string(q);
+      child.depth = tiles[t].depth + 1;
+      query(child);
+      if (child.features.empty() == false) {
+        tiles[t].children.push_back(tiles.size());
+        tiles.push_back(child);
+      }
+    }
+    std::vector<TopoFeature*>().swap(tiles[t].features);
+  }
+
+  std::vector<std::size_t> leaves;
+  for (std::size_t t = 0; t < tiles.size(); t++) {
+    if (tiles[t].children.empty() && tiles[t].features.empty() == false)
+      leaves.push_back(t);
+  }
+  std::atomic<bool> success(true);
+  parallel_for(leaves.size(), [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+      Tile& tile = tiles[leaves[i]];
+      Point3 centre((bg::get<bg::min_corner, 0>(tile.bounds) + bg::get<bg::max_corner, 0>(tile.bounds)) / 2,
+                    (bg::get<bg::min_corner, 1>(tile.bounds) + bg::get<bg::max_corner, 1>(tile.bounds)) / 2,
+                    0);
+      TextWriter of;
+      std::string filename = (boost::filesystem::path(ofname) / "tiles" / (tile.name + ".glb")).string();
+      if (of.open(filename) == false) {
+        std::cerr << "ERROR: cannot write the tile " << filename << std::endl;
+        success = false;
+        continue;
+      }
+      if (get_gltf_features(of, tile.features, centre, "", tile.zrange) == false)
+        success = false;
+      of.close();
+    }
+  });
+  if (success == false)
+    return false;
+
+  //-- the bounds of the parents are the union of the bounds of their children
+  for (std::size_t t = tiles.size(); t-- > 0; ) {
+    for (auto& c : tiles[t].children) {
+      if (c == tiles[t].children.front()) {
+        tiles[t].bounds = tiles[c].bounds;
+        tiles[t].zrange[0] = tiles[c].zrange[0];
+        tiles[t].zrange[1] = tiles[c].zrange[1];
+      }
+      else {
+        bg::expand(tiles[t].bounds, tiles[c].bounds);
+        tiles[t].zrange[0] = std::min(tiles[t].zrange[0], tiles[c].zrange[0]);
+        tiles[t].zrange[1] = std::max(tiles[t].zrange[1], tiles[c].zrange[1]);
+      }
+    }
+  }
+
+  std::function<nlohmann::json(std::size_t)> tile_json = [&](std::size_t t) {
+    const Tile& tile = tiles[t];
+    double h[3] = { (bg::get<bg::max_corner, 0>(tile.bounds) - bg::get<bg::min_corner, 0>(tile.bounds)) / 2,
+                    (bg::get<bg::max_corner, 1>(tile.bounds) - bg::get<bg::min_corner, 1>(tile.bounds)) / 2,
+                    (tile.zrange[1] - tile.zrange[0]) / 2 };
+    nlohmann::json j;
+    j["boundingVolume"]["box"] = { bg::get<bg::min_corner, 0>(tile.bounds) + h[0], bg::get<bg::min_corner, 1>(tile.bounds) + h[1], tile.zrange[0] + h[2],
+                                   h[0], 0, 0,  0, h[1], 0,  0, 0, h[2] };
+    //-- a parent has no content of its own, its children are needed as soon as it is visible
+    j["geometricError"] = tile.children.empty() ? 0.0 : 2 * std::sqrt(h[0] * h[0] + h[1] * h[1] + h[2] * h[2]);
+    if (tile.children.empty()) {
+      j["content"]["uri"] = "tiles/" + tile.name + ".glb";
+    }
+    for (auto& c : tile.children) {
+      j["children"].push_back(tile_json(c));
+    }
+    return j;
+  };
+  nlohmann::json j;
+  j["asset"] = { {"version", "1.1"}, {"generator", "3dfier"} };
+  j["root"] = tile_json(0);
+  j["root"]["refine"] = "ADD";
+  j["geometricError"] = j["root"]["geometricError"].get<double>() * 2;
+  j["root"]["transform"] = std::vector<double>(matrix, matrix + 16);
+  TextWriter of;
+  std::string filename = (boost::filesystem::path(ofname) / "tileset.json").string();
+  if (of.open(filename) == false) {
+    std::cerr << "ERROR: cannot write " << filename << std::endl;
+    return false;
+  }
+  of << j.dump() << "\n";
+  std::clog << "\t(" << leaves.size() << " tiles)\n";
+  return true;
+}
+
+/**
+ * table and column names laundered like the PostgreSQL driver of GDAL, quoted
+ */
+static std::string pg_identifier(std::string name) {
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+  std::replace(name.begin(), name.end(), '-', '_');
+  std::replace(name.begin(), name.end(), ' ', '_');
+  std::replace(name.begin(), name.end(), '#', '_');
+  std::string quoted = "\"";
+  for (auto& c : name) {
+    if (c == '"')
+      quoted += '"';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+static std::string pg_type(OGRFieldType type) {
+  switch (type) {
+  case OFTInteger:   return "integer";
+  case OFTInteger64: return "bigint";
+  case OFTReal:      return "double precision";
+  case OFTDate:      return "date";
+  case OFTTime:      return "time";
+  case OFTDateTime:  return "timestamp";
+  default:           return "varchar";
   }
 }
 
+/**
+ * append a value to a row in the text format of COPY
+ */
+static void copy_value(std::string& row, const std::string& value) {
+  for (auto& c : value) {
+    switch (c) {
+    case '\\': row += "\\\\"; break;
+    case '\n': row += "\\n"; break;
+    case '\r': row += "\\r"; break;
+    case '\t': row += "\\t"; break;
+    default:   row += c;
+    }
+  }
+}
+
+/**
+ * write a SQL script that loads the features in PostGIS with COPY, to be run with psql
+ * a table per layer with the same columns as get_postgis_output(), the geometry
+ * as hex EWKB; the rows are rendered in parallel and the primary keys and spatial
+ * indices are only created after all rows are loaded
+ */
+bool Map3d::get_postgis_copy(TextWriter& of, bool pdok, bool citygml) {
+  std::vector<std::string> layernames;
+  std::unordered_map<std::string, std::vector<TopoFeature*> > layers;
+  for (auto& f : _lsFeatures) {
+    std::string layername = f->get_layername();
+    if (layers.find(layername) == layers.end())
+      layernames.push_back(layername);
+    layers[layername].push_back(f);
+  }
+
+  of << "-- generated by 3dfier, load with: psql -v ON_ERROR_STOP=1 -f <this file>\n";
+  of << "SET client_encoding = 'UTF8';\n";
+  of << "BEGIN;\n";
+  for (auto& layername : layernames) {
+    std::vector<TopoFeature*>& features = layers[layername];
+    bool building = features.front()->get_class() == BUILDING;
+    std::vector< std::pair<std::string, OGRFieldType> > columns;
+    for (auto& attr : features.front()->get_attributes())
+      columns.push_back(std::make_pair(attr.first, attr.second.first));
+    std::sort(columns.begin(), columns.end());
+    std::string table = pg_identifier(layername);
+
+    of << "CREATE TABLE " << table << " (ogc_fid serial, wkb_geometry geometry(MultiPolygonZ, 7415), \"3df_id\" varchar, \"3df_class\" varchar";
+    if (building)
+      of << ", baseheight double precision, roofheight double precision";
+    for (auto& c : columns)
+      of << ", " << pg_identifier(c.first) << " " << pg_type(c.second);
+    if (pdok)
+      of << ", xml varchar";
+    of << ");\n";
+    of << "COPY " << table << " (wkb_geometry, \"3df_id\", \"3df_class\"";
+    if (building)
+      of << ", baseheight, roofheight";
+    for (auto& c : columns)
+      of << ", " << pg_identifier(c.first);
+    if (pdok)
+      of << ", xml";
+    of << ") FROM stdin;\n";
+
+    parallel_ordered<std::string>(features.size(),
+      [&](std::size_t begin, std::size_t end, std::string& buffer) {
+        std::string wkb;
+        for (std::size_t i = begin; i < end; i++) {
+          TopoFeature* f = features[i];
+          wkb.clear();
+          f->get_wkb(wkb, 7415);
+          append_hex(buffer, wkb);
+          buffer += '\t';
+          copy_value(buffer, f->get_id());
+          buffer += '\t';
+          buffer += CLASSNAMES[f->get_class()];
+          if (building) {
+            Building* b = dynamic_cast<Building*>(f);
+            float hbase = z_to_float(b->get_height_base());
+            TextWriter heights;
+            heights << std::fixed << std::setprecision(2) << '\t' << hbase << '\t' << z_to_float(b->get_height()) - hbase;
+            buffer += heights.str();
+          }
+          AttributeMap& attributes = f->get_attributes();
+          for (auto& c : columns) {
+            buffer += '\t';
+            auto it = attributes.find(c.first);
+            if (it == attributes.end() ||
+                (it->second.first == OFTDateTime && it->second.second == "0000/00/00 00:00:00") ||
+                (it->second.first != OFTString && it->second.second.empty()))
+              buffer += "\\N";
+            else
+              copy_value(buffer, it->second.second);
+          }
+          if (pdok) {
+            TextWriter ss;
+            ss << std::fixed << std::setprecision(3);
+            if (citygml)
+              f->get_citygml(ss);
+            else
+              f->get_citygml_imgeo(ss);
+            buffer += '\t';
+            copy_value(buffer, ss.str());
+          }
+          buffer += '\n';
+        }
+      },
+      [&](std::size_t begin, std::size_t end, std::string& buffer) {
+        _progress.add(end - begin);
+        of << buffer;
+      });
+    of << "\\.\n";
+  }
+  for (auto& layername : layernames) {
+    std::string table = pg_identifier(layername);
+    of << "ALTER TABLE " << table << " ADD PRIMARY KEY (ogc_fid);\n";
+    of << "CREATE INDEX ON " << table << " USING GIST (wkb_geometry);\n";
+  }
+  of << "COMMIT;\n";
+  for (auto& layername : layernames) {
+    of << "ANALYZE " << pg_identifier(layername) << ";\n";
+  }
+  return true;
+}
 
 bool Map3d::get_postgis_output(std::string connstr, bool pdok, bool citygml) {
 #if GDAL_VERSION_MAJOR < 2
@@ -521,8 +1505,7 @@ bool Map3d::get_postgis_output(std::string connstr, bool pdok, bool citygml) {
     
     if (pdok) {
       //Add additional attribute describing CityGML of feature
-      std::wstring_convert<codecvt<wchar_t, char, std::mbstate_t>>converter;
-      std::wstringstream ss;
+      TextWriter ss;
       ss << std::fixed << std::setprecision(3);
       if (citygml) {
         f->get_citygml(ss);
@@ -530,9 +1513,7 @@ bool Map3d::get_postgis_output(std::string connstr, bool pdok, bool citygml) {
       else {
         f->get_citygml_imgeo(ss);
       }
-      std::string gmlAttribute = converter.to_bytes(ss.str());
-      ss.clear();
-      extraAttribute["xml"] = std::make_pair(OFTString, gmlAttribute);
+      extraAttribute["xml"] = std::make_pair(OFTString, ss.str());
     }
     if (!f->get_shape(layers[layername], true, extraAttribute)) {
       return false;
@@ -547,6 +1528,7 @@ bool Map3d::get_postgis_output(std::string connstr, bool pdok, bool citygml) {
         return false;
       }
     }
+    _progress.add();
     i++;
   }
   if (dataSource->CommitTransaction() != OGRERR_NONE) {
@@ -576,6 +1558,7 @@ bool Map3d::get_gdal_output(std::string filename, std::string drivername, bool m
     }
     for (auto& f : _lsFeatures) {
       f->get_shape(layer, false);
+      _progress.add();
     }
     GDALClose(dataSource);
   }
@@ -599,9 +1582,100 @@ bool Map3d::get_gdal_output(std::string filename, std::string drivername, bool m
       if (!f->get_shape(layers[layername], true)) {
         return false;
       }
+      _progress.add();
+    }
+    GDALClose(dataSource);
+  }
+  return true;
+#endif
+}
+
+/**
+ * write a file per layer (filename + layername + extension) with a GDAL driver
+ * for large files with a spatial index, like FlatGeobuf and (Geo)Parquet
+ * the features are written in the Hilbert order of the centre of their bbox so
+ * features close together are close in the file; the OGR features (geometry
+ * and attributes) are created in parallel in batches and added in order
+ */
+bool Map3d::get_gdal_output_hilbert(std::string filename, std::string drivername, std::string extension) {
+#if GDAL_VERSION_MAJOR < 3
+  std::cerr << "ERROR: cannot write " << drivername << " files with GDAL < 3.0.\n";
+  return false;
+#else
+  if (GDALGetDriverCount() == 0)
+    GDALAllRegister();
+  GDALDriver *driver = GetGDALDriverManager()->GetDriverByName(drivername.c_str());
+  if (driver == NULL) {
+    std::cerr << "ERROR: the GDAL driver " << drivername << " is not available.\n";
+    return false;
+  }
+
+  std::vector<std::string> layernames;
+  std::unordered_map<std::string, std::vector< std::pair<uint64_t, TopoFeature*> > > layers;
+  for (auto& f : _lsFeatures) {
+    std::string layername = f->get_layername();
+    if (layers.find(layername) == layers.end())
+      layernames.push_back(layername);
+    Point2 centre;
+    bg::centroid(f->get_bbox2d(), centre);
+    layers[layername].push_back(std::make_pair(hilbert_index(centre, _bbox), f));
+  }
+
+  char** options = NULL;
+  if (drivername == "FlatGeobuf")
+    options = CSLSetNameValue(options, "SPATIAL_INDEX", "YES");
+  for (auto& layername : layernames) {
+    std::vector< std::pair<uint64_t, TopoFeature*> >& features = layers[layername];
+    std::stable_sort(features.begin(), features.end(),
+      [](const std::pair<uint64_t, TopoFeature*>& a, const std::pair<uint64_t, TopoFeature*>& b) { return a.first < b.first; });
+
+    std::string layerfilename = filename + layername + extension;
+    GDALDataset* dataSource = driver->Create(layerfilename.c_str(), 0, 0, 0, GDT_Unknown, NULL);
+    if (dataSource == NULL) {
+      std::cerr << "ERROR: Cannot open file '" + layerfilename + "' for writing" << std::endl;
+      CSLDestroy(options);
+      return false;
     }
+    TopoFeature* first = features.front().second;
+    OGRLayer *layer = create_gdal_layer(driver, dataSource, layerfilename, layername, first->get_attributes(), first->get_class() == BUILDING, options);
+    if (layer == NULL) {
+      std::cerr << "ERROR: Cannot open file '" + layerfilename + "' for writing" << std::endl;
+      GDALClose(dataSource);
+      CSLDestroy(options);
+      return false;
+    }
+    OGRFeatureDefn* featureDefn = layer->GetLayerDefn();
+    bool success = true;
+    parallel_ordered< std::vector<OGRFeature*> >(features.size(),
+      [&](std::size_t begin, std::size_t end, std::vector<OGRFeature*>& buffer) {
+        for (std::size_t i = begin; i < end; i++) {
+          TopoFeature* f = features[i].second;
+          buffer.push_back(f->get_ogr_feature(featureDefn, CLASSNAMES[f->get_class()], true));
+        }
+      },
+      [&](std::size_t begin, std::size_t end, std::vector<OGRFeature*>& buffer) {
+        _progress.add(end - begin);
+        for (std::size_t i = begin; i < end; i++) {
+          OGRFeature* feature = buffer[i - begin];
+          if (feature == NULL) {
+            success = false;
+            continue;
+          }
+          if (success && layer->CreateFeature(feature) != OGRERR_NONE) {
+            std::cerr << "Failed to create feature " << features[i].second->get_id() << ".\n";
+            success = false;
+          }
+          OGRFeature::DestroyFeature(feature);
+        }
+      }, 4096);
+    //-- the index of FlatGeobuf is written when the file is closed
     GDALClose(dataSource);
+    if (success == false) {
+      CSLDestroy(options);
+      return false;
+    }
   }
+  CSLDestroy(options);
   return true;
 #endif
 }
@@ -615,7 +1689,7 @@ bool Map3d::get_gdal_output(std::string filename, std::string drivername, bool m
 // #endif
 
 #if GDAL_VERSION_MAJOR >= 2
-OGRLayer* Map3d::create_gdal_layer(GDALDriver* driver, GDALDataset* dataSource, std::string filename, std::string layername, AttributeMap attributes, bool addHeightAttributes) {
+OGRLayer* Map3d::create_gdal_layer(GDALDriver* driver, GDALDataset* dataSource, std::string filename, std::string layername, AttributeMap attributes, bool addHeightAttributes, char** options) {
   if (dataSource == NULL) {
     dataSource = driver->Create(filename.c_str(), 0, 0, 0, GDT_Unknown, NULL);
   }
@@ -628,7 +1702,7 @@ OGRLayer* Map3d::create_gdal_layer(GDALDriver* driver, GDALDataset* dataSource,
   if (layer == NULL) {
     OGRSpatialReference* sr = new OGRSpatialReference();
     sr->importFromEPSG(7415);
-    layer = dataSource->CreateLayer(layername.c_str(), sr, OGR_GT_SetZ(wkbMultiPolygon), NULL);
+    layer = dataSource->CreateLayer(layername.c_str(), sr, OGR_GT_SetZ(wkbMultiPolygon), options);
 
     OGRFieldDefn oField("3df_id", OFTString);
     if (layer->CreateField(&oField) != OGRERR_NONE) {
@@ -677,16 +1751,26 @@ const std::vector<TopoFeature*>& Map3d::get_polygons3d() {
  * search rtrees for intersecting features
  * check if points classification is allowed for feature and add point to feature
  */
-void Map3d::add_elevation_point(LASpoint const& laspt) {
+/**
+ * give the point to the features within the radius that accept its LAS class
+ * returns true if at least one feature got it
+ */
+bool Map3d::add_elevation_point(LASpoint const& laspt) {
   //-- only process last returns; 
   //-- although perhaps not smart for vegetation/forest in the future
   //-- TODO: always ignore the non-last-return points?
   if (laspt.return_number != laspt.number_of_returns)
-    return;
+    return false;
+  return add_elevation_point(laspt.get_x(), laspt.get_y(), laspt.get_z(), (int)laspt.classification);
+}
 
+/**
+ * add a last return point to the features in range of it
+ */
+bool Map3d::add_elevation_point(double px, double py, double z, int c) {
   std::vector<PairIndexed> re;
-  float x = laspt.get_x();
-  float y = laspt.get_y();
+  float x = px;
+  float y = py;
   Point2 minp(x - _radius_vertex_elevation, y - _radius_vertex_elevation);
   Point2 maxp(x + _radius_vertex_elevation, y + _radius_vertex_elevation);
   Box2 querybox(minp, maxp);
@@ -696,11 +1780,11 @@ void Map3d::add_elevation_point(LASpoint const& laspt) {
   querybox = Box2(minp, maxp);
   _rtree_buildings.query(bgi::intersects(querybox), std::back_inserter(re));
 
+  bool assigned = false;
   for (auto& v : re) {
     TopoFeature* f = v.second;
     float radius = _radius_vertex_elevation;
 
-    int c = (int)laspt.classification;
     bool bInsert = false;
     bool bWithin = false;
     if (f->get_class() == BUILDING) {
@@ -763,9 +1847,42 @@ void Map3d::add_elevation_point(LASpoint const& laspt) {
     }
     if (bInsert == true) { //-- only insert if in the allowed LAS classes
       Point2 p(x, y);
-      f->add_elevation_point(p, laspt.get_z(), radius, c, bWithin);
+      f->add_elevation_point(p, z, radius, c, bWithin);
+      assigned = true;
+      if (_profile_features)
+        _featurecosts[f].points++;
     }
   }
+  return assigned;
+}
+
+/**
+ * add a batch of points held in memory, with the filters of add_las_file()
+ * except the thinning: the LAS classes to omit, the bounds of the polygons
+ * and only the last returns; returns the number of points assigned
+ */
+unsigned long Map3d::add_points(const PointBatch& points) {
+  Metrics::PointFileCounts counts;
+  counts.filename = points.name;
+  counts.read = points.size;
+  for (std::size_t i = 0; i < points.size; i++) {
+    int c = points.classification ? points.classification[i] : 0;
+    if (std::find(points.lasomits.begin(), points.lasomits.end(), c) != points.lasomits.end()) {
+      counts.omitted++;
+      continue;
+    }
+    if (check_bounds(points.x[i], points.x[i], points.y[i], points.y[i]) == false) {
+      counts.out_of_bounds++;
+      continue;
+    }
+    if (points.return_number != nullptr && points.number_of_returns != nullptr &&
+      points.return_number[i] != points.number_of_returns[i])
+      continue;
+    if (add_elevation_point(points.x[i], points.y[i], points.z[i], c))
+      counts.assigned++;
+  }
+  _metrics.add_point_file(counts);
+  return (unsigned long)counts.assigned;
 }
 
 void Map3d::cleanup_elevations() {
@@ -783,61 +1900,130 @@ void Map3d::cleanup_elevations() {
  * 4. create vertical walls and building walls
 */
 bool Map3d::threeDfy(bool stitching) {
+  if (lift() == false)
+    return false;
+  if (stitching == true)
+    return stitch();
+  return true;
+}
 
+/**
+ * lift the polygon vertices of each TopoFeature to the height of the point cloud
+ */
+bool Map3d::lift() {
   try {
     std::clog << "===== /LIFTING =====\n";
+    Metrics::ScopedStage stage(_metrics, "lifting");
+    _progress.start("lifting", _lsFeatures.size());
     for (auto& f : _lsFeatures) {
+      auto start = boost::chrono::steady_clock::now();
       f->lift();
+      if (_profile_features)
+        _featurecosts[f].lifting += seconds_since(start);
+      _progress.add();
     }
+    _progress.finish();
+    stage.stop(_lsFeatures.size());
     std::clog << "===== LIFTING/ =====\n";
-    if (stitching == true) {
-      std::clog << "=====  /ADJACENT FEATURES =====\n";
-      for (auto& f : _lsFeatures) {
-        this->collect_adjacent_features(f);
-      }
-      std::clog << "=====  ADJACENT FEATURES/ =====\n";
+  }
+  catch (std::exception e) {
+    std::cerr << std::endl << "Lifting failed with error: " << e.what() << std::endl;
+    return false;
+  }
+  return true;
+}
 
-      std::clog << "=====  /STITCHING =====\n";
-      this->stitch_lifted_features();
-      //-- handle bridges seperately
-      this->stitch_bridges();
-      std::clog << "=====  STITCHING/ =====\n";
+/**
+ * stitch the lifted features to their adjacent features, fix the bowties and
+ * create the vertical walls and building walls
+ */
+bool Map3d::stitch() {
+  try {
+    std::clog << "=====  /ADJACENT FEATURES =====\n";
+    Metrics::ScopedStage adjacency(_metrics, "adjacency");
+    _progress.start("adjacency", _lsFeatures.size());
+    for (auto& f : _lsFeatures) {
+      auto start = boost::chrono::steady_clock::now();
+      //-- after read_state() the features have their adjacent features among all the features already
+      if (f->get_adjacent_features()->empty())
+        this->collect_adjacent_features(f);
+      if (_profile_features)
+        _featurecosts[f].stitching += seconds_since(start);
+      _progress.add();
+    }
+    _progress.finish();
+    adjacency.stop(_lsFeatures.size());
+    std::clog << "=====  ADJACENT FEATURES/ =====\n";
+
+    //-- the vertices shared with the features kept from the state keep their heights (see read_state())
+    for (auto& each : _state_heights)
+      std::get<0>(each)->set_vertex_elevation(std::get<1>(each), std::get<2>(each), std::get<3>(each));
+
+    std::clog << "=====  /STITCHING =====\n";
+    Metrics::ScopedStage stitching(_metrics, "stitching");
+    _progress.start("stitching", _lsFeatures.size());
+    this->stitch_lifted_features();
+    _progress.finish();
+    //-- handle bridges seperately
+    this->stitch_bridges();
+    stitching.stop(_lsFeatures.size());
+    std::clog << "=====  STITCHING/ =====\n";
+
+    //-- Sort all node column vectors
+    for (auto& nc : _nc) {
+      std::sort(nc.second.begin(), nc.second.end());
+      // make values in nc unique
+      nc.second.erase(unique(nc.second.begin(), nc.second.end()), nc.second.end());
+    }
+    for (auto& nc : _nc_building_walls) {
+      std::sort(nc.second.begin(), nc.second.end());
+      // make values in nc unique
+      nc.second.erase(unique(nc.second.begin(), nc.second.end()), nc.second.end());
+    }
 
-      //-- Sort all node column vectors
-      for (auto& nc : _nc) {
-        std::sort(nc.second.begin(), nc.second.end());
-        // make values in nc unique
-        nc.second.erase(unique(nc.second.begin(), nc.second.end()), nc.second.end());
+    std::clog << "=====  /BOWTIES =====\n";
+    Metrics::ScopedStage bowties(_metrics, "bowties");
+    _progress.start("bowties", _lsFeatures.size());
+    unsigned long count = 0;
+    for (auto& f : _lsFeatures) {
+      if (f->has_vertical_walls()) {
+        auto start = boost::chrono::steady_clock::now();
+        f->fix_bowtie();
+        count++;
+        if (_profile_features)
+          _featurecosts[f].stitching += seconds_since(start);
       }
-      for (auto& nc : _nc_building_walls) {
-        std::sort(nc.second.begin(), nc.second.end());
-        // make values in nc unique
-        nc.second.erase(unique(nc.second.begin(), nc.second.end()), nc.second.end());
+      _progress.add();
+    }
+    _progress.finish();
+    bowties.stop(count);
+    std::clog << "=====  BOWTIES/ =====\n";
+
+    std::clog << "=====  /VERTICAL WALLS =====\n";
+    Metrics::ScopedStage walls(_metrics, "vertical_walls");
+    _progress.start("vertical_walls", _lsFeatures.size());
+    count = 0;
+    for (auto& f : _lsFeatures) {
+      auto start = boost::chrono::steady_clock::now();
+      if (f->get_class() == BUILDING) {
+        Building* b = dynamic_cast<Building*>(f);
+        b->construct_building_walls(_nc_building_walls);
+        count++;
       }
-
-      std::clog << "=====  /BOWTIES =====\n";
-      for (auto& f : _lsFeatures) {
-        if (f->has_vertical_walls()) {
-          f->fix_bowtie();
-        }
+      else if (f->has_vertical_walls()) {
+        f->construct_vertical_walls(_nc);
+        count++;
       }
-      std::clog << "=====  BOWTIES/ =====\n";
-
-      std::clog << "=====  /VERTICAL WALLS =====\n";
-      for (auto& f : _lsFeatures) {
-        if (f->get_class() == BUILDING) {
-          Building* b = dynamic_cast<Building*>(f);
-          b->construct_building_walls(_nc_building_walls);
-        }
-        else if (f->has_vertical_walls()) {
-          f->construct_vertical_walls(_nc);
-        }
-      }
-      std::clog << "=====  VERTICAL WALLS/ =====\n";
+      if (_profile_features)
+        _featurecosts[f].walls += seconds_since(start);
+      _progress.add();
     }
+    _progress.finish();
+    walls.stop(count);
+    std::clog << "=====  VERTICAL WALLS/ =====\n";
   }
   catch (std::exception e) {
-    std::cerr << std::endl << "3dfying failed with error: " << e.what() << std::endl;
+    std::cerr << std::endl << "Stitching failed with error: " << e.what() << std::endl;
     return false;
   }
   return true;
@@ -848,15 +2034,40 @@ bool Map3d::threeDfy(bool stitching) {
  */
 bool Map3d::construct_CDT() {
   std::clog << "=====  /CDT =====\n";
+  Metrics::ScopedStage stage(_metrics, "cdt");
+  _progress.start("cdt", _lsFeatures.size());
+  std::vector<TIN*> tins;
   for (auto& p : _lsFeatures) {
+    _progress.add();
+    if (_single_tin && (p->get_class() == TERRAIN || p->get_class() == FOREST)) {
+      tins.push_back(dynamic_cast<TIN*>(p));
+      continue;
+    }
     try {
+      auto start = boost::chrono::steady_clock::now();
       p->buildCDT();
+      if (_profile_features) {
+        Metrics::FeatureCosts& costs = _featurecosts[p];
+        costs.cdt += seconds_since(start);
+        costs.iterations += get_greedy_insert_iterations();
+      }
     }
     catch (std::exception e) {
       std::cerr << std::endl << "CDT failed for object \'" << p->get_id() << "\' (class " << p->get_class() << ") with error: " << e.what() << std::endl;
       return false;
     }
   }
+  if (!tins.empty()) {
+    try {
+      TIN::buildCDT_multiple(tins);
+    }
+    catch (std::exception e) {
+      std::cerr << std::endl << "CDT failed for the single TIN of " << tins.size() << " Terrain and Forest objects with error: " << e.what() << std::endl;
+      return false;
+    }
+  }
+  _progress.finish();
+  stage.stop(_lsFeatures.size());
   std::clog << "=====  CDT/ =====\n";
   return true;
 }
@@ -867,12 +2078,368 @@ bool Map3d::save_building_variables() {
   return true;
 }
 
+/**
+ * keep only the features intersecting extent for the next 3dfying, in the
+ * order they were read, and reset them; the other features stay in memory
+ * for the next selection (eg of the next request of the server)
+ * returns the number of features selected
+ */
+unsigned long Map3d::select_features(const Box2& extent) {
+  if (_lsAllFeatures.empty()) {
+    _lsAllFeatures.swap(_lsFeatures);
+    std::vector<PairPosition> entries;
+    entries.reserve(_lsAllFeatures.size());
+    for (std::size_t i = 0; i < _lsAllFeatures.size(); i++)
+      entries.emplace_back(_lsAllFeatures[i]->get_bbox2d(), i);
+    //-- bulk loading with the packing algorithm
+    _rtree_all = bgi::rtree< PairPosition, bgi::rstar<16> >(entries.begin(), entries.end());
+  }
+  std::vector<PairPosition> re;
+  _rtree_all.query(bgi::intersects(extent), std::back_inserter(re));
+  std::sort(re.begin(), re.end(), [](const PairPosition& a, const PairPosition& b) { return a.second < b.second; });
+  _lsFeatures.clear();
+  for (auto& each : re) {
+    TopoFeature* f = _lsAllFeatures[each.second];
+    f->reset();
+    _lsFeatures.push_back(f);
+  }
+  _nc.clear();
+  _nc_building_walls.clear();
+  _bridge_stitches.clear();
+  _featurecosts.clear();
+  _rtree.clear();
+  _rtree_buildings.clear();
+  if (_lsFeatures.empty() == false)
+    construct_rtree();
+  return _lsFeatures.size();
+}
+
+//-- first bytes and version of the files of write_state()
+static const std::string STATE_MAGIC = "3dfier-state";
+static const uint32_t STATE_VERSION = 2;
+
+/**
+ * hash of the settings that change the heights, triangles and walls of the
+ * features, kept in the state: read_state() 3dfies all the features again
+ * when it differs
+ */
+unsigned long long Map3d::get_lifting_hash(bool stitching) {
+  unsigned long long hash = 14695981039346656037ull;
+  auto add = [&hash](const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+  };
+  add(&stitching, sizeof(stitching));
+  add(&_building_heightref_roof, sizeof(_building_heightref_roof));
+  add(&_building_heightref_ground, sizeof(_building_heightref_ground));
+  add(&_building_triangulate, sizeof(_building_triangulate));
+  add(&_building_lod, sizeof(_building_lod));
+  add(&_building_include_floor, sizeof(_building_include_floor));
+  add(&_building_inner_walls, sizeof(_building_inner_walls));
+  add(&_terrain_simplification, sizeof(_terrain_simplification));
+  add(&_forest_simplification, sizeof(_forest_simplification));
+  add(&_terrain_simplification_tinsimp, sizeof(_terrain_simplification_tinsimp));
+  add(&_forest_simplification_tinsimp, sizeof(_forest_simplification_tinsimp));
+  add(&_terrain_innerbuffer, sizeof(_terrain_innerbuffer));
+  add(&_forest_innerbuffer, sizeof(_forest_innerbuffer));
+  add(&_water_heightref, sizeof(_water_heightref));
+  add(&_road_heightref, sizeof(_road_heightref));
+  add(&_road_filter_outliers, sizeof(_road_filter_outliers));
+  add(&_road_flatten, sizeof(_road_flatten));
+  add(&_road_max_outlier_fraction, sizeof(_road_max_outlier_fraction));
+  add(&_separation_heightref, sizeof(_separation_heightref));
+  add(&_bridge_heightref, sizeof(_bridge_heightref));
+  add(&_bridge_flatten, sizeof(_bridge_flatten));
+  add(&_bridge_max_outlier_fraction, sizeof(_bridge_max_outlier_fraction));
+  add(&_radius_vertex_elevation, sizeof(_radius_vertex_elevation));
+  add(&_building_radius_vertex_elevation, sizeof(_building_radius_vertex_elevation));
+  add(&_threshold_jump_edges, sizeof(_threshold_jump_edges));
+  add(&_threshold_bridge_jump_edges, sizeof(_threshold_bridge_jump_edges));
+  add(&_single_tin, sizeof(_single_tin));
+  for (int c = 0; c < NUM_ALLOWEDLASTOPO; c++) {
+    for (auto sets : { &_las_classes_allowed[c], &_las_classes_allowed_within[c] }) {
+      uint64_t n = sets->size();
+      add(&n, sizeof(n));
+      for (int lasclass : *sets)
+        add(&lasclass, sizeof(lasclass));
+    }
+  }
+  return hash;
+}
+
+static void write_node_columns(std::ostream& os, const NodeColumn& nc) {
+  write_binary(os, (uint64_t)nc.size());
+  for (auto& each : nc) {
+    write_binary(os, each.first);
+    write_binary(os, each.second);
+  }
+}
+
+static bool read_node_columns(std::istream& is, NodeColumn& nc) {
+  uint64_t n;
+  if (read_binary(is, n) == false)
+    return false;
+  for (uint64_t i = 0; i < n; i++) {
+    std::string key;
+    std::vector<int> column;
+    if (read_binary(is, key) == false || read_binary(is, column) == false)
+      return false;
+    nc[key] = column;
+  }
+  return true;
+}
+
+//-- call fn(ringi, pi, key) for each vertex of the polygon of f
+static void for_each_vertex_key(TopoFeature* f, const std::function<void(int, int, const std::string&)>& fn) {
+  Polygon2* poly = f->get_Polygon2();
+  std::vector<Ring2*> rings;
+  rings.push_back(&poly->outer());
+  for (Ring2& iring : poly->inners())
+    rings.push_back(&iring);
+  for (std::size_t ringi = 0; ringi < rings.size(); ringi++) {
+    for (std::size_t i = 0; i < rings[ringi]->size(); i++)
+      fn(int(ringi), int(i), gen_key_bucket(&(*rings[ringi])[i]));
+  }
+}
+
+/**
+ * write the state of the features after 3dfying, before cleanup_elevations():
+ * the heights of their vertices, their triangles and walls, their adjacent
+ * features and the node columns; read_state() reads it in the next run
+ */
+bool Map3d::write_state(const std::string& filename, unsigned long long liftinghash) {
+  const std::vector<TopoFeature*>& features = _lsAllFeatures.empty() ? _lsFeatures : _lsAllFeatures;
+  std::ofstream out(filename, std::ios::binary);
+  if (!out) {
+    std::cerr << "ERROR: cannot write the state to " << filename << std::endl;
+    return false;
+  }
+  write_binary(out, STATE_MAGIC);
+  write_binary(out, STATE_VERSION);
+  write_binary(out, liftinghash);
+  write_node_columns(out, _nc);
+  write_node_columns(out, _nc_building_walls);
+  write_binary(out, (uint64_t)features.size());
+  std::vector<std::string> adjacent;
+  for (auto& f : features) {
+    write_binary(out, f->get_id());
+    write_binary(out, (int32_t)f->get_class());
+    write_binary(out, f->get_geometry_hash());
+    adjacent.clear();
+    for (auto& fadj : *(f->get_adjacent_features()))
+      adjacent.push_back(fadj->get_id());
+    auto kept = _state_adjacent.find(f);
+    if (adjacent.empty() && kept != _state_adjacent.end())
+      adjacent = kept->second;
+    write_binary(out, adjacent);
+    std::ostringstream os(std::ios::binary);
+    f->write_state(os);
+    write_binary(out, os.str());
+  }
+  out.close();
+  if (!out) {
+    std::cerr << "ERROR: writing the state to " << filename << " failed" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * read the state that write_state() saved in a previous run and keep the
+ * features that did not change: their heights, triangles and walls are
+ * restored and they are not 3dfied again
+ * the features in changed, those with another class or geometry and the new
+ * ones are 3dfied again with their adjacent features, in the polygons read
+ * and in the state (for the deleted features)
+ * at the vertices shared with the features kept, the node columns and the
+ * heights of the state are kept, so the stitching and the walls fit them
+ * all the features are 3dfied again when liftinghash is not the one of the
+ * state (see get_lifting_hash())
+ */
+bool Map3d::read_state(const std::string& filename, const std::set<std::string>& changed, unsigned long long liftinghash) {
+  if (_lsAllFeatures.empty() == false) {
+    std::cerr << "ERROR: the state must be read before the features are selected" << std::endl;
+    return false;
+  }
+  struct FeatureState {
+    int32_t                   topoclass;
+    unsigned long long        hash;
+    std::vector<std::string>  adjacent;
+    std::string               data;
+  };
+  std::unordered_map<std::string, FeatureState> states;
+  std::set<std::string> duplicates;
+  NodeColumn nc, nc_building_walls;
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) {
+    std::cerr << "ERROR: cannot open the state " << filename << std::endl;
+    return false;
+  }
+  std::string magic;
+  uint32_t version;
+  if (read_binary(in, magic) == false || magic != STATE_MAGIC || read_binary(in, version) == false || version != STATE_VERSION) {
+    std::cerr << "ERROR: " << filename << " is not a state of this version of 3dfier" << std::endl;
+    return false;
+  }
+  unsigned long long statehash = 0;
+  uint64_t n = 0;
+  bool valid = read_binary(in, statehash) && read_node_columns(in, nc) && read_node_columns(in, nc_building_walls) && read_binary(in, n);
+  for (uint64_t i = 0; valid && i < n; i++) {
+    std::string id;
+    FeatureState state;
+    valid = read_binary(in, id) && read_binary(in, state.topoclass) && read_binary(in, state.hash) &&
+      read_binary(in, state.adjacent) && read_binary(in, state.data);
+    if (valid && states.emplace(id, std::move(state)).second == false)
+      duplicates.insert(id);
+  }
+  if (valid == false) {
+    std::cerr << "ERROR: the state " << filename << " is corrupt" << std::endl;
+    return false;
+  }
+
+  bool optionschanged = (statehash != liftinghash);
+  if (optionschanged)
+    std::clog << "The lifting options changed since the previous run, all the features are 3dfied again\n";
+
+  //-- 1 to 3dfy again, 2 to 3dfy again as a neighbour, 0 to keep
+  std::vector<char> todo(_lsFeatures.size(), 0);
+  std::unordered_map<std::string, std::size_t> positions;
+  std::unordered_map<TopoFeature*, std::size_t> fpositions;
+  for (std::size_t i = 0; i < _lsFeatures.size(); i++) {
+    if (positions.emplace(_lsFeatures[i]->get_id(), i).second == false)
+      duplicates.insert(_lsFeatures[i]->get_id());
+    fpositions[_lsFeatures[i]] = i;
+  }
+  unsigned long nchanged = 0, nnew = 0;
+  _num_deleted_features = 0;
+  for (std::size_t i = 0; i < _lsFeatures.size(); i++) {
+    TopoFeature* f = _lsFeatures[i];
+    auto it = states.find(f->get_id());
+    if (it == states.end()) {
+      todo[i] = 1;
+      nnew++;
+    }
+    else if (optionschanged || changed.count(f->get_id()) > 0 || duplicates.count(f->get_id()) > 0 ||
+      it->second.topoclass != f->get_class() || it->second.hash != f->get_geometry_hash()) {
+      todo[i] = 1;
+      nchanged++;
+    }
+    else {
+      std::istringstream is(it->second.data, std::ios::binary);
+      if (f->read_state(is) == false) {
+        f->reset();
+        todo[i] = 1;
+        nchanged++;
+      }
+    }
+  }
+
+  //-- the neighbours in the state of the deleted and changed features, then in the polygons read
+  for (auto& each : states) {
+    auto pos = positions.find(each.first);
+    if (pos == positions.end())
+      _num_deleted_features++;
+    else if (todo[pos->second] != 1)
+      continue;
+    for (auto& id : each.second.adjacent) {
+      auto adj = positions.find(id);
+      if (adj != positions.end() && todo[adj->second] == 0)
+        todo[adj->second] = 2;
+    }
+  }
+  for (std::size_t i = 0; i < _lsFeatures.size(); i++) {
+    if (todo[i] != 1)
+      continue;
+    collect_adjacent_features(_lsFeatures[i]);
+    for (auto& fadj : *(_lsFeatures[i]->get_adjacent_features())) {
+      std::size_t j = fpositions[fadj];
+      if (todo[j] == 0)
+        todo[j] = 2;
+    }
+  }
+
+  //-- the vertices shared by the features 3dfied again and the features kept
+  std::set<std::string> keys, keptkeys;
+  for (std::size_t i = 0; i < _lsFeatures.size(); i++) {
+    if (todo[i] != 0)
+      for_each_vertex_key(_lsFeatures[i], [&keys](int, int, const std::string& key) { keys.insert(key); });
+  }
+  for (std::size_t i = 0; i < _lsFeatures.size(); i++) {
+    if (todo[i] == 0)
+      for_each_vertex_key(_lsFeatures[i], [&keys, &keptkeys](int, int, const std::string& key) {
+        if (keys.count(key) > 0)
+          keptkeys.insert(key);
+      });
+  }
+  _nc.clear();
+  _nc_building_walls.clear();
+  _state_heights.clear();
+  for (auto& each : nc) {
+    if (keys.count(each.first) == 0 || keptkeys.count(each.first) > 0)
+      _nc.insert(each);
+  }
+  for (auto& each : nc_building_walls) {
+    if (keys.count(each.first) == 0 || keptkeys.count(each.first) > 0)
+      _nc_building_walls.insert(each);
+  }
+  for (std::size_t i = 0; i < _lsFeatures.size(); i++) {
+    if (todo[i] != 2)
+      continue;
+    TopoFeature* f = _lsFeatures[i];
+    for_each_vertex_key(f, [this, f, &keptkeys](int ringi, int pi, const std::string& key) {
+      if (keptkeys.count(key) > 0)
+        _state_heights.push_back(std::make_tuple(f, ringi, pi, f->get_vertex_elevation(ringi, pi)));
+    });
+    f->reset();
+    collect_adjacent_features(f);
+  }
+
+  //-- only the features to 3dfy again are lifted and get points
+  _lsAllFeatures.swap(_lsFeatures);
+  for (std::size_t i = 0; i < _lsAllFeatures.size(); i++) {
+    TopoFeature* f = _lsAllFeatures[i];
+    if (todo[i] != 0)
+      _lsFeatures.push_back(f);
+    else
+      _state_adjacent[f] = std::move(states[f->get_id()].adjacent);
+  }
+  _rtree.clear();
+  _rtree_buildings.clear();
+  if (_lsFeatures.empty() == false)
+    construct_rtree();
+  std::clog << "Features changed: " << boost::locale::as::number << nchanged << ", new: " << nnew << ", deleted: " << _num_deleted_features << "\n";
+  std::clog << "Features 3dfied again with their neighbours: " << boost::locale::as::number << _lsFeatures.size() << " of " << _lsAllFeatures.size() << "\n";
+  return true;
+}
+
+//-- the features in the state of read_state() that are not in the polygons read
+unsigned long Map3d::get_num_deleted_features() {
+  return _num_deleted_features;
+}
+
+/**
+ * all the features again after read_state(), to write the features kept
+ * from the state with those 3dfied again
+ */
+void Map3d::select_all_features() {
+  if (_lsAllFeatures.empty())
+    return;
+  _lsFeatures = _lsAllFeatures;
+  _rtree.clear();
+  _rtree_buildings.clear();
+  construct_rtree();
+}
+
 /**
  * create rtrees, one for building and one for other objects
  * calculate a single bounding box from both trees
  */
 bool Map3d::construct_rtree() {
   std::clog << "Constructing the R-tree...";
+  Metrics::ScopedStage stage(_metrics, "rtree");
   for (auto p : _lsFeatures) {
     if (p->get_class() == BUILDING) {
       _rtree_buildings.insert(std::make_pair(p->get_bbox2d(), p));
@@ -881,6 +2448,7 @@ bool Map3d::construct_rtree() {
       _rtree.insert(std::make_pair(p->get_bbox2d(), p));
     }
   }
+  stage.stop(_lsFeatures.size());
   std::clog << " done.\n";
 
   //-- update the bounding box from _rtree and _rtree_buildings 
@@ -891,10 +2459,10 @@ bool Map3d::construct_rtree() {
       std::max(bg::get<bg::max_corner, 1>(_rtree.bounds()), bg::get<bg::max_corner, 1>(_rtree_buildings.bounds()))));
   
   double radius = std::max(_radius_vertex_elevation, _building_radius_vertex_elevation);
-  _minxradius = std::min(bg::get<bg::min_corner, 0>(_rtree.bounds()), bg::get<bg::min_corner, 0>(_rtree_buildings.bounds())) - radius;
-  _maxxradius = std::min(bg::get<bg::min_corner, 1>(_rtree.bounds()), bg::get<bg::min_corner, 1>(_rtree_buildings.bounds())) + radius;
-  _minyradius = std::max(bg::get<bg::max_corner, 0>(_rtree.bounds()), bg::get<bg::max_corner, 0>(_rtree_buildings.bounds())) - radius;
-  _maxyradius = std::max(bg::get<bg::max_corner, 1>(_rtree.bounds()), bg::get<bg::max_corner, 1>(_rtree_buildings.bounds())) + radius;
+  _minxradius = bg::get<bg::min_corner, 0>(_bbox) - radius;
+  _maxxradius = bg::get<bg::max_corner, 0>(_bbox) + radius;
+  _minyradius = bg::get<bg::min_corner, 1>(_bbox) - radius;
+  _maxyradius = bg::get<bg::max_corner, 1>(_bbox) + radius;
   return true;
 }
 
@@ -982,12 +2550,19 @@ bool Map3d::extract_and_add_polygon(GDALDataset* dataSource, PolygonFile* file)
     else if (dataLayer->FindFieldIndex(heightfield, false) == -1) {
       std::clog << "Warning: field '" << heightfield << "' not found in layer '" << l.first << "', using all polygons.\n";
     }
+    if (_srs.empty() && dataLayer->GetSpatialRef() != NULL) {
+      char* wkt = NULL;
+      if (dataLayer->GetSpatialRef()->exportToWkt(&wkt) == OGRERR_NONE)
+        _srs = wkt;
+      CPLFree(wkt);
+    }
     dataLayer->ResetReading();
     unsigned int numberOfPolygons = dataLayer->GetFeatureCount(true);
     std::string layerName = dataLayer->GetName();
     std::clog << "\tLayer: " << layerName << std::endl;
     std::clog << "\t(" << boost::locale::as::number << numberOfPolygons << " features --> " << l.second << ")\n";
     OGRFeature *f;
+    _progress.start("read_polygons " + layerName, numberOfPolygons);
 
     //-- check if extent is given and polygons need filtering
     bool useRequestedExtent = false;
@@ -1076,7 +2651,9 @@ bool Map3d::extract_and_add_polygon(GDALDataset* dataSource, PolygonFile* file)
         }
       }
       OGRFeature::DestroyFeature(f);
+      _progress.add();
     }
+    _progress.finish();
     if (numSplitMulti > 0) {
       std::clog << "\tSplit " << numSplitMulti << " MultiPolygon(s) into " << numSplitPoly << " Polygon(s)\n";
     }
@@ -1163,6 +2740,9 @@ bool Map3d::add_las_file(PointFile pointFile) {
   lasreadopener.set_file_name(pointFile.filename.c_str());
   //-- set to compute bounding box
   lasreadopener.set_populate_header(true);
+  //-- only the points that can lift the polygons (eg of the extent of a request of
+  //-- the server) are read, with a .lax index next to the file only its cells there
+  lasreadopener.set_inside_rectangle(_minxradius, _minyradius, _maxxradius, _maxyradius);
   LASreader* lasreader = lasreadopener.open();
 
   try {
@@ -1172,6 +2752,8 @@ bool Map3d::add_las_file(PointFile pointFile) {
       return false;
     }
     LASheader header = lasreader->header;
+    Metrics::PointFileCounts counts;
+    counts.filename = pointFile.filename;
 
     if (check_bounds(header.min_x, header.max_x, header.min_y, header.max_y)) {
       //-- LAS classes to omit
@@ -1197,7 +2779,12 @@ bool Map3d::add_las_file(PointFile pointFile) {
           std::clog << i << " ";
         std::clog << ")\n";
       }
-      printProgressBar(0);
+      _progress.start("read_points " + pointFile.filename, pointCount);
+      auto startRead = boost::chrono::high_resolution_clock::now();
+      Metrics::ScopedStage stage(_metrics, "read_points " + pointFile.filename);
+      //-- the assignment is only timed when the metrics are written, it is done point by point
+      bool timeassignment = _metrics.is_enabled();
+      double assignseconds = 0;
       int i = 0;
       while (lasreader->read_point()) {
         LASpoint const& p = lasreader->point;
@@ -1206,21 +2793,45 @@ bool Map3d::add_las_file(PointFile pointFile) {
           //-- set the classification filter
           if (std::find(lasomits.begin(), lasomits.end(), (int)p.classification) == lasomits.end()) {
             //-- set the bounds filter
-            if (check_bounds(p.X, p.X, p.Y, p.Y)) {
-              this->add_elevation_point(p);
+            if (check_bounds(p.get_x(), p.get_x(), p.get_y(), p.get_y())) {
+              bool assigned;
+              if (timeassignment) {
+                auto startAssign = boost::chrono::steady_clock::now();
+                assigned = this->add_elevation_point(p);
+                assignseconds += boost::chrono::duration<double>(boost::chrono::steady_clock::now() - startAssign).count();
+              }
+              else {
+                assigned = this->add_elevation_point(p);
+              }
+              if (assigned)
+                counts.assigned++;
             }
+            else
+              counts.out_of_bounds++;
           }
+          else
+            counts.omitted++;
         }
-        if (i % (pointCount / 100) == 0)
-          printProgressBar(100 * (i / double(pointCount)));
+        else
+          counts.thinned++;
+        _progress.add();
         i++;
       }
-      printProgressBar(100);
-      std::clog << std::endl;
+      _progress.finish();
+      counts.read = i;
+      //-- the assignment runs in the reading thread, its CPU time is its wall time
+      if (timeassignment)
+        _metrics.add("assign_points " + pointFile.filename, assignseconds, assignseconds, counts.assigned);
+      stage.stop(i);
+      double seconds = boost::chrono::duration<double>(boost::chrono::high_resolution_clock::now() - startRead).count();
+      std::clog << "\t(" << boost::locale::as::number << (unsigned long long)(seconds > 0 ? i / seconds : 0)
+        << " points/second, " << get_kernels_name() << " geometry kernels)\n";
     }
     else {
       std::clog << "\tskipping file, bounds do not intersect polygon extent\n";
+      counts.skipped = true;
     }
+    _metrics.add_point_file(counts);
     lasreader->close();
   }
   catch (std::exception e) {
@@ -1256,6 +2867,8 @@ void Map3d::collect_adjacent_features(TopoFeature* f) {
 void Map3d::stitch_lifted_features() {
   std::vector<int> ringis, pis;
   for (auto& f : _lsFeatures) {
+    _progress.add();
+    auto start = boost::chrono::steady_clock::now();
     if (f->get_class() != BRIDGE) {
       //-- gather all rings
       std::vector<Ring2> therings;
@@ -1297,6 +2910,8 @@ void Map3d::stitch_lifted_features() {
         }
       }
     }
+    if (_profile_features)
+      _featurecosts[f].stitching += seconds_since(start);
   }
 }
 
@@ -40,9 +40,15 @@
 #include "Road.h"
 #include "Separation.h"
 #include "Bridge.h"
+#include "Metrics.h"
+#include "Progress.h"
 #include "boost/locale.hpp"
+#include <map>
+#include <set>
+#include <tuple>
 
 typedef std::pair<Box2, TopoFeature*> PairIndexed;
+typedef std::pair<Box2, std::size_t> PairPosition; //-- bbox and position of a feature in a list
 
 class Map3d {
 public:
@@ -54,31 +60,52 @@ public:
 
   void stitch_lifted_features();
   bool construct_rtree();
+  unsigned long select_features(const Box2& extent);
+  unsigned long long get_lifting_hash(bool stitching);
+  bool read_state(const std::string& filename, const std::set<std::string>& changed, unsigned long long liftinghash);
+  bool write_state(const std::string& filename, unsigned long long liftinghash);
+  void select_all_features();
+  unsigned long get_num_deleted_features();
   bool threeDfy(bool stitching = true);
+  bool lift();
+  bool stitch();
   bool construct_CDT();
-  void add_elevation_point(LASpoint const& laspt);
+  bool add_elevation_point(LASpoint const& laspt);
+  bool add_elevation_point(double x, double y, double z, int lasclass);
+  unsigned long add_points(const PointBatch& points);
   void cleanup_elevations();
 
   unsigned long get_num_polygons();
   const std::vector<TopoFeature*>&  get_polygons3d();
   Box2 get_bbox();
   bool check_bounds(const double xmin, const double xmax, const double ymin, const double ymax);
-
-  void get_citygml(std::wostream& of);
+  Metrics& get_metrics();
+  Progress& get_progress();
+  Metrics::MemoryUsage get_memory_usage();
+  bool check_memory(const std::string& stage);
+
+  static bool is_single_pass_format(const std::string& format);
+  void get_outputs(const std::map<std::string, TextWriter*>& outputs);
+  void get_citygml(TextWriter& of);
   void get_citygml_multifile(std::string);
-  void create_citygml_header(std::wostream& of);
-  void get_citygml_imgeo(std::wostream& of);
-  bool get_cityjson(std::wostream& of);
+  void create_citygml_header(TextWriter& of);
+  void get_citygml_imgeo(TextWriter& of);
+  bool get_cityjson(TextWriter& of);
   void get_citygml_imgeo_multifile(std::string ofname);
-  void create_citygml_imgeo_header(std::wostream& of);
+  void create_citygml_imgeo_header(TextWriter& of);
   bool get_postgis_output(std::string filename, bool pdok = false, bool citygml = false);
+  bool get_postgis_copy(TextWriter& of, bool pdok = false, bool citygml = false);
   bool get_gdal_output(std::string filename, std::string drivername, bool multi);
-  void get_csv_buildings(std::wostream& of);
-  void get_csv_buildings_multiple_heights(std::wostream& of);
-  void get_csv_buildings_all_elevation_points(std::wostream& of);
-  void get_obj_per_feature(std::wostream& of);
-  void get_obj_per_class(std::wostream& of);
-  void get_stl(std::wostream& of);
+  bool get_gdal_output_hilbert(std::string filename, std::string drivername, std::string extension);
+  void get_csv_buildings(TextWriter& of);
+  void get_csv_buildings_multiple_heights(TextWriter& of);
+  void get_csv_buildings_all_elevation_points(TextWriter& of);
+  void get_obj_per_feature(TextWriter& of);
+  void get_obj_per_class(TextWriter& of);
+  void get_stl(TextWriter& of);
+  void get_stl_binary(TextWriter& of);
+  bool get_gltf(TextWriter& of, std::string ofname, bool binary);
+  bool get_3dtiles(std::string ofname);
 
   void set_building_heightref_roof(float heightref);
   void set_building_heightref_ground(float heightref);
@@ -107,6 +134,11 @@ public:
   void set_threshold_bridge_jump_edges(float threshold);
   void set_requested_extent(double xmin, double ymin, double xmax, double ymax);
   void set_max_angle_curvepolygon(double max_angle);
+  void set_single_tin(bool single_tin);
+  void set_srs(std::string srs);
+  void set_profile_features(bool profile);
+  void set_max_memory(unsigned long long bytes);
+  bool get_feature_profile(std::string filename, int top);
 
   void add_allowed_las_class(AllowedLASTopo c, int i);
   void add_allowed_las_class_within(AllowedLASTopo c, int i);
@@ -146,6 +178,11 @@ private:
   double      _maxyradius;
   Box2        _requestedExtent;
   double      _max_angle_curvepolygon; //-- the largest step in degrees along the arc, zero to use the default setting.
+  bool        _single_tin; //-- one CDT for all Terrain and Forest features instead of one per polygon
+  std::string _srs; //-- of the input polygons, from the config or else from the first layer that has one
+  bool        _profile_features; //-- collect the costs of each feature in _featurecosts
+  unsigned long long _max_memory; //-- resident bytes before the writers flush early, 0 for no limit
+  unsigned long _num_deleted_features; //-- found by read_state()
 
   //-- storing the LAS allowed for each TopoFeature
   std::array<std::set<int>,NUM_ALLOWEDLASTOPO> _las_classes_allowed;
@@ -155,6 +192,13 @@ private:
   NodeColumn                                          _nc_building_walls;
   std::unordered_map<std::string, int>                _bridge_stitches;
   std::vector<TopoFeature*>                           _lsFeatures;
+  std::vector<TopoFeature*>                           _lsAllFeatures; //-- all features once select_features() is used
+  bgi::rtree< PairPosition, bgi::rstar<16> >          _rtree_all; //-- positions in _lsAllFeatures
+  std::vector< std::tuple<TopoFeature*, int, int, int> > _state_heights; //-- heights from the state at the vertices shared with the features kept
+  std::unordered_map<TopoFeature*, std::vector<std::string> > _state_adjacent; //-- ids of the adjacent features of the features kept from the state
+  Metrics                                             _metrics;
+  Progress                                            _progress;
+  std::unordered_map<TopoFeature*, Metrics::FeatureCosts> _featurecosts;
   bgi::rtree< PairIndexed, bgi::rstar<16> >           _rtree;
   bgi::rtree< PairIndexed, bgi::rstar<16> >           _rtree_buildings;
 
@@ -162,7 +206,7 @@ private:
   bool extract_and_add_polygon(OGRDataSource* dataSource, PolygonFile* file);
 #else
   bool extract_and_add_polygon(GDALDataset* dataSource, PolygonFile* file);
-  OGRLayer* create_gdal_layer(GDALDriver* driver, GDALDataset* dataSource, std::string filename, std::string layername, AttributeMap attributes, bool addHeightAttributes);
+  OGRLayer* create_gdal_layer(GDALDriver* driver, GDALDataset* dataSource, std::string filename, std::string layername, AttributeMap attributes, bool addHeightAttributes, char** options = NULL);
 #endif
   void extract_feature(OGRFeature * f, std::string layerName, const char * idfield, const char * heightfield, std::string layertype, bool multiple_heights);
   void stitch_one_vertex(TopoFeature* f, int ringi, int pi, std::vector< std::tuple<TopoFeature*, int, int> >& star);
@@ -170,6 +214,18 @@ private:
   void stitch_average(TopoFeature* f1, int ringi1, int pi1, TopoFeature* f2, int ringi2, int pi2);
   void stitch_bridges();
   void collect_adjacent_features(TopoFeature* f);
+  void get_citygml_features(TextWriter& of, bool imgeo);
+  void get_citygml_features_multifile(std::string ofname, bool imgeo);
+  void get_obj(TextWriter& of, const std::vector<TopoFeature*>& features, bool objects);
+  void get_csv_multiple_heights_header(TextWriter& of);
+  void get_csv_multiple_heights(Building* b, TextWriter& of);
+  void get_obj_vertices(TextWriter& of, const std::vector<TopoFeature*>& features, std::vector<std::string>& faces, std::vector< std::vector<unsigned long> >& ids);
+  void renumber_obj_faces(const std::string& fs, const std::vector<unsigned long>& ids, std::string& out);
+  void get_obj_feature(TopoFeature* p, std::unordered_map< std::string, unsigned long >& dPts, std::string& fs);
+  void write_stl_solids(TextWriter& of, const std::string* fs);
+  unsigned long get_stl_binary_feature(TopoFeature* p, const Point2& offset, std::string* fs);
+  void get_mesh_feature(TopoFeature* p, const Point3& centre, float featureid, Mesh& mesh);
+  bool get_gltf_features(TextWriter& of, const std::vector<TopoFeature*>& features, const Point3& centre, std::string binpath = "", double* zrange = NULL);
 };
 
 #endif
@@ -0,0 +1,273 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "Metrics.h"
+#include "nlohmann-json/json.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+Metrics::Metrics() {
+  _enabled = false;
+  _depth = 0;
+  _start = boost::chrono::steady_clock::now();
+}
+
+bool Metrics::is_enabled() const {
+  return _enabled;
+}
+
+/**
+ * the finer measurements (eg the assignment of each point) are only done when enabled
+ */
+void Metrics::set_enabled(bool enabled) {
+  _enabled = enabled;
+}
+
+/**
+ * fn gives the bytes per subsystem, they are added to each stage when it stops
+ */
+void Metrics::set_memory_usage(const std::function<MemoryUsage()>& fn) {
+  _memoryusage = fn;
+}
+
+/**
+ * start measuring a stage, returns the stage to pass to stop()
+ */
+std::size_t Metrics::start(const std::string& name) {
+  Stage s;
+  s.name = name;
+  s.depth = _depth++;
+  s.running = true;
+  s.start = boost::chrono::steady_clock::now();
+  s.cpustart = cpu_seconds();
+  s.wallseconds = 0;
+  s.cpuseconds = 0;
+  s.items = 0;
+  s.bytes = 0;
+  s.peakrss = 0;
+  _stages.push_back(s);
+  return _stages.size() - 1;
+}
+
+void Metrics::stop(std::size_t stage, unsigned long long items, unsigned long long bytes) {
+  Stage& s = _stages[stage];
+  if (s.running == false)
+    return;
+  s.running = false;
+  s.wallseconds = boost::chrono::duration<double>(boost::chrono::steady_clock::now() - s.start).count();
+  s.cpuseconds = cpu_seconds() - s.cpustart;
+  s.items = items;
+  s.bytes = bytes;
+  s.peakrss = peak_rss();
+  if (_enabled && _memoryusage)
+    s.memory = _memoryusage();
+  _depth--;
+}
+
+Metrics::ScopedStage::ScopedStage(Metrics& metrics, const std::string& name)
+  : _metrics(metrics), _stage(metrics.start(name)) {
+}
+
+Metrics::ScopedStage::~ScopedStage() {
+  _metrics.stop(_stage);
+}
+
+void Metrics::ScopedStage::stop(unsigned long long items, unsigned long long bytes) {
+  _metrics.stop(_stage, items, bytes);
+}
+
+/**
+ * a stage measured elsewhere, eg summed over the points of a file
+ */
+void Metrics::add(const std::string& name, double wallseconds, double cpuseconds, unsigned long long items) {
+  Stage s;
+  s.name = name;
+  s.depth = _depth;
+  s.running = false;
+  s.cpustart = 0;
+  s.wallseconds = wallseconds;
+  s.cpuseconds = cpuseconds;
+  s.items = items;
+  s.bytes = 0;
+  s.peakrss = peak_rss();
+  _stages.push_back(s);
+}
+
+//-- counts with the same filename are added up
+void Metrics::add_point_file(const PointFileCounts& counts) {
+  for (auto& p : _pointfiles) {
+    if (p.filename == counts.filename) {
+      p.read += counts.read;
+      p.thinned += counts.thinned;
+      p.omitted += counts.omitted;
+      p.out_of_bounds += counts.out_of_bounds;
+      p.assigned += counts.assigned;
+      return;
+    }
+  }
+  _pointfiles.push_back(counts);
+}
+
+unsigned long long Metrics::get_points_read() const {
+  unsigned long long total = 0;
+  for (auto& p : _pointfiles)
+    total += p.read;
+  return total;
+}
+
+/**
+ * wall time of the last stage with this name, 0 if there is none
+ */
+double Metrics::get_wall_seconds(const std::string& name) const {
+  for (auto it = _stages.rbegin(); it != _stages.rend(); ++it) {
+    if (it->name == name)
+      return it->wallseconds;
+  }
+  return 0;
+}
+
+bool Metrics::write(const std::string& filename) const {
+  nlohmann::json j;
+  j["threads"] = std::max(1u, std::thread::hardware_concurrency());
+  j["wall_seconds"] = boost::chrono::duration<double>(boost::chrono::steady_clock::now() - _start).count();
+  j["cpu_seconds"] = cpu_seconds();
+  j["peak_rss_bytes"] = peak_rss();
+  j["stages"] = nlohmann::json::array();
+  for (auto& s : _stages) {
+    nlohmann::json js;
+    js["name"] = s.name;
+    js["depth"] = s.depth;
+    js["wall_seconds"] = s.wallseconds;
+    js["cpu_seconds"] = s.cpuseconds;
+    js["items"] = s.items;
+    js["items_per_second"] = s.wallseconds > 0 ? s.items / s.wallseconds : 0.0;
+    if (s.bytes > 0) {
+      js["bytes"] = s.bytes;
+      js["bytes_per_second"] = s.wallseconds > 0 ? s.bytes / s.wallseconds : 0.0;
+    }
+    js["peak_rss_bytes"] = s.peakrss;
+    if (s.memory.empty() == false)
+      js["memory_bytes"] = s.memory;
+    j["stages"].push_back(js);
+  }
+  j["point_files"] = nlohmann::json::array();
+  for (auto& p : _pointfiles) {
+    nlohmann::json jp;
+    jp["filename"] = p.filename;
+    jp["skipped"] = p.skipped;
+    jp["read"] = p.read;
+    jp["thinned"] = p.thinned;
+    jp["omitted"] = p.omitted;
+    jp["out_of_bounds"] = p.out_of_bounds;
+    jp["assigned"] = p.assigned;
+    j["point_files"].push_back(jp);
+  }
+  std::ofstream of(filename);
+  if (!of.is_open()) {
+    std::cerr << "ERROR: cannot write metrics file " << filename << std::endl;
+    return false;
+  }
+  of << j.dump(2) << std::endl;
+  return true;
+}
+
+/**
+ * user and system CPU time of the process, all threads together
+ */
+double Metrics::cpu_seconds() {
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user) == 0)
+    return 0;
+  ULARGE_INTEGER k, u;
+  k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+  u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+  return (k.QuadPart + u.QuadPart) / 1e7;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+    usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+/**
+ * high-water mark of the resident memory of the process in bytes
+ */
+unsigned long long Metrics::peak_rss() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == 0)
+    return 0;
+  return counters.PeakWorkingSetSize;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  //-- kilobytes on Linux
+  return (unsigned long long)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+/**
+ * resident memory of the process now in bytes, the peak where it is not known
+ */
+unsigned long long Metrics::current_rss() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == 0)
+    return 0;
+  return counters.WorkingSetSize;
+#elif defined(__linux__)
+  unsigned long long size, resident;
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (f == NULL)
+    return peak_rss();
+  int n = fscanf(f, "%llu %llu", &size, &resident);
+  fclose(f);
+  if (n != 2)
+    return peak_rss();
+  return resident * sysconf(_SC_PAGESIZE);
+#else
+  return peak_rss();
+#endif
+}
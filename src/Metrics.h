@@ -0,0 +1,133 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "boost/chrono.hpp"
+
+/**
+ * machine readable report of a run, written with --metrics
+ * a stage is measured between start() and stop(): wall and CPU time, the number
+ * of items processed and the peak resident memory of the process at its end
+ * stages can be nested (eg the lifting inside 3dfying)
+ */
+class Metrics {
+public:
+  /**
+   * the points of a LAS/LAZ file, see Map3d::add_las_file(), or of the
+   * batches of points with the same name, see Map3d::add_points()
+   */
+  struct PointFileCounts {
+    std::string         filename;
+    bool                skipped = false;
+    unsigned long long  read = 0;
+    unsigned long long  thinned = 0;
+    unsigned long long  omitted = 0;
+    unsigned long long  out_of_bounds = 0;
+    unsigned long long  assigned = 0;
+  };
+
+  /**
+   * the cost of a feature, see Map3d::set_profile_features()
+   */
+  struct FeatureCosts {
+    double              lifting = 0;
+    double              stitching = 0;
+    double              walls = 0;
+    double              cdt = 0;
+    unsigned long       points = 0;
+    unsigned long       iterations = 0;
+  };
+
+  /**
+   * bytes held per subsystem, see Map3d::get_memory_usage()
+   */
+  typedef std::map<std::string, unsigned long long> MemoryUsage;
+
+  /**
+   * a stage started on construction and stopped by stop() or else when it goes
+   * out of scope, so an early return or an exception does not leave it open
+   */
+  class ScopedStage {
+  public:
+    ScopedStage(Metrics& metrics, const std::string& name);
+    ~ScopedStage();
+    void  stop(unsigned long long items = 0, unsigned long long bytes = 0);
+  private:
+    ScopedStage(const ScopedStage&);
+    ScopedStage& operator=(const ScopedStage&);
+    Metrics&     _metrics;
+    std::size_t  _stage;
+  };
+
+  Metrics();
+
+  std::size_t start(const std::string& name);
+  void        stop(std::size_t stage, unsigned long long items = 0, unsigned long long bytes = 0);
+  void        add(const std::string& name, double wallseconds, double cpuseconds, unsigned long long items);
+  void        add_point_file(const PointFileCounts& counts);
+  unsigned long long  get_points_read() const;
+  double      get_wall_seconds(const std::string& name) const;
+  bool        write(const std::string& filename) const;
+  bool        is_enabled() const;
+  void        set_enabled(bool enabled);
+  void        set_memory_usage(const std::function<MemoryUsage()>& fn);
+
+  static double              cpu_seconds();
+  static unsigned long long  peak_rss();
+  static unsigned long long  current_rss();
+
+private:
+  struct Stage {
+    std::string         name;
+    int                 depth;
+    bool                running;
+    boost::chrono::time_point<boost::chrono::steady_clock> start;
+    double              cpustart;
+    double              wallseconds;
+    double              cpuseconds;
+    unsigned long long  items;
+    unsigned long long  bytes;
+    unsigned long long  peakrss;
+    MemoryUsage         memory;
+  };
+
+  bool                          _enabled;
+  int                           _depth;
+  boost::chrono::time_point<boost::chrono::steady_clock> _start;
+  std::vector<Stage>            _stages;
+  std::vector<PointFileCounts>  _pointfiles;
+  std::function<MemoryUsage()>  _memoryusage;
+};
+
+#endif
@@ -0,0 +1,1570 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "Pipeline.h"
+#include "Server.h"
+#include "io.h"
+#include "boost/locale.hpp"
+#include "boost/chrono.hpp"
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <set>
+
+//-- the classes a polygon can be lifted as
+static const std::set<std::string> ALLOWEDFEATURES{ "Building", "Water", "Terrain", "Road", "Forest", "Separation", "Bridge/Overpass" };
+
+//-- the formats written to a single TextWriter, they can be written to a callback
+static const std::vector<std::string> STREAMFORMATS{ "OBJ", "OBJ-NoID", "STL", "STL-binary", "GLB", "CityGML", "CityGML-IMGeo", "CityJSON", "CSV-BUILDINGS", "CSV-BUILDINGS-MULTIPLE", "CSV-BUILDINGS-ALL-Z", "PostGIS-COPY", "PostGIS-PDOK-COPY", "PostGIS-PDOK-CityGML-COPY" };
+
+//-- all the formats, in the order of the options of the command line
+static const std::vector<std::string> FORMATS{ "OBJ", "OBJ-NoID", "STL", "STL-binary", "glTF", "GLB", "3DTiles", "CityGML", "CityGML-Multifile", "CityGML-IMGeo", "CityGML-IMGeo-Multifile", "CityJSON", "CSV-BUILDINGS", "CSV-BUILDINGS-MULTIPLE", "CSV-BUILDINGS-ALL-Z", "Shapefile", "Shapefile-Multifile", "FlatGeobuf", "GeoParquet", "PostGIS", "PostGIS-PDOK", "PostGIS-PDOK-CityGML", "PostGIS-COPY", "PostGIS-PDOK-COPY", "PostGIS-PDOK-CityGML-COPY", "GDAL" };
+
+//-- the formats that only need the lifted heights, with the message when they are the only output
+static const std::map<std::string, std::string> NORECONSTRUCTION{
+  { "CSV-BUILDINGS", "CSV-BUILDINGS: no 3D reconstruction" },
+  { "CSV-BUILDINGS-MULTIPLE", "CSV-BUILDINGS-MULTIPLE: no 3D reconstruction" },
+  { "CSV-BUILDINGS-ALL-Z", "CSV-BUILDINGS-ALL-Z: no 3D reconstruction" } };
+
+static bool validate_config(const YAML::Node& nodes);
+static unsigned long long parse_bytes(const std::string& size);
+static bool read_ids(const std::string& filename, std::set<std::string>& ids);
+static void print_written(unsigned long long bytes, unsigned long long uncompressed, double seconds);
+
+Pipeline::Pipeline() {}
+
+/**
+ * the numbers in std::clog and std::cout get the separators of en_US.UTF-8,
+ * std::cerr is left as it is
+ */
+void Pipeline::set_locale() {
+  boost::locale::generator gen;
+  std::locale loc = gen("en_US.UTF-8");
+  std::locale::global(loc);
+  std::clog.imbue(loc);
+  std::cout.imbue(loc);
+}
+
+/**
+ * check the options of the command line before anything is read, nicer for
+ * the user: the config file, the folders of the files to write and the
+ * options that go together
+ */
+bool Pipeline::validate(const RunOptions& options) {
+  boost::filesystem::path yp(options.yaml);
+  if (boost::filesystem::exists(yp) == false) {
+    std::cerr << "ERROR: YAML file " << options.yaml << " doesn't exist." << std::endl;
+    return false;
+  }
+  if (yp.extension() != ".yml") {
+    std::cerr << "ERROR: config file " << options.yaml << " extension is not *.yml" << std::endl;
+    return false;
+  }
+  //-- the PostGIS outputs are connection strings and a progress "fd:N" is not a file
+  std::vector<std::string> files{ options.metrics, options.profile, options.savestate };
+  if (options.progress.compare(0, 3, "fd:") != 0)
+    files.push_back(options.progress);
+  for (auto& output : options.outputs) {
+    if (output.first.find("PostGIS") == std::string::npos)
+      files.push_back(output.second);
+  }
+  for (auto& file : files) {
+    if (file == "")
+      continue;
+    try {
+      canonical(boost::filesystem::path(file).parent_path(), boost::filesystem::current_path());
+    }
+    catch (boost::filesystem::filesystem_error &e) {
+      std::cerr << "ERROR: " << e.what() << ". Abort." << std::endl;
+      return false;
+    }
+  }
+  if (options.changed != "" && options.update == "") {
+    std::cerr << "ERROR: --changed can only be used with --update." << std::endl;
+    return false;
+  }
+  if (options.server && (options.update != "" || options.savestate != "")) {
+    std::cerr << "ERROR: --server cannot be used with --update or --save-state." << std::endl;
+    return false;
+  }
+  if (options.maxmemory != "" && parse_bytes(options.maxmemory) == 0) {
+    std::cerr << "ERROR: --max-memory " << options.maxmemory << " is not a size like 8G, 500M or 1048576. Aborting.\n";
+    return false;
+  }
+  return true;
+}
+
+/**
+ * the run of the command line: all the stages for the outputs, or the server,
+ * returns the exit code of the program
+ */
+int Pipeline::run(const RunOptions& options) {
+  auto startTime = boost::chrono::high_resolution_clock::now();
+  std::set<std::string> changed;
+  if (options.changed != "" && read_ids(options.changed, changed) == false) {
+    return EXIT_FAILURE;
+  }
+
+  Metrics& metrics = _map3d.get_metrics();
+  metrics.set_enabled(options.metrics != "");
+  _map3d.set_profile_features(options.profile != "");
+  if (options.maxmemory != "")
+    _map3d.set_max_memory(parse_bytes(options.maxmemory));
+  if (options.progress != "" && _map3d.get_progress().set_json_output(options.progress) == false) {
+    return EXIT_FAILURE;
+  }
+
+  //-- validate the YAML file right now, nicer for the user
+  if (read_config(options.yaml) == false) {
+    return EXIT_FAILURE;
+  }
+
+  //-- add the polygons to the map3d and spatially index them
+  if (load_polygons() == false || index() == false) {
+    return EXIT_FAILURE;
+  }
+
+  //-- the points are read for the extent of each request
+  if (options.server) {
+    return Server(*this).run(std::cin);
+  }
+
+  //-- keep the features that did not change since the previous run
+  if (options.update != "") {
+    if (read_state(options.update, changed) == false) {
+      return EXIT_FAILURE;
+    }
+    if (_map3d.get_num_polygons() == 0 && _map3d.get_num_deleted_features() == 0) {
+      std::clog << "No feature changed since the previous run, the outputs are not written again.\n";
+      if (options.savestate != "" && options.savestate != options.update && write_state(options.savestate) == false) {
+        return EXIT_FAILURE;
+      }
+      if (write_reports(options) == false) {
+        return EXIT_FAILURE;
+      }
+      print_duration("Successfully terminated in %d seconds || %02d:%02d:%02d\n", startTime);
+      return EXIT_SUCCESS;
+    }
+  }
+
+  //-- add the elevation data to the map3d, only deleted features have none to add
+  if (_map3d.get_num_polygons() > 0 && add_point_files() == false) {
+    return EXIT_FAILURE;
+  }
+
+  std::clog << "3dfying all input polygons...\n";
+  bool threedfy = true;
+  bool cdt = true;
+  std::vector<std::string> written;
+  for (auto& each : options.outputs) {
+    if (each.second != "")
+      written.push_back(each.first);
+  }
+  //-- the state needs all the stages
+  if (written.size() == 1 && options.savestate == "" && options.update == "") {
+    if (NORECONSTRUCTION.count(written[0]) > 0) {
+      threedfy = false;
+      cdt = false;
+      std::clog << NORECONSTRUCTION.at(written[0]) << std::endl;
+    }
+    else if (written[0] == "OBJ-NoID") {
+      // for OBJ-NoID only lift objects, skip stitching
+      _config.stitching = false;
+    }
+  }
+  if (threedfy) {
+    auto startThreeDfy = boost::chrono::high_resolution_clock::now();
+    Metrics::ScopedStage stage(metrics, "3dfying");
+    if (lift() == false || stitch() == false) {
+      return EXIT_FAILURE;
+    }
+    stage.stop(_map3d.get_num_polygons());
+    print_duration("Lifting, stitching and vertical walls done in %lld seconds || %02d:%02d:%02d\n", startThreeDfy);
+  }
+  if (cdt && triangulate() == false) {
+    return EXIT_FAILURE;
+  }
+  std::clog << "...3dfying done.\n";
+  if (options.savestate != "" && write_state(options.savestate) == false) {
+    return EXIT_FAILURE;
+  }
+  cleanup();
+
+  //-- write all outputs
+  if (write(options.outputs) == false) {
+    return EXIT_FAILURE;
+  }
+
+  if (write_reports(options) == false) {
+    return EXIT_FAILURE;
+  }
+
+  //-- bye-bye
+  print_duration("Successfully terminated in %d seconds || %02d:%02d:%02d\n", startTime);
+  return EXIT_SUCCESS;
+}
+
+//-- the --metrics and --profile-features files at the end of run()
+bool Pipeline::write_reports(const RunOptions& options) {
+  if (options.metrics != "" && _map3d.get_metrics().write(options.metrics) == false)
+    return false;
+  if (options.profile != "" && _map3d.get_feature_profile(options.profile, options.profiletop) == false)
+    return false;
+  return true;
+}
+
+/**
+ * read, validate and apply the YAML config file, the paths in it are relative
+ * to the folder of the file
+ */
+bool Pipeline::read_config(const std::string& filename) {
+  YAML::Node nodes;
+  boost::filesystem::path ypcan;
+  try {
+    nodes = YAML::LoadFile(filename);
+    ypcan = canonical(boost::filesystem::path(filename).parent_path(), boost::filesystem::current_path());
+  }
+  catch (const std::exception&) {
+    std::cerr << "ERROR: YAML structure of config is invalid.\n";
+    return false;
+  }
+  return read_config(nodes, ypcan.string());
+}
+
+/**
+ * validate the config and store its settings in the Map3d and the Config,
+ * basedir is the folder the paths of the datasets are relative to
+ */
+bool Pipeline::read_config(const YAML::Node& nodes, const std::string& basedir) {
+  if (validate_config(nodes) == false) {
+    std::cerr << "ERROR: config file (*.yml) is not valid. Aborting.\n";
+    return false;
+  }
+  std::clog << "Config file is valid.\n";
+  boost::filesystem::path ypcan(basedir);
+
+  //-- store the lifting options in the Map3d
+  if (nodes["lifting_options"]) {
+    YAML::Node n = nodes["lifting_options"];
+    if (n["Building"]) {
+      if (n["Building"]["roof"]) {
+        if (n["Building"]["roof"]["height"]) {
+          std::string height = n["Building"]["roof"]["height"].as<std::string>();
+          _map3d.set_building_heightref_roof(std::stof(height.substr(height.find_first_of("-") + 1)) / 100);
+        }
+        YAML::Node tmp = n["Building"]["roof"]["use_LAS_classes"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+          _map3d.add_allowed_las_class(LAS_BUILDING_ROOF, it2->as<int>());
+        if (n["Building"]["roof"]["use_LAS_classes_within"]) {
+          tmp = n["Building"]["roof"]["use_LAS_classes_within"];
+          for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+            _map3d.add_allowed_las_class_within(LAS_BUILDING_ROOF, it2->as<int>());
+        }
+      }
+      if (n["Building"]["ground"]) {
+        if (n["Building"]["ground"]["height"]) {
+          std::string height = n["Building"]["ground"]["height"].as<std::string>();
+          _map3d.set_building_heightref_ground(std::stof(height.substr(height.find_first_of("-") + 1)) / 100);
+        }
+        YAML::Node tmp = n["Building"]["ground"]["use_LAS_classes"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+          _map3d.add_allowed_las_class(LAS_BUILDING_GROUND, it2->as<int>());
+        if (n["Building"]["ground"]["use_LAS_classes_within"]) {
+          tmp = n["Building"]["ground"]["use_LAS_classes_within"];
+          for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+            _map3d.add_allowed_las_class_within(LAS_BUILDING_GROUND, it2->as<int>());
+        }
+      }
+      if (n["Building"]["lod"]) {
+        _map3d.set_building_lod(n["Building"]["lod"].as<int>());
+      }
+      if (n["Building"]["triangulate"]) {
+        if (n["Building"]["triangulate"].as<std::string>() == "true")
+          _map3d.set_building_triangulate(true);
+        else
+          _map3d.set_building_triangulate(false);
+      }
+      if (n["Building"]["floor"]) {
+        if (n["Building"]["floor"].as<std::string>() == "true")
+          _map3d.set_building_include_floor(true);
+        else
+          _map3d.set_building_include_floor(false);
+      }
+      if (n["Building"]["inner_walls"]) {
+        if (n["Building"]["inner_walls"].as<std::string>() == "true")
+          _map3d.set_building_inner_walls(true);
+        else
+          _map3d.set_building_inner_walls(false);
+      }
+    }
+    if (n["Terrain"]) {
+      if (n["Terrain"]["simplification"])
+        _map3d.set_terrain_simplification(n["Terrain"]["simplification"].as<int>());
+      if (n["Terrain"]["simplification_tinsimp"].as<double>() != 0)
+        _map3d.set_terrain_simplification_tinsimp(n["Terrain"]["simplification_tinsimp"].as<double>());
+      if (n["Terrain"]["innerbuffer"])
+        _map3d.set_terrain_innerbuffer(n["Terrain"]["innerbuffer"].as<float>());
+      YAML::Node tmp = n["Terrain"]["use_LAS_classes"];
+      for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+        _map3d.add_allowed_las_class(LAS_TERRAIN, it2->as<int>());
+      if (n["Terrain"]["use_LAS_classes_within"]) {
+        tmp = n["Terrain"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+          _map3d.add_allowed_las_class_within(LAS_TERRAIN, it2->as<int>());
+      }
+    }
+    if (n["Forest"]) {
+      if (n["Forest"]["simplification"])
+        _map3d.set_forest_simplification(n["Forest"]["simplification"].as<int>());
+      if (n["Forest"]["simplification_tinsimp"].as<double>() != 0)
+        _map3d.set_forest_simplification_tinsimp(n["Forest"]["simplification_tinsimp"].as<double>());
+      if (n["Forest"]["innerbuffer"])
+        _map3d.set_forest_innerbuffer(n["Forest"]["innerbuffer"].as<float>());
+      YAML::Node tmp = n["Forest"]["use_LAS_classes"];
+      for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+        _map3d.add_allowed_las_class(LAS_FOREST, it2->as<int>());
+      if (n["Forest"]["use_LAS_classes_within"]) {
+        tmp = n["Forest"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+          _map3d.add_allowed_las_class_within(LAS_FOREST, it2->as<int>());
+      }
+    }
+    if (n["Water"]) {
+      if (n["Water"]["height"]) {
+        std::string height = n["Water"]["height"].as<std::string>();
+        _map3d.set_water_heightref(std::stof(height.substr(height.find_first_of("-") + 1)) / 100);
+      }
+      YAML::Node tmp = n["Water"]["use_LAS_classes"];
+      for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+        _map3d.add_allowed_las_class(LAS_WATER, it2->as<int>());
+      if (n["Water"]["use_LAS_classes_within"]) {
+        tmp = n["Water"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+          _map3d.add_allowed_las_class_within(LAS_WATER, it2->as<int>());
+      }
+    }
+    if (n["Road"]) {
+      if (n["Road"]["height"]) {
+        std::string height = n["Road"]["height"].as<std::string>();
+        _map3d.set_road_heightref(std::stof(height.substr(height.find_first_of("-") + 1)) / 100);
+      }
+      if (n["Road"]["filter_outliers"]) {
+        if (n["Road"]["filter_outliers"].as<std::string>() == "true")
+          _map3d.set_road_filter_outliers(true);
+        else
+          _map3d.set_road_filter_outliers(false);
+      }
+      if (n["Road"]["flatten"]) {
+        if (n["Road"]["flatten"].as<std::string>() == "true")
+          _map3d.set_road_flatten(true);
+        else
+          _map3d.set_road_flatten(false);
+      }
+      if (n["Road"]["max_outlier_fraction"])
+          _map3d.set_road_max_outlier_fraction(n["Road"]["max_outlier_fraction"].as<float>());
+      YAML::Node tmp = n["Road"]["use_LAS_classes"];
+      for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+        _map3d.add_allowed_las_class(LAS_ROAD, it2->as<int>());
+      if (n["Road"]["use_LAS_classes_within"]) {
+        tmp = n["Road"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+          _map3d.add_allowed_las_class_within(LAS_ROAD, it2->as<int>());
+      }
+    }
+    if (n["Separation"]) {
+      if (n["Separation"]["height"]) {
+        std::string height = n["Separation"]["height"].as<std::string>();
+        _map3d.set_separation_heightref(std::stof(height.substr(height.find_first_of("-") + 1)) / 100);
+      }
+      YAML::Node tmp = n["Separation"]["use_LAS_classes"];
+      for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+        _map3d.add_allowed_las_class(LAS_SEPARATION, it2->as<int>());
+      if (n["Separation"]["use_LAS_classes_within"]) {
+        tmp = n["Separation"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+          _map3d.add_allowed_las_class_within(LAS_SEPARATION, it2->as<int>());
+      }
+    }
+    if (n["Bridge/Overpass"]) {
+      if (n["Bridge/Overpass"]["height"]) {
+        std::string height = n["Bridge/Overpass"]["height"].as<std::string>();
+        _map3d.set_bridge_heightref(std::stof(height.substr(height.find_first_of("-") + 1)) / 100);
+      }
+      if (n["Bridge/Overpass"]["flatten"]) {
+        if (n["Bridge/Overpass"]["flatten"].as<std::string>() == "true")
+          _map3d.set_bridge_flatten(true);
+        else
+          _map3d.set_bridge_flatten(false);
+      }
+      if (n["Bridge/Overpass"]["max_outlier_fraction"])
+          _map3d.set_bridge_max_outlier_fraction(n["Bridge/Overpass"]["max_outlier_fraction"].as<float>());
+      YAML::Node tmp = n["Bridge/Overpass"]["use_LAS_classes"];
+      for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+        _map3d.add_allowed_las_class(LAS_BRIDGE, it2->as<int>());
+      if (n["Bridge/Overpass"]["use_LAS_classes_within"]) {
+        tmp = n["Bridge/Overpass"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+          _map3d.add_allowed_las_class_within(LAS_BRIDGE, it2->as<int>());
+      }
+    }
+  }
+
+
+  //-- set al general options
+  if (nodes["options"]) {
+    YAML::Node n = nodes["options"];
+    if (n["radius_vertex_elevation"])
+      _map3d.set_radius_vertex_elevation(n["radius_vertex_elevation"].as<float>());
+    if (n["building_radius_vertex_elevation"])
+      _map3d.set_building_radius_vertex_elevation(n["building_radius_vertex_elevation"].as<float>());
+    if (n["threshold_jump_edges"])
+      _map3d.set_threshold_jump_edges(n["threshold_jump_edges"].as<float>());
+    if (n["threshold_bridge_jump_edges"])
+      _map3d.set_threshold_bridge_jump_edges(n["threshold_bridge_jump_edges"].as<float>());
+    else if (n["threshold_jump_edges"]) // set threshold_jump_edges same for bridge
+      _map3d.set_threshold_bridge_jump_edges(n["threshold_jump_edges"].as<float>());
+    if (n["stitching"] && n["stitching"].as<std::string>() == "false")
+      _config.stitching = false;
+    if (n["max_angle_curvepolygon"])
+      _map3d.set_max_angle_curvepolygon(n["max_angle_curvepolygon"].as<double>());
+    if (n["single_tin"] && n["single_tin"].as<std::string>() == "true")
+      _map3d.set_single_tin(true);
+    if (n["srs"])
+      _map3d.set_srs(n["srs"].as<std::string>());
+
+    if (n["extent"]) {
+      std::vector<std::string> extent_split = stringsplit(n["extent"].as<std::string>(), ',');
+      double xmin, xmax, ymin, ymax;
+      bool wentgood = true;
+      try {
+        xmin = boost::lexical_cast<double>(extent_split[0]);
+        ymin = boost::lexical_cast<double>(extent_split[1]);
+        xmax = boost::lexical_cast<double>(extent_split[2]);
+        ymax = boost::lexical_cast<double>(extent_split[3]);
+      }
+      catch (boost::bad_lexical_cast& e) {
+        wentgood = false;
+      }
+
+      if (!wentgood || xmin > xmax || ymin > ymax || boost::geometry::area(Box2(Point2(xmin, ymin), Point2(xmax, ymax))) <= 0.0) {
+        std::cerr << "ERROR: The supplied extent is not valid: (" << n["extent"].as<std::string>() << "), using all polygons\n";
+      }
+      else {
+        std::clog << std::setprecision(3) << std::fixed;
+        std::clog << "Using extent for polygons: (" << xmin << ", " << ymin << ", " << xmax << ", " << ymax << ")\n";
+        _map3d.set_requested_extent(xmin, ymin, xmax, ymax);
+      }
+    }
+  }
+
+
+  //-- read polygon data configuration
+  if (nodes["input_polygons"]) {
+    YAML::Node n = nodes["input_polygons"];
+    for (auto it = n.begin(); it != n.end(); ++it) {
+      // Get the correct uniqueid attribute
+      std::string uniqueid = "fid";
+      if ((*it)["uniqueid"]) {
+        uniqueid = (*it)["uniqueid"].as<std::string>();
+      }
+      // Get the correct height attribute
+      std::string heightfield = "";
+      if ((*it)["height_field"]) {
+        heightfield = (*it)["height_field"].as<std::string>();
+      }
+      // Get the handle_multiple_heights setting
+      bool handle_multiple_heights = false;
+      if ((*it)["handle_multiple_heights"] && (*it)["handle_multiple_heights"].as<std::string>() == "true") {
+        handle_multiple_heights = true;
+      }
+      // Get all datasets
+      YAML::Node datasets = (*it)["datasets"];
+      for (auto it2 = datasets.begin(); it2 != datasets.end(); ++it2) {
+        boost::filesystem::path thepath(it2->as<std::string>());
+        if (thepath.stem() == "*") {
+          // std::cout << "GLOB *** GLOB" << std::endl;
+          boost::filesystem::path rootPath = canonical(thepath.parent_path(), ypcan).make_preferred();
+          if (!boost::filesystem::exists(rootPath) || !boost::filesystem::is_directory(rootPath)) {
+            std::cerr << "ERROR: " << rootPath << "is not a directory.\n";
+            return false;
+          }
+          else {
+            boost::filesystem::recursive_directory_iterator it_end;
+            for (boost::filesystem::recursive_directory_iterator it3(rootPath); it3 != it_end; ++it3) {
+              if (boost::filesystem::is_regular_file(*it3) && it3->path().extension() == thepath.extension()) {
+                PolygonFile file;
+                boost::filesystem::path p = canonical(it3->path().string(), ypcan).make_preferred();
+                // std::cout << "=>" << p << std::endl;
+                file.filename = p.string();
+                file.idfield = uniqueid;
+                file.heightfield = heightfield;
+                file.handle_multiple_heights = handle_multiple_heights;
+                if ((*it)["lifting"]) {
+                  file.layers.emplace_back(std::string(), (*it)["lifting"].as<std::string>());
+                  _config.polygonFiles.push_back(file);
+                } else if ((*it)["lifting_per_layer"]) {
+                  YAML::Node layers = (*it)["lifting_per_layer"];
+                  for (auto it4 = layers.begin(); it4 != layers.end(); ++it4) {
+                    file.layers.emplace_back(it4->first.as<std::string>(), it4->second.as<std::string>());
+                  }
+                  _config.polygonFiles.push_back(file);
+                }
+              }
+            }
+          }
+        }
+        else {
+          PolygonFile file;
+          boost::filesystem::path p = canonical(thepath, ypcan).make_preferred();
+          // std::cout << "=>" << p << std::endl;
+          file.filename = p.string();
+          file.idfield = uniqueid;
+          file.heightfield = heightfield;
+          file.handle_multiple_heights = handle_multiple_heights;
+          if ((*it)["lifting"]) {
+            file.layers.emplace_back(std::string(), (*it)["lifting"].as<std::string>());
+            _config.polygonFiles.push_back(file);
+          } else if ((*it)["lifting_per_layer"]) {
+            YAML::Node layers = (*it)["lifting_per_layer"];
+            for (auto it3 = layers.begin(); it3 != layers.end(); ++it3) {
+              file.layers.emplace_back(it3->first.as<std::string>(), it3->second.as<std::string>());
+            }
+            _config.polygonFiles.push_back(file);
+          }
+        }
+      }
+    }
+  }
+
+
+  //-- read elevation data configuration
+  //-- add elevation datasets
+  if (nodes["input_elevation"]) {
+    YAML::Node n = nodes["input_elevation"];
+    for (auto it = n.begin(); it != n.end(); ++it) {
+      YAML::Node tmp = (*it)["omit_LAS_classes"];
+      std::vector<int> lasomits;
+      for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2)
+        lasomits.push_back(it2->as<int>());
+      tmp = (*it)["datasets"];
+      for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+        int thinning = 1;
+        if ((*it)["thinning"]) {
+          thinning = (*it)["thinning"].as<int>();
+          if (thinning == 0) {
+            thinning = 1;
+          }
+        }
+
+        //-- iterate over all files in directory
+        boost::filesystem::path thepath(it2->as<std::string>());
+        if (thepath.stem() == "*") {
+          boost::filesystem::path rootPath = canonical(thepath.parent_path(), ypcan).make_preferred();
+          if (!boost::filesystem::exists(rootPath) || !boost::filesystem::is_directory(rootPath)) {
+            std::cerr << "ERROR: " << rootPath << "is not a directory. Can not read LAS file.\n";
+            return false;
+          }
+          else {
+            boost::filesystem::recursive_directory_iterator it_end;
+            for (boost::filesystem::recursive_directory_iterator it3(rootPath); it3 != it_end; ++it3) {
+              if (boost::filesystem::is_regular_file(*it3) && it3->path().extension() == thepath.extension()) {
+                PointFile pointFile;
+                boost::filesystem::path p = canonical(it3->path().string(), ypcan).make_preferred();
+                pointFile.filename = p.string();
+                pointFile.lasomits = lasomits;
+                pointFile.thinning = thinning;
+                _config.pointFiles.push_back(pointFile);
+              }
+            }
+          }
+        }
+        else {
+          boost::filesystem::path p;
+          try {
+            p = canonical(thepath, ypcan).make_preferred();
+          } 
+          catch (boost::filesystem::filesystem_error &e) {
+            std::cerr << "WARNING: " << e.what() << ". Abort." << std::endl;
+            return false;
+          }
+          PointFile pointFile;
+          pointFile.filename = p.string();
+          pointFile.lasomits = lasomits;
+          pointFile.thinning = thinning;
+          _config.pointFiles.push_back(pointFile);
+        }
+      }
+    }
+  }
+
+  if (nodes["output"] && nodes["output"]["gdal_driver"])
+    _config.gdalDriver = nodes["output"]["gdal_driver"].as<std::string>();
+  return true;
+}
+
+Config& Pipeline::get_config() {
+  return _config;
+}
+
+Map3d& Pipeline::get_map3d() {
+  return _map3d;
+}
+
+/**
+ * read the polygons of the polygon files of the Config
+ */
+bool Pipeline::load_polygons() {
+  //-- check if all polygon files exist
+  bool bPolyData = false;
+#if GDAL_VERSION_MAJOR < 2
+  if (OGRSFDriverRegistrar::GetRegistrar()->GetDriverCount() == 0)
+    OGRRegisterAll();
+#else
+  if (GDALGetDriverCount() == 0)
+    GDALAllRegister();
+#endif
+
+  for (auto file = _config.polygonFiles.begin(); file != _config.polygonFiles.end(); ++file) {
+#if GDAL_VERSION_MAJOR < 2
+    OGRDataSource *dataSource = OGRSFDriverRegistrar::Open(file->filename.c_str(), false);
+#else
+    GDALDataset *dataSource = (GDALDataset*)GDALOpenEx(file->filename.c_str(), GDAL_OF_READONLY | GDAL_OF_VECTOR, NULL, NULL, NULL);
+#endif
+    if (dataSource != NULL) {
+      bPolyData = true;
+    }
+#if GDAL_VERSION_MAJOR < 2
+    OGRDataSource::DestroyDataSource(dataSource);
+#else
+    GDALClose(dataSource);
+#endif
+    if (bPolyData == false) {
+      std::string logstring = "Reading input dataset: " + file->filename;
+      if (strncmp(file->filename.c_str(), "PG:", strlen("PG:")) == 0) {
+        logstring = "Opening PostgreSQL database connection.";
+      }
+      std::cerr << "\tERROR: " << logstring << std::endl;
+      return false;
+    }
+  }
+
+  if (bPolyData) {
+    Metrics::ScopedStage stage(_map3d.get_metrics(), "read_polygons");
+    bPolyData = _map3d.add_polygons_files(_config.polygonFiles);
+    stage.stop(_map3d.get_num_polygons());
+  }
+  if (!bPolyData) {
+    std::cerr << "ERROR: Missing polygon data, cannot 3dfy the dataset. Aborting.\n";
+    return false;
+  }
+  std::clog << "\nTotal # of polygons: " << boost::locale::as::number << _map3d.get_num_polygons() << std::endl;
+  _map3d.save_building_variables();
+  return true;
+}
+
+/**
+ * spatially index the polygons, to assign the points to them
+ */
+bool Pipeline::index() {
+  if (_map3d.construct_rtree() == false)
+    return false;
+  //-- print bbox from _rtree
+  Box2 b = _map3d.get_bbox();
+  std::clog << std::setprecision(3) << std::fixed;
+  std::clog << "Spatial extent: ("
+    << bg::get<bg::min_corner, 0>(b) << ", "
+    << bg::get<bg::min_corner, 1>(b) << ") ("
+    << bg::get<bg::max_corner, 0>(b) << ", "
+    << bg::get<bg::max_corner, 1>(b) << ")\n";
+  return true;
+}
+
+/**
+ * 3dfy only the polygons intersecting extent, they are reset so the stages
+ * after index() can be run again for each extent; returns their number
+ */
+unsigned long Pipeline::select(const Box2& extent) {
+  unsigned long n = _map3d.select_features(extent);
+  std::clog << "Polygons in extent: " << boost::locale::as::number << n << std::endl;
+  return n;
+}
+
+/**
+ * keep the features that did not change since the run that wrote the state,
+ * the others are 3dfied with their neighbours; changed has the ids of the
+ * changed and deleted features, the other changes are found in the state;
+ * all are 3dfied again when the lifting options or the stitching differ
+ */
+bool Pipeline::read_state(const std::string& filename, const std::set<std::string>& changed) {
+  auto startState = boost::chrono::high_resolution_clock::now();
+  if (_map3d.read_state(filename, changed, _map3d.get_lifting_hash(_config.stitching)) == false)
+    return false;
+  _update = true;
+  print_duration("State read in %lld seconds || %02d:%02d:%02d\n", startState);
+  return true;
+}
+
+//-- after triangulate() and before cleanup(), which frees the heights of the vertices
+bool Pipeline::write_state(const std::string& filename) {
+  std::clog << "Writing the state to " << filename << std::endl;
+  return _map3d.write_state(filename, _map3d.get_lifting_hash(_config.stitching));
+}
+
+/**
+ * read the points of the point files of the Config
+ */
+bool Pipeline::add_point_files() {
+  //-- check if all elevation files exist
+  for (auto& file : _config.pointFiles) {
+    std::ifstream f(file.filename);
+    if (!f.good()) {
+      std::cerr << "ERROR: cannot open file " << file.filename << std::endl;
+      return false;
+    }
+  }
+
+  Metrics& metrics = _map3d.get_metrics();
+  auto startPoints = boost::chrono::high_resolution_clock::now();
+  Metrics::ScopedStage stagePoints(metrics, "read_points");
+  for (auto& file : _config.pointFiles) {
+    bool added = _map3d.add_las_file(file);
+    if (!added) {
+      std::cerr << "ERROR: corrupt file " << file.filename << std::endl;
+      return false;
+    }
+    _map3d.check_memory("reading " + file.filename);
+  }
+  stagePoints.stop(metrics.get_points_read());
+  print_duration("All points read in %lld seconds || %02d:%02d:%02d\n", startPoints);
+  return true;
+}
+
+/**
+ * add a batch of points held in memory, see Map3d::add_points(); returns the
+ * number of points assigned to a polygon
+ */
+unsigned long Pipeline::add_points(const PointBatch& points) {
+  return _map3d.add_points(points);
+}
+
+bool Pipeline::lift() {
+  return _map3d.lift();
+}
+
+/**
+ * stitch the features and create the vertical walls, does nothing when
+ * stitching is off in the Config
+ */
+bool Pipeline::stitch() {
+  if (_config.stitching == false)
+    return true;
+  return _map3d.stitch();
+}
+
+bool Pipeline::triangulate() {
+  auto startCDT = boost::chrono::high_resolution_clock::now();
+  if (!_map3d.construct_CDT())
+    return false;
+  print_duration("CDT created in %lld seconds || %02d:%02d:%02d\n", startCDT);
+  return true;
+}
+
+/**
+ * free the elevations of the points once the features are lifted, before
+ * the outputs are written
+ */
+void Pipeline::cleanup() {
+  _map3d.cleanup_elevations();
+  if (_update)
+    _map3d.select_all_features();
+  _map3d.check_memory("3dfying");
+}
+
+const std::vector<std::string>& Pipeline::get_formats() {
+  return FORMATS;
+}
+
+const std::vector<std::string>& Pipeline::get_stream_formats() {
+  return STREAMFORMATS;
+}
+
+bool Pipeline::is_format(const std::string& format) {
+  return std::find(FORMATS.begin(), FORMATS.end(), format) != FORMATS.end();
+}
+
+bool Pipeline::is_stream_format(const std::string& format) {
+  return std::find(STREAMFORMATS.begin(), STREAMFORMATS.end(), format) != STREAMFORMATS.end();
+}
+
+/**
+ * write all outputs, format -> file name (or folder or connection string),
+ * the ones that can be written together in a single pass over the features
+ */
+bool Pipeline::write(const std::map<std::string, std::string>& outputs) {
+  Metrics& metrics = _map3d.get_metrics();
+  Progress& progress = _map3d.get_progress();
+  //-- several outputs that can be written together are written in a single pass over the features
+  std::map<std::string, TextWriter> singlepass;
+  for (auto& output : outputs) {
+    if (output.second != "" && Map3d::is_single_pass_format(output.first))
+      singlepass[output.first];
+  }
+  if (singlepass.size() > 1) {
+    auto startFileWriting = boost::chrono::high_resolution_clock::now();
+    std::map<std::string, TextWriter*> writers;
+    std::string names;
+    for (auto& each : singlepass) {
+      names += " " + each.first;
+      if (each.second.open(outputs.at(each.first)) == false) {
+        std::cerr << "ERROR: cannot write " << each.first << " file " << outputs.at(each.first) << ". Aborting.\n";
+        return false;
+      }
+      std::clog << each.first << " output: " << outputs.at(each.first) << std::endl;
+      writers[each.first] = &each.second;
+    }
+    Metrics::ScopedStage stage(metrics, "write" + names);
+    progress.start("write" + names, _map3d.get_num_polygons());
+    _map3d.get_outputs(writers);
+    progress.finish();
+    unsigned long long bytes = 0;
+    unsigned long long uncompressed = 0;
+    for (auto& each : singlepass) {
+      each.second.close();
+      bytes += each.second.bytes_written();
+      uncompressed += each.second.bytes_uncompressed();
+    }
+    stage.stop(_map3d.get_num_polygons(), bytes);
+    print_duration("Features written in %d seconds || %02d:%02d:%02d\n", startFileWriting);
+    print_written(bytes, uncompressed, boost::chrono::duration<double>(boost::chrono::high_resolution_clock::now() - startFileWriting).count());
+  }
+  else {
+    singlepass.clear();
+  }
+
+  //-- iterate over all output
+  for (auto& output : outputs) {
+    if (output.second == "" || singlepass.count(output.first) > 0)
+      continue;
+    if (write(output.first, output.second) == false)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * write one output to a file, or to a folder or database for the formats
+ * that are not a stream
+ */
+bool Pipeline::write(const std::string& format, const std::string& filename) {
+  TextWriter of;
+  if (is_stream_format(format) || format == "glTF") {
+    if (of.open(filename) == false) {
+      std::cerr << "ERROR: cannot write " << format << " file " << filename << ". Aborting.\n";
+      return false;
+    }
+  }
+  return write_output(format, filename, of);
+}
+
+/**
+ * write one output to sink, in blocks of about 1MB, only for the formats of
+ * get_stream_formats()
+ */
+bool Pipeline::write(const std::string& format, const TextWriter::Sink& sink) {
+  if (is_stream_format(format) == false) {
+    std::cerr << "ERROR: " << format << " cannot be written to a stream.\n";
+    return false;
+  }
+  TextWriter of;
+  of.open(sink);
+  return write_output(format, "stream", of);
+}
+
+bool Pipeline::write_output(const std::string& format, const std::string& ofname, TextWriter& of) {
+  Metrics& metrics = _map3d.get_metrics();
+  Progress& progress = _map3d.get_progress();
+  auto startFileWriting = boost::chrono::high_resolution_clock::now();
+  bool fileWritten = true;
+  Metrics::ScopedStage stage(metrics, "write " + format);
+  progress.start("write " + format, _map3d.get_num_polygons());
+  if (format == "CityGML") {
+    std::clog << "CityGML output: " << ofname << std::endl;
+    _map3d.get_citygml(of);
+  }
+  else if (format == "CityGML-Multifile") {
+    std::clog << "CityGML multiple file output: " << ofname << std::endl;
+    _map3d.get_citygml_multifile(ofname);
+  }
+  else if (format == "CityGML-IMGeo") {
+    std::clog << "IMGeo (CityGML ADE) output: " << ofname << std::endl;
+    _map3d.get_citygml_imgeo(of);
+  }
+  else if (format == "CityGML-IMGeo-Multifile") {
+    std::clog << "IMGeo (CityGML ADE) multiple file output: " << ofname << std::endl;
+    _map3d.get_citygml_imgeo_multifile(ofname);
+  }
+  else if (format == "CityJSON") {
+    std::clog << "CityJSON output: " << ofname << std::endl;
+    fileWritten = _map3d.get_cityjson(of);
+  }
+  else if (format == "OBJ") {
+    std::clog << "OBJ output: " << ofname << std::endl;
+    _map3d.get_obj_per_feature(of);
+  }
+  else if (format == "OBJ-NoID") {
+    std::clog << "OBJ (without IDs, sorted per class) output: " << ofname << std::endl;
+    _map3d.get_obj_per_class(of);
+  }
+  else if (format == "STL") {
+    std::clog << "STL output: " << ofname << std::endl;
+    _map3d.get_stl(of);
+  }
+  else if (format == "STL-binary") {
+    std::clog << "STL (binary) output: " << ofname << std::endl;
+    _map3d.get_stl_binary(of);
+  }
+  else if (format == "glTF") {
+    std::clog << "glTF output: " << ofname << std::endl;
+    fileWritten = _map3d.get_gltf(of, ofname, false);
+  }
+  else if (format == "GLB") {
+    std::clog << "glTF (binary GLB) output: " << ofname << std::endl;
+    fileWritten = _map3d.get_gltf(of, ofname, true);
+  }
+  else if (format == "3DTiles") {
+    std::clog << "3D Tiles output: " << ofname << std::endl;
+    fileWritten = _map3d.get_3dtiles(ofname);
+  }
+  else if (format == "CSV-BUILDINGS") {
+    std::clog << "CSV output (only of the buildings): " << ofname << std::endl;
+    _map3d.get_csv_buildings(of);
+  }
+  else if (format == "CSV-BUILDINGS-MULTIPLE") {
+    std::clog << "CSV output with multiple heights (only of the buildings): " << ofname << std::endl;
+    _map3d.get_csv_buildings_multiple_heights(of);
+  }
+  else if (format == "CSV-BUILDINGS-ALL-Z") {
+    std::clog << "CSV output with all z values (only of the buildings): " << ofname << std::endl;
+    _map3d.get_csv_buildings_all_elevation_points(of);
+  }
+  else if (format == "Shapefile") {
+    std::clog << "Shapefile output: " << ofname << std::endl;
+    fileWritten = _map3d.get_gdal_output(ofname, "ESRI Shapefile", false);
+  }
+  else if (format == "Shapefile-Multifile") {
+    std::clog << "Shapefile multiple file output: " << ofname << std::endl;
+    fileWritten = _map3d.get_gdal_output(ofname, "ESRI Shapefile", true);
+  }
+  else if (format == "FlatGeobuf") {
+    std::clog << "FlatGeobuf output: " << ofname << std::endl;
+    fileWritten = _map3d.get_gdal_output_hilbert(ofname, "FlatGeobuf", ".fgb");
+  }
+  else if (format == "GeoParquet") {
+    std::clog << "GeoParquet output: " << ofname << std::endl;
+    fileWritten = _map3d.get_gdal_output_hilbert(ofname, "Parquet", ".parquet");
+  }
+  else if (format == "PostGIS") {
+    std::clog << "PostGIS output\n";
+    fileWritten = _map3d.get_postgis_output(ofname, false, false);
+  }
+  else if (format == "PostGIS-PDOK") {
+    std::clog << "PostGIS with IMGeo GML string output\n";
+    fileWritten = _map3d.get_postgis_output(ofname, true,  false);
+  }
+  else if (format == "PostGIS-PDOK-CityGML") {
+    std::clog << "PostGIS with CityGML string output\n";
+    fileWritten = _map3d.get_postgis_output(ofname, true, true);
+  }
+  else if (format == "PostGIS-COPY") {
+    std::clog << "PostGIS COPY script output: " << ofname << std::endl;
+    fileWritten = _map3d.get_postgis_copy(of, false, false);
+  }
+  else if (format == "PostGIS-PDOK-COPY") {
+    std::clog << "PostGIS COPY script with IMGeo GML string output: " << ofname << std::endl;
+    fileWritten = _map3d.get_postgis_copy(of, true, false);
+  }
+  else if (format == "PostGIS-PDOK-CityGML-COPY") {
+    std::clog << "PostGIS COPY script with CityGML string output: " << ofname << std::endl;
+    fileWritten = _map3d.get_postgis_copy(of, true, true);
+  }
+  else if (format == "GDAL") { //-- TODO: what is this? a path? how to use?
+    if (_config.gdalDriver != "") {
+      std::clog << "GDAL output using driver '" + _config.gdalDriver + "'\n";
+      fileWritten = _map3d.get_gdal_output(ofname, _config.gdalDriver, false);
+    }
+  }
+  else {
+    std::cerr << "ERROR: unknown output format " << format << ".\n";
+    fileWritten = false;
+  }
+  of.close();
+  progress.finish();
+  stage.stop(_map3d.get_num_polygons(), of.bytes_written());
+
+  if (fileWritten) {
+    print_duration("Features written in %d seconds || %02d:%02d:%02d\n", startFileWriting);
+    if (of.bytes_written() > 0)
+      print_written(of.bytes_written(), of.bytes_uncompressed(), boost::chrono::duration<double>(boost::chrono::high_resolution_clock::now() - startFileWriting).count());
+  }
+  else {
+    std::cerr << "ERROR: Writing features failed for " << format << ". Aborting.\n";
+  }
+  return fileWritten;
+}
+
+/**
+ * check the YAML config before anything is read, nicer for the user
+ */
+static bool validate_config(const YAML::Node& nodes) {
+  bool wentgood = true;
+  //-- 1. input polygons classes
+  if (nodes["input_polygons"]) {
+    YAML::Node n = nodes["input_polygons"];
+    for (auto it = n.begin(); it != n.end(); ++it) {
+      if ((*it)["lifting_per_layer"]) {
+        YAML::Node tmp = (*it)["lifting_per_layer"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (ALLOWEDFEATURES.count((it2->second).as<std::string>()) == 0) {
+            std::cerr << "\tLifting class '" << (it2->second).as<std::string>() << "' unknown.\n";
+            wentgood = false;
+          }
+        }
+      }
+      else if ((*it)["lifting"]) {
+        if ((*it)["lifting"].IsNull()) {
+          std::cerr << "Option 'lifting' invalid; supplied empty attribute. \n";
+          wentgood = false;
+        }
+        else if (ALLOWEDFEATURES.count((*it)["lifting"].as<std::string>()) == 0) {
+          std::cerr << "\tLifting class '" << (*it)["lifting"].as<std::string>() << "' unknown.\n";
+          wentgood = false;
+        }
+        if ((*it)["uniqueid"].IsNull()) {
+          std::cerr << "Option 'uniqueid' invalid; supplied empty attribute. \n";
+          wentgood = false;
+        }
+        if ((*it)["height_field"].IsNull()) {
+          std::cerr << "Option 'height_field' invalid; supplied empty attribute. \n";
+          wentgood = false;
+        }
+      }
+    }
+  }
+  else {
+    std::cerr << "Group 'input_polygons' not defined. \n";
+    wentgood = false;
+  }
+
+  //-- 2. lifting_options
+  if (nodes["lifting_options"]) {
+    YAML::Node n = nodes["lifting_options"];
+    if (n["Building"]) {
+      if (n["Building"]["roof"]) {
+        if (n["Building"]["roof"]["height"]) {
+          std::string s = n["Building"]["roof"]["height"].as<std::string>();
+          if ((s.substr(0, s.find_first_of("-")) != "percentile") ||
+            (is_string_integer(s.substr(s.find_first_of("-") + 1), 0, 100) == false)) {
+            wentgood = false;
+            std::cerr << "\tOption 'Building.roof.height' invalid; must be 'percentile-XX'.\n";
+          }
+        }
+        if (n["Building"]["roof"]["use_LAS_classes"]) {
+          YAML::Node tmp = n["Building"]["roof"]["use_LAS_classes"];
+          for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+            if (is_string_integer(it2->as<std::string>()) == false) {
+              wentgood = false;
+              std::cerr << "\tOption 'Building.roof.use_LAS_classes' invalid; must be an integer.\n";
+            }
+          }
+        }
+        if (n["Building"]["roof"]["use_LAS_classes_within"]) {
+          YAML::Node tmp = n["Building"]["roof"]["use_LAS_classes_within"];
+          for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+            if (is_string_integer(it2->as<std::string>()) == false) {
+              wentgood = false;
+              std::cerr << "\tOption 'Building.roof.use_LAS_classes_within' invalid; must be an integer.\n";
+            }
+          }
+        }
+      }
+      if (n["Building"]["ground"]) {
+        if (n["Building"]["ground"]["height"]) {
+          std::string s = n["Building"]["ground"]["height"].as<std::string>();
+          if ((s.substr(0, s.find_first_of("-")) != "percentile") ||
+            (is_string_integer(s.substr(s.find_first_of("-") + 1), 0, 100) == false)) {
+            wentgood = false;
+            std::cerr << "\tOption 'Building.ground.height' invalid; must be 'percentile-XX'.\n";
+          }
+        }
+        if (n["Building"]["ground"]["use_LAS_classes"]) {
+          YAML::Node tmp = n["Building"]["ground"]["use_LAS_classes"];
+          for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+            if (is_string_integer(it2->as<std::string>()) == false) {
+              wentgood = false;
+              std::cerr << "\tOption 'Building.ground.use_LAS_classes' invalid; must be an integer.\n";
+            }
+          }
+        }
+        if (n["Building"]["ground"]["use_LAS_classes_within"]) {
+          YAML::Node tmp = n["Building"]["ground"]["use_LAS_classes_within"];
+          for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+            if (is_string_integer(it2->as<std::string>()) == false) {
+              wentgood = false;
+              std::cerr << "\tOption 'Building.ground.use_LAS_classes_within' invalid; must be an integer.\n";
+            }
+          }
+        }
+      }
+      if (n["Building"]["lod"]) {
+        if (is_string_integer(n["Building"]["lod"].as<std::string>(), 0, 1) == false) {
+          wentgood = false;
+          std::cerr << "\tOption 'Building.lod' invalid; must be an integer between 0 and 1.\n";
+        }
+      }
+      if (n["Building"]["triangulate"]) {
+        std::string s = n["Building"]["triangulate"].as<std::string>();
+        if ((s != "true") && (s != "false")) {
+          wentgood = false;
+          std::cerr << "\tOption 'Building.triangulate' invalid; must be 'true' or 'false'.\n";
+        }
+      }
+      if (n["Building"]["floor"]) {
+        std::string s = n["Building"]["floor"].as<std::string>();
+        if ((s != "true") && (s != "false")) {
+          wentgood = false;
+          std::cerr << "\tOption 'Building.floor' invalid; must be 'true' or 'false'.\n";
+        }
+      }
+      if (n["Building"]["inner_walls"]) {
+        std::string s = n["Building"]["inner_walls"].as<std::string>();
+        if ((s != "true") && (s != "false")) {
+          wentgood = false;
+          std::cerr << "\tOption 'Building.inner_walls' invalid; must be 'true' or 'false'.\n";
+        }
+      }
+    }
+    if (n["Terrain"]) {
+      if (n["Terrain"]["simplification"]) {
+        if (is_string_integer(n["Terrain"]["simplification"].as<std::string>()) == false) {
+          wentgood = false;
+          std::cerr << "\tOption 'Terrain.simplification' invalid; must be an integer.\n";
+        }
+      }
+      if (n["Terrain"]["simplification_tinsimp"]) {
+        try {
+          boost::lexical_cast<float>(n["Terrain"]["simplification_tinsimp"].as<std::string>());
+        }
+        catch (boost::bad_lexical_cast& e) {
+          wentgood = false;
+          std::cerr << "\tOption 'Terrain.simplification_tinsimp' invalid; must be a double.\n";
+        }
+      }
+      if (n["Terrain"]["innerbuffer"]) {
+        try {
+          boost::lexical_cast<float>(n["Terrain"]["innerbuffer"].as<std::string>());
+        }
+        catch (boost::bad_lexical_cast& e) {
+          wentgood = false;
+          std::cerr << "\tOption 'Terrain.innerbuffer' invalid; must be a float.\n";
+        }
+      }        
+      if (n["Terrain"]["use_LAS_classes"]) {
+        YAML::Node tmp = n["Terrain"]["use_LAS_classes"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Terrain.use_LAS_classes' invalid; must be an integer.\n";
+          }
+        }
+      }        
+      if (n["Terrain"]["use_LAS_classes_within"]) {
+        YAML::Node tmp = n["Terrain"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Terrain.use_LAS_classes_within' invalid; must be an integer.\n";
+          }
+        }
+      }
+    }
+    if (n["Forest"]) {
+      if (n["Forest"]["simplification"]) {
+        if (is_string_integer(n["Forest"]["simplification"].as<std::string>()) == false) {
+          wentgood = false;
+          std::cerr << "\tOption 'Forest.simplification' invalid; must be an integer.\n";
+        }
+      }
+      if (n["Forest"]["simplification_tinsimp"]) {
+        try {
+          boost::lexical_cast<float>(n["Forest"]["simplification_tinsimp"].as<std::string>());
+        }
+        catch (boost::bad_lexical_cast& e) {
+          wentgood = false;
+          std::cerr << "\tOption 'Forest.simplification_tinsimp' invalid; must be a double.\n";
+        }
+      }
+      if (n["Forest"]["innerbuffer"]) {
+        try {
+          boost::lexical_cast<float>(n["Forest"]["innerbuffer"].as<std::string>());
+        }
+        catch (boost::bad_lexical_cast& e) {
+          wentgood = false;
+          std::cerr << "\tOption 'Forest.innerbuffer' invalid; must be a float.\n";
+        }
+      }      
+      if (n["Forest"]["use_LAS_classes"]) {
+        YAML::Node tmp = n["Forest"]["use_LAS_classes"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Forest.use_LAS_classes' invalid; must be an integer.\n";
+          }
+        }
+      } 
+      if (n["Forest"]["use_LAS_classes_within"]) {
+        YAML::Node tmp = n["Forest"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Forest.use_LAS_classes_within' invalid; must be an integer.\n";
+          }
+        }
+      }
+    }
+    if (n["Water"]) {
+      if (n["Water"]["height"]) {
+        std::string s = n["Water"]["height"].as<std::string>();
+        if ((s.substr(0, s.find_first_of("-")) != "percentile") ||
+          (is_string_integer(s.substr(s.find_first_of("-") + 1), 0, 100) == false)) {
+          wentgood = false;
+          std::cerr << "\tOption 'Water.height' invalid; must be 'percentile-XX'.\n";
+        }
+      }      
+      if (n["Water"]["use_LAS_classes"]) {
+        YAML::Node tmp = n["Water"]["use_LAS_classes"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Water.use_LAS_classes' invalid; must be an integer.\n";
+          }
+        }
+      }   
+      if (n["Water"]["use_LAS_classes_within"]) {
+        YAML::Node tmp = n["Water"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Water.use_LAS_classes_within' invalid; must be an integer.\n";
+          }
+        }
+      }
+    }
+    if (n["Road"]) {
+      if (n["Road"]["height"]) {
+        std::string s = n["Road"]["height"].as<std::string>();
+        if ((s.substr(0, s.find_first_of("-")) != "percentile") ||
+          (is_string_integer(s.substr(s.find_first_of("-") + 1), 0, 100) == false)) {
+          wentgood = false;
+          std::cerr << "\tOption 'Road.height' invalid; must be 'percentile-XX'.\n";
+        }
+      }
+      if (n["Road"]["filter_outliers"]) {
+        std::string s = n["Road"]["filter_outliers"].as<std::string>();
+        if ((s != "true") && (s != "false")) {
+          wentgood = false;
+          std::cerr << "\tOption 'Road.filter_outliers' invalid; must be 'true' or 'false'.\n";
+        }
+      }
+      if (n["Road"]["flatten"]) {
+        std::string s = n["Road"]["flatten"].as<std::string>();
+        if ((s != "true") && (s != "false")) {
+          wentgood = false;
+          std::cerr << "\tOption 'Road.flatten' invalid; must be 'true' or 'false'.\n";
+        }
+      }
+      if (n["Road"]["max_outlier_fraction"]) {
+        float s = n["Road"]["max_outlier_fraction"].as<float>();
+        if (!((s >= 0.0) && (s <= 1.0))) {
+          wentgood = false;
+          std::cerr << "\tOption 'Road.max_outlier_fraction' invalid; must be float between 0.0 and 1.0.\n";
+        }
+      }
+      if (n["Road"]["use_LAS_classes"]) {
+        YAML::Node tmp = n["Road"]["use_LAS_classes"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Road.use_LAS_classes' invalid; must be an integer.\n";
+          }
+        }
+      }
+      if (n["Road"]["use_LAS_classes_within"]) {
+        YAML::Node tmp = n["Road"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Road.use_LAS_classes_within' invalid; must be an integer.\n";
+          }
+        }
+      }
+    }
+    if (n["Separation"]) {
+      if (n["Separation"]["height"]) {
+        std::string s = n["Separation"]["height"].as<std::string>();
+        if ((s.substr(0, s.find_first_of("-")) != "percentile") ||
+          (is_string_integer(s.substr(s.find_first_of("-") + 1), 0, 100) == false)) {
+          wentgood = false;
+          std::cerr << "\tOption 'Separation.height' invalid; must be 'percentile-XX'.\n";
+        }
+      }
+      if (n["Separation"]["use_LAS_classes"]) {
+        YAML::Node tmp = n["Separation"]["use_LAS_classes"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Separation.use_LAS_classes' invalid; must be an integer.\n";
+          }
+        }
+      }
+      if (n["Separation"]["use_LAS_classes_within"]) {
+        YAML::Node tmp = n["Separation"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Separation.use_LAS_classes_within' invalid; must be an integer.\n";
+          }
+        }
+      }
+    }
+    if (n["Bridge/Overpass"]) {
+      if (n["Bridge/Overpass"]["height"]) {
+        std::string s = n["Bridge/Overpass"]["height"].as<std::string>();
+        if ((s.substr(0, s.find_first_of("-")) != "percentile") ||
+          (is_string_integer(s.substr(s.find_first_of("-") + 1), 0, 100) == false)) {
+          wentgood = false;
+          std::cerr << "\tOption 'Bridge/Overpass.height' invalid; must be 'percentile-XX'.\n";
+        }
+      }
+      if (n["Bridge/Overpass"]["use_LAS_classes"]) {
+        YAML::Node tmp = n["Bridge/Overpass"]["use_LAS_classes"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Bridge/Overpass.use_LAS_classes' invalid; must be an integer.\n";
+          }
+        }
+      }
+      if (n["Bridge/Overpass"]["use_LAS_classes_within"]) {
+        YAML::Node tmp = n["Bridge/Overpass"]["use_LAS_classes_within"];
+        for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+          if (is_string_integer(it2->as<std::string>()) == false) {
+            wentgood = false;
+            std::cerr << "\tOption 'Bridge/Overpass.use_LAS_classes_within' invalid; must be an integer.\n";
+          }
+        }
+      }
+      if (n["Bridge/Overpass"]["flatten"]) {
+        std::string s = n["Bridge/Overpass"]["flatten"].as<std::string>();
+        if ((s != "true") && (s != "false")) {
+          wentgood = false;
+          std::cerr << "\tOption 'Bridge/Overpass.flatten' invalid; must be 'true' or 'false'.\n";
+        }
+      }
+      if (n["Bridge/Overpass"]["max_outlier_fraction"]) {
+        float s = n["Bridge/Overpass"]["max_outlier_fraction"].as<float>();
+        if (!((s >= 0.0) && (s <= 1.0))) {
+          wentgood = false;
+          std::cerr << "\tOption 'Bridge/Overpass.max_outlier_fraction' invalid; must be float between 0.0 and 1.0.\n";
+        }
+      }
+    }
+  }
+
+  //-- 3. input_elevation
+  if (nodes["input_elevation"]) {
+    YAML::Node n = nodes["input_elevation"];
+    for (auto it = n.begin(); it != n.end(); ++it) {
+      YAML::Node tmp = (*it)["omit_LAS_classes"];
+      for (auto it2 = tmp.begin(); it2 != tmp.end(); ++it2) {
+        if (is_string_integer(it2->as<std::string>()) == false) {
+          wentgood = false;
+          std::cerr << "\tOption 'input_elevation.omit_LAS_class' invalid; must be an integer.\n";
+        }
+      }
+      if ((*it)["thinning"]) {
+        if (is_string_integer((*it)["thinning"].as<std::string>()) == false) {
+          wentgood = false;
+          std::cerr << "\tOption 'input_elevation.thinning' invalid; must be an integer.\n";
+        }
+      }
+    }
+  }
+  else {
+    std::cerr << "Group 'input_elevation' not defined. \n";
+    wentgood = false;
+  }
+
+  //-- 4. options  
+  if (nodes["options"]) {
+    YAML::Node n = nodes["options"];
+    if (n["radius_vertex_elevation"]) {
+      try {
+        boost::lexical_cast<float>(n["radius_vertex_elevation"].as<std::string>());
+      }
+      catch (boost::bad_lexical_cast& e) {
+        wentgood = false;
+        std::cerr << "\tOption 'options.radius_vertex_elevation' invalid.\n";
+      }
+    }   
+    if (n["building_radius_vertex_elevation"]) {
+      try {
+        boost::lexical_cast<float>(n["building_radius_vertex_elevation"].as<std::string>());
+      }
+      catch (boost::bad_lexical_cast& e) {
+        wentgood = false;
+        std::cerr << "\tOption 'options.building_radius_vertex_elevation' invalid.\n";
+      }
+    }
+    if (n["threshold_jump_edges"]) {
+      try {
+        boost::lexical_cast<float>(n["threshold_jump_edges"].as<std::string>());
+      }
+      catch (boost::bad_lexical_cast& e) {
+        wentgood = false;
+        std::cerr << "\tOption 'options.threshold_jump_edges' invalid.\n";
+      }
+    }
+    if (n["threshold_bridge_jump_edges"]) {
+      try {
+        boost::lexical_cast<float>(n["threshold_bridge_jump_edges"].as<std::string>());
+      }
+      catch (boost::bad_lexical_cast& e) {
+        wentgood = false;
+        std::cerr << "\tOption 'options.threshold_bridge_jump_edges' invalid.\n";
+      }
+    }
+    if (n["stitching"]) {
+      std::string s = n["stitching"].as<std::string>();
+      if ((s != "true") && (s != "false")) {
+        wentgood = false;
+        std::cerr << "\tOption 'options.stitching' invalid; must be 'true' or 'false'.\n";
+      }
+    }
+    if (n["max_angle_curvepolygon"]) {
+      try {
+        boost::lexical_cast<double>(n["max_angle_curvepolygon"].as<std::string>());
+      }
+      catch (boost::bad_lexical_cast& e) {
+        wentgood = false;
+        std::cerr << "\tOption 'options.max_angle_curvepolygon' invalid.\n";
+      }
+    }
+    if (n["single_tin"]) {
+      std::string s = n["single_tin"].as<std::string>();
+      if ((s != "true") && (s != "false")) {
+        wentgood = false;
+        std::cerr << "\tOption 'options.single_tin' invalid; must be 'true' or 'false'.\n";
+      }
+    }
+    if (n["extent"]) {
+      std::vector<std::string> extent_split = stringsplit(n["extent"].as<std::string>(), ',');
+      double xmin, xmax, ymin, ymax;
+      bool correct = true;
+      try {
+        xmin = boost::lexical_cast<double>(extent_split[0]);
+        ymin = boost::lexical_cast<double>(extent_split[1]);
+        xmax = boost::lexical_cast<double>(extent_split[2]);
+        ymax = boost::lexical_cast<double>(extent_split[3]);
+      }
+      catch (boost::bad_lexical_cast& e) {
+        correct = false;
+        wentgood = false;
+      }
+      if (!correct || xmin > xmax || ymin > ymax || boost::geometry::area(Box2(Point2(xmin, ymin), Point2(xmax, ymax))) <= 0.0) {
+        std::cerr << "ERROR: The supplied extent is not valid: (" << n["extent"].as<std::string>() << ")\n";
+      }
+    }
+  }
+
+  //-- 5. output
+  if (nodes["output"]) {
+    YAML::Node n = nodes["output"];
+    if (n["gdal_driver"] && n["gdal_driver"].as<std::string>().empty()) {
+      wentgood = false;
+      std::cerr << "\tOutput format GDAL needs gdal_driver setting\n";
+    }
+  }
+
+  return wentgood;
+}
+
+//-- a number of bytes with an optional K, M or G suffix, 0 when not valid
+static unsigned long long parse_bytes(const std::string& size) {
+  char* end;
+  double value = std::strtod(size.c_str(), &end);
+  if (end == size.c_str() || value <= 0)
+    return 0;
+  std::string suffix(end);
+  for (auto& c : suffix)
+    c = std::toupper(c);
+  if (suffix == "K" || suffix == "KB")
+    value *= 1024.0;
+  else if (suffix == "M" || suffix == "MB")
+    value *= 1024.0 * 1024.0;
+  else if (suffix == "G" || suffix == "GB")
+    value *= 1024.0 * 1024.0 * 1024.0;
+  else if (suffix != "" && suffix != "B")
+    return 0;
+  return (unsigned long long)value;
+}
+
+//-- the size of the files written and the speed, with the size before compression if compressed
+static void print_written(unsigned long long bytes, unsigned long long uncompressed, double seconds) {
+  if (bytes != uncompressed)
+    printf("\t(%.1f MB written at %.1f MB/s, %.1f MB uncompressed)\n", bytes / 1e6, seconds > 0 ? bytes / 1e6 / seconds : 0.0, uncompressed / 1e6);
+  else
+    printf("\t(%.1f MB written at %.1f MB/s)\n", bytes / 1e6, seconds > 0 ? bytes / 1e6 / seconds : 0.0);
+}
+
+//-- the ids in a text file, one per line
+static bool read_ids(const std::string& filename, std::set<std::string>& ids) {
+  std::ifstream in(filename);
+  if (!in) {
+    std::cerr << "ERROR: cannot open file " << filename << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line)) {
+    line.erase(line.find_last_not_of(" \t\r") + 1);
+    line.erase(0, line.find_first_not_of(" \t"));
+    if (line != "")
+      ids.insert(line);
+  }
+  return true;
+}
@@ -0,0 +1,126 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "definitions.h"
+#include "Map3d.h"
+#include "TextWriter.h"
+#include "yaml-cpp/yaml.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * settings of a run that are not kept in the Map3d: the datasets, whether
+ * to stitch and the driver of the GDAL output
+ * read_config() fills it from the YAML config, a program that links lib3dfier
+ * can fill it itself and set the lifting options with the setters of Map3d
+ */
+struct Config {
+  std::vector<PolygonFile>  polygonFiles;
+  std::vector<PointFile>    pointFiles;
+  bool                      stitching = true;
+  std::string               gdalDriver;
+};
+
+/**
+ * the options of the command line (see main.cpp), checked by Pipeline::validate()
+ * and carried out by Pipeline::run()
+ */
+struct RunOptions {
+  std::string                         yaml;
+  std::map<std::string, std::string>  outputs; //-- format -> file, folder or connection string, "" if not written
+  std::string                         metrics;
+  std::string                         profile;
+  int                                 profiletop = 100;
+  std::string                         progress;
+  std::string                         maxmemory;
+  std::string                         savestate;
+  std::string                         update;
+  std::string                         changed;
+  bool                                server = false;
+};
+
+/**
+ * the stages of 3dfier, for the command line and for programs that link
+ * lib3dfier, called in this order:
+ *   read_config(), or get_config() and get_map3d() to set it up by hand
+ *   load_polygons() and index(), and select() to 3dfy only a part of them or
+ *   read_state() to 3dfy only the features changed since a previous run
+ *   add_point_files() and/or add_points() for batches of points held in memory
+ *   lift(), stitch() and triangulate(), write_state() for a next run, then cleanup()
+ *   write() for each output, to a file or to a callback
+ * each stage prints an ERROR and returns false when the run cannot go on
+ * run() calls them for the options of the command line
+ */
+class Pipeline {
+public:
+  Pipeline();
+
+  static void set_locale();
+  static bool validate(const RunOptions& options);
+  int     run(const RunOptions& options);
+
+  bool    read_config(const std::string& filename);
+  bool    read_config(const YAML::Node& nodes, const std::string& basedir);
+  Config& get_config();
+  Map3d&  get_map3d();
+
+  bool    load_polygons();
+  bool    index();
+  unsigned long select(const Box2& extent);
+  bool    read_state(const std::string& filename, const std::set<std::string>& changed);
+  bool    write_state(const std::string& filename);
+  bool    add_point_files();
+  unsigned long add_points(const PointBatch& points);
+  bool    lift();
+  bool    stitch();
+  bool    triangulate();
+  void    cleanup();
+  bool    write(const std::map<std::string, std::string>& outputs);
+  bool    write(const std::string& format, const std::string& filename);
+  bool    write(const std::string& format, const TextWriter::Sink& sink);
+
+  static const std::vector<std::string>& get_formats();
+  static bool is_format(const std::string& format);
+  static bool is_stream_format(const std::string& format);
+  static const std::vector<std::string>& get_stream_formats();
+
+private:
+  Config  _config;
+  Map3d   _map3d;
+  bool    _update = false; //-- read_state() was called, cleanup() selects all the features again
+
+  bool    write_output(const std::string& format, const std::string& ofname, TextWriter& of);
+  bool    write_reports(const RunOptions& options);
+};
+
+#endif
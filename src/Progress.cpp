@@ -0,0 +1,158 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "Progress.h"
+#include "io.h"
+#include "nlohmann-json/json.hpp"
+#include <cstdlib>
+#include <iostream>
+
+Progress::Progress() {
+  _running = false;
+  _total = 0;
+  _done = 0;
+  _step = 1;
+  _json = NULL;
+}
+
+Progress::~Progress() {
+  if (_json != NULL)
+    fclose(_json);
+}
+
+/**
+ * also write the progress as JSON lines, to a file or to an open file
+ * descriptor given as "fd:3"; the descriptor is then closed at the end
+ */
+bool Progress::set_json_output(const std::string& target) {
+  if (target.compare(0, 3, "fd:") == 0) {
+#ifdef _WIN32
+    _json = _fdopen(std::atoi(target.c_str() + 3), "w");
+#else
+    _json = fdopen(std::atoi(target.c_str() + 3), "w");
+#endif
+  }
+  else {
+    _json = fopen(target.c_str(), "w");
+  }
+  if (_json == NULL) {
+    std::cerr << "ERROR: cannot write the progress to " << target << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * start a stage of total items, 0 if the total is not known (yet)
+ */
+void Progress::start(const std::string& stage, unsigned long long total) {
+  if (_running)
+    finish();
+  std::lock_guard<std::mutex> lock(_mutex);
+  _stage = stage;
+  _running = true;
+  _done = 0;
+  set_total(total);
+  _start = boost::chrono::steady_clock::now();
+  _last = _start;
+  report(false);
+}
+
+void Progress::set_total(unsigned long long total) {
+  _total = total;
+  //-- a report is considered every 0.1% of the items, or every 4096 items if the total is unknown
+  _step = (total > 0) ? std::max(1ULL, total / 1000) : 4096;
+}
+
+void Progress::add(unsigned long long items) {
+  unsigned long long done = (_done += items);
+  unsigned long long step = _step;
+  if ((done - items) / step != done / step) {
+    std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+    if (lock.owns_lock() && _running)
+      report(false);
+  }
+}
+
+void Progress::finish() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_running == false)
+    return;
+  report(true);
+  _running = false;
+}
+
+/**
+ * called with _mutex held
+ */
+void Progress::report(bool finished) {
+  auto now = boost::chrono::steady_clock::now();
+  double sincelast = boost::chrono::duration<double>(now - _last).count();
+  if (!finished && _done > 0 && sincelast < 0.5)
+    return;
+  _last = now;
+  unsigned long long done = _done;
+  unsigned long long total = _total;
+  if (finished && total > 0)
+    done = total;
+  double elapsed = boost::chrono::duration<double>(now - _start).count();
+  double rate = (elapsed > 0) ? done / elapsed : 0;
+  double eta = -1;
+  if (total > 0 && rate > 0)
+    eta = (total > done) ? (total - done) / rate : 0;
+
+  std::string info = std::to_string((unsigned long long)rate) + " items/s";
+  if (eta >= 0 && !finished) {
+    char buf[32];
+    int s = (int)eta;
+    snprintf(buf, sizeof(buf), "  ETA %02d:%02d:%02d", s / 3600, (s / 60) % 60, s % 60);
+    info += buf;
+  }
+  if (total > 0)
+    printProgressBar((int)(100 * std::min(1.0, done / double(total))), info);
+  else
+    std::clog << "\r" << done << " items  " << info << "     " << std::flush;
+  if (finished)
+    std::clog << std::endl;
+
+  if (_json != NULL) {
+    nlohmann::json j;
+    j["stage"] = _stage;
+    j["done"] = done;
+    j["total"] = total;
+    if (total > 0)
+      j["percent"] = 100 * std::min(1.0, done / double(total));
+    j["items_per_second"] = rate;
+    j["elapsed_seconds"] = elapsed;
+    if (eta >= 0)
+      j["eta_seconds"] = eta;
+    j["finished"] = finished;
+    fprintf(_json, "%s\n", j.dump().c_str());
+    fflush(_json);
+  }
+}
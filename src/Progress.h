@@ -0,0 +1,70 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include "boost/chrono.hpp"
+
+/**
+ * progress of the stage that is running: percent done, items per second and
+ * the time left, as a bar on std::clog and, with --progress-json, as JSON
+ * lines for an orchestration to follow
+ * add() can be called from several threads, one of them then reports, at most
+ * every half second
+ */
+class Progress {
+public:
+  Progress();
+  ~Progress();
+
+  void  start(const std::string& stage, unsigned long long total = 0);
+  void  set_total(unsigned long long total);
+  void  add(unsigned long long items = 1);
+  void  finish();
+  bool  set_json_output(const std::string& target);
+
+private:
+  void  report(bool finished);
+
+  std::string                       _stage;
+  bool                              _running;
+  std::atomic<unsigned long long>   _total;
+  std::atomic<unsigned long long>   _done;
+  std::atomic<unsigned long long>   _step;
+  boost::chrono::time_point<boost::chrono::steady_clock> _start;
+  boost::chrono::time_point<boost::chrono::steady_clock> _last;
+  std::mutex                        _mutex;
+  FILE*                             _json;
+};
+
+#endif
@@ -80,7 +80,7 @@ void Road::get_cityjson(nlohmann::json& j, std::unordered_map<std::string,unsign
   j["CityObjects"][this->get_id()] = f;
 }
 
-void Road::get_citygml(std::wostream& of) {
+void Road::get_citygml(TextWriter& of) {
   of << "<cityObjectMember>";
   of << "<tra:Road gml:id=\"" << this->get_id() << "\">";
   get_citygml_attributes(of, _attributes);
@@ -96,7 +96,7 @@ void Road::get_citygml(std::wostream& of) {
   of << "</cityObjectMember>";
 }
 
-void Road::get_citygml_imgeo(std::wostream& of) {
+void Road::get_citygml_imgeo(TextWriter& of) {
   bool auxiliary = _layername == "auxiliarytrafficarea";
   bool spoor = _layername == "spoor";
   of << "<cityObjectMember>";
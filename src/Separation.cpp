@@ -72,7 +72,7 @@ void Separation::get_cityjson(nlohmann::json& j, std::unordered_map<std::string,
   j["CityObjects"][this->get_id()] = f;
 }
 
-void Separation::get_citygml(std::wostream& of) {
+void Separation::get_citygml(TextWriter& of) {
   of << "<cityObjectMember>";
   of << "<gen:GenericCityObject gml:id=\"" << this->get_id() << "\">";
   get_citygml_attributes(of, _attributes);
@@ -88,7 +88,7 @@ void Separation::get_citygml(std::wostream& of) {
   of << "</cityObjectMember>";
 }
 
-void Separation::get_citygml_imgeo(std::wostream& of) {
+void Separation::get_citygml_imgeo(TextWriter& of) {
   bool kunstwerkdeel = _layername == "kunstwerkdeel";
   bool overigbouwwerk = _layername == "overigbouwwerk";
   of << "<cityObjectMember>";
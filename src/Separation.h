@@ -37,8 +37,8 @@ public:
   Separation(char *wkt, std::string layername, AttributeMap attributes, std::string pid, float heightref);
   bool        lift();
   bool        add_elevation_point(Point2 &p, double z, float radius, int lasclass, bool within);
-  void        get_citygml(std::wostream& of);
-  void        get_citygml_imgeo(std::wostream& of);
+  void        get_citygml(TextWriter& of);
+  void        get_citygml_imgeo(TextWriter& of);
   void        get_cityjson(nlohmann::json& j, std::unordered_map<std::string,unsigned long> &dPts);
   std::string get_mtl();
   bool        get_shape(OGRLayer* layer, bool writeAttributes, const AttributeMap& extraAttributes = AttributeMap());
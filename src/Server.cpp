@@ -0,0 +1,162 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "Server.h"
+#include "boost/chrono.hpp"
+#include <cstdlib>
+#include <iostream>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+Server::Server(Pipeline& pipeline) : _pipeline(pipeline) {}
+
+/**
+ * the replies go to stdout, everything else 3dfier writes there (the
+ * durations, the messages of the libraries) is sent to stderr instead
+ */
+static std::FILE* take_stdout() {
+  std::fflush(stdout);
+#ifdef _WIN32
+  int fd = _dup(_fileno(stdout));
+  _dup2(_fileno(stderr), _fileno(stdout));
+  _setmode(fd, _O_BINARY);
+  return _fdopen(fd, "wb");
+#else
+  int fd = dup(fileno(stdout));
+  dup2(fileno(stderr), fileno(stdout));
+  return fdopen(fd, "wb");
+#endif
+}
+
+/**
+ * answer the requests on in until it ends
+ */
+int Server::run(std::istream& in) {
+  std::FILE* out = take_stdout();
+  if (out == NULL) {
+    std::cerr << "ERROR: cannot write the replies of the server to stdout.\n";
+    return EXIT_FAILURE;
+  }
+  std::clog << "Server ready, waiting for requests on stdin\n";
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+    nlohmann::json request;
+    nlohmann::json reply;
+    std::string output;
+    try {
+      request = nlohmann::json::parse(line);
+    }
+    catch (const std::exception& e) {
+      reply["status"] = "error";
+      reply["message"] = std::string("invalid JSON: ") + e.what();
+    }
+    if (request.is_object() && request.value("command", "") == "quit")
+      break;
+    if (request.is_object()) {
+      if (request.count("id") > 0)
+        reply["id"] = request["id"];
+      auto start = boost::chrono::steady_clock::now();
+      if (handle(request, output, reply)) {
+        reply["status"] = "ok";
+        reply["bytes"] = output.size();
+        reply["seconds"] = boost::chrono::duration<double>(boost::chrono::steady_clock::now() - start).count();
+      }
+      else {
+        reply["status"] = "error";
+        output.clear();
+      }
+    }
+    else if (reply.count("status") == 0) {
+      reply["status"] = "error";
+      reply["message"] = "a request must be a JSON object";
+    }
+    std::string header = reply.dump() + "\n";
+    std::fwrite(header.data(), 1, header.size(), out);
+    std::fwrite(output.data(), 1, output.size(), out);
+    std::fflush(out);
+  }
+  std::fclose(out);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * 3dfy the extent of request and write it in output, or set the message of
+ * reply and return false
+ */
+bool Server::handle(const nlohmann::json& request, std::string& output, nlohmann::json& reply) {
+  if (request.count("extent") == 0 || request["extent"].is_array() == false || request["extent"].size() != 4) {
+    reply["message"] = "extent must be [xmin, ymin, xmax, ymax]";
+    return false;
+  }
+  double e[4];
+  for (int i = 0; i < 4; i++) {
+    if (request["extent"][i].is_number() == false) {
+      reply["message"] = "extent must be [xmin, ymin, xmax, ymax]";
+      return false;
+    }
+    e[i] = request["extent"][i].get<double>();
+  }
+  if (e[0] >= e[2] || e[1] >= e[3]) {
+    reply["message"] = "extent is empty";
+    return false;
+  }
+  std::string format = request.value("format", "CityJSON");
+  if (Pipeline::is_stream_format(format) == false) {
+    reply["message"] = "format " + format + " cannot be written to a stream";
+    return false;
+  }
+  Config& config = _pipeline.get_config();
+  bool stitching = config.stitching;
+  if (request.count("stitching") > 0 && request["stitching"].is_boolean())
+    config.stitching = request["stitching"].get<bool>();
+
+  std::clog << "Request for " << format << " of (" << e[0] << ", " << e[1] << ") (" << e[2] << ", " << e[3] << ")\n";
+  unsigned long n = _pipeline.select(Box2(Point2(e[0], e[1]), Point2(e[2], e[3])));
+  reply["features"] = n;
+  bool done = true;
+  if (n > 0) {
+    done = _pipeline.add_point_files() && _pipeline.lift() && _pipeline.stitch() && _pipeline.triangulate();
+    _pipeline.cleanup();
+  }
+  config.stitching = stitching;
+  if (done == false) {
+    reply["message"] = "3dfying failed, see the log of the server";
+    return false;
+  }
+  if (_pipeline.write(format, [&output](const char* s, std::size_t size) { output.append(s, size); }) == false) {
+    reply["message"] = "writing " + format + " failed, see the log of the server";
+    return false;
+  }
+  return true;
+}
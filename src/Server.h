@@ -0,0 +1,61 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "Pipeline.h"
+#include "nlohmann-json/json.hpp"
+#include <cstdio>
+#include <istream>
+#include <string>
+
+/**
+ * 3dfies extents of polygons that are read and indexed once, for many small
+ * requests on the same datasets (see --server)
+ * a request is a JSON line on the input:
+ *   {"id": 1, "extent": [xmin, ymin, xmax, ymax], "format": "CityJSON", "stitching": true}
+ * the reply is a JSON line with the status and the number of bytes of the
+ * output, followed by these bytes:
+ *   {"id": 1, "status": "ok", "features": 120, "bytes": 81234, "seconds": 0.8}
+ *   {"id": 1, "status": "error", "message": "..."}
+ * the server stops at the end of the input or with {"command": "quit"}
+ */
+class Server {
+public:
+  Server(Pipeline& pipeline);
+
+  int   run(std::istream& in);
+
+private:
+  Pipeline&   _pipeline;
+
+  bool  handle(const nlohmann::json& request, std::string& output, nlohmann::json& reply);
+};
+
+#endif
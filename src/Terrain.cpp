@@ -68,7 +68,7 @@ void Terrain::get_cityjson(nlohmann::json& j, std::unordered_map<std::string,uns
   j["CityObjects"][this->get_id()] = f;
 }
 
-void Terrain::get_citygml(std::wostream& of) {
+void Terrain::get_citygml(TextWriter& of) {
   of << "<cityObjectMember>";
   of << "<lu:LandUse gml:id=\"" << this->get_id() << "\">";
   get_citygml_attributes(of, _attributes);
@@ -84,7 +84,7 @@ void Terrain::get_citygml(std::wostream& of) {
   of << "</cityObjectMember>";
 }
 
-void Terrain::get_citygml_imgeo(std::wostream& of) {
+void Terrain::get_citygml_imgeo(TextWriter& of) {
   of << "<cityObjectMember>";
   of << "<imgeo:OnbegroeidTerreindeel gml:id=\"" << this->get_id() << "\">";
   get_imgeo_attributes(of, this->get_id());
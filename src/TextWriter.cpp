@@ -0,0 +1,365 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "TextWriter.h"
+#include <cmath>
+#include <sstream>
+#include <thread>
+#include <iostream>
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
+static const std::size_t BUFFERSIZE = 1 << 20; //-- written to the file when this size is reached
+
+TextWriter::TextWriter() : _file(nullptr), _compression(NONE), _stream(nullptr), _fixed(false), _precision(6), _written(0), _uncompressed(0) {}
+
+TextWriter::~TextWriter() {
+  close();
+}
+
+static bool ends_with(const std::string& s, const std::string& suffix) {
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**
+ * remove .gz or .zst from the end of filename and return it, for the
+ * outputs that add the layer name and extension to a prefix
+ */
+std::string TextWriter::split_compression_suffix(std::string& filename) {
+  for (auto suffix : { ".gz", ".zst" }) {
+    if (ends_with(filename, suffix)) {
+      filename.resize(filename.size() - std::string(suffix).size());
+      return suffix;
+    }
+  }
+  return "";
+}
+
+bool TextWriter::open(const std::string& filename) {
+  close();
+  _compression = NONE;
+  if (ends_with(filename, ".gz")) {
+#ifdef WITH_ZLIB
+    z_stream* zs = new z_stream();
+    if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      delete zs;
+      std::cerr << "ERROR: cannot initialise gzip compression for " << filename << std::endl;
+      return false;
+    }
+    _stream = zs;
+    _compression = GZIP;
+#else
+    std::cerr << "ERROR: 3dfier is built without zlib, cannot write " << filename << std::endl;
+    return false;
+#endif
+  }
+  else if (ends_with(filename, ".zst")) {
+#ifdef WITH_ZSTD
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 3);
+    //-- fails silently when libzstd is built without multithreading
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, int(std::thread::hardware_concurrency()));
+    _stream = cctx;
+    _compression = ZSTD;
+#else
+    std::cerr << "ERROR: 3dfier is built without zstd, cannot write " << filename << std::endl;
+    return false;
+#endif
+  }
+  _file = std::fopen(filename.c_str(), "wb");
+  _buffer.reserve(BUFFERSIZE + 4096);
+  return _file != nullptr;
+}
+
+/**
+ * give the bytes to sink instead of writing a file, uncompressed
+ */
+bool TextWriter::open(const Sink& sink) {
+  close();
+  _sink = sink;
+  _buffer.reserve(BUFFERSIZE + 4096);
+  return bool(_sink);
+}
+
+void TextWriter::close() {
+  if (_sink) {
+    flush();
+    _sink = nullptr;
+  }
+  if (_file != nullptr) {
+    flush();
+    if (_compression != NONE)
+      write_compressed(true);
+    std::fclose(_file);
+    _file = nullptr;
+  }
+#ifdef WITH_ZLIB
+  if (_compression == GZIP) {
+    deflateEnd(static_cast<z_stream*>(_stream));
+    delete static_cast<z_stream*>(_stream);
+  }
+#endif
+#ifdef WITH_ZSTD
+  if (_compression == ZSTD) {
+    ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(_stream));
+  }
+#endif
+  _stream = nullptr;
+  _compression = NONE;
+}
+
+bool TextWriter::is_open() const {
+  return _file != nullptr || bool(_sink);
+}
+
+void TextWriter::flush() {
+  if (is_open() && !_buffer.empty()) {
+    if (_compression != NONE)
+      write_compressed(false);
+    else
+      write_out(_buffer.data(), _buffer.size());
+    _buffer.clear();
+  }
+}
+
+void TextWriter::write_out(const char* s, std::size_t n) {
+  _written += n;
+  if (_sink)
+    _sink(s, n);
+  else
+    std::fwrite(s, 1, n, _file);
+}
+
+/**
+ * compress the buffer to the file, and finish the stream if end
+ */
+void TextWriter::write_compressed(bool end) {
+  _compressed.resize(BUFFERSIZE);
+#ifdef WITH_ZLIB
+  if (_compression == GZIP) {
+    z_stream* zs = static_cast<z_stream*>(_stream);
+    zs->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(_buffer.data()));
+    zs->avail_in = uInt(_buffer.size());
+    int ret;
+    do {
+      zs->next_out = reinterpret_cast<Bytef*>(&_compressed[0]);
+      zs->avail_out = uInt(_compressed.size());
+      ret = deflate(zs, end ? Z_FINISH : Z_NO_FLUSH);
+      write_out(_compressed.data(), _compressed.size() - zs->avail_out);
+    } while (zs->avail_out == 0 || (end && ret != Z_STREAM_END && ret != Z_STREAM_ERROR));
+  }
+#endif
+#ifdef WITH_ZSTD
+  if (_compression == ZSTD) {
+    ZSTD_inBuffer in = { _buffer.data(), _buffer.size(), 0 };
+    std::size_t remaining;
+    do {
+      ZSTD_outBuffer out = { &_compressed[0], _compressed.size(), 0 };
+      remaining = ZSTD_compressStream2(static_cast<ZSTD_CCtx*>(_stream), &out, &in, end ? ZSTD_e_end : ZSTD_e_continue);
+      if (ZSTD_isError(remaining)) {
+        std::cerr << "ERROR: zstd compression failed: " << ZSTD_getErrorName(remaining) << std::endl;
+        break;
+      }
+      write_out(_compressed.data(), out.pos);
+    } while (end ? remaining != 0 : in.pos < in.size);
+  }
+#endif
+}
+
+void TextWriter::write(const char* s, std::size_t n) {
+  _buffer.append(s, n);
+  _uncompressed += n;
+  if (_buffer.size() >= BUFFERSIZE && is_open())
+    flush();
+}
+
+/**
+ * content of a writer without file
+ */
+std::string& TextWriter::str() {
+  return _buffer;
+}
+
+void TextWriter::copyfmt(const TextWriter& other) {
+  _fixed = other._fixed;
+  _precision = other._precision;
+}
+
+/**
+ * bytes given to the file or sink so far, compressed for .gz and .zst files;
+ * all of them once the writer is closed
+ */
+unsigned long long TextWriter::bytes_written() const {
+  return _written;
+}
+
+unsigned long long TextWriter::bytes_uncompressed() const {
+  return _uncompressed;
+}
+
+TextWriter& TextWriter::operator<<(const char* s) {
+  write(s, std::char_traits<char>::length(s));
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(const std::string& s) {
+  write(s.data(), s.size());
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(char c) {
+  write(&c, 1);
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(int i) {
+  write_integer(i < 0 ? 0ULL - (unsigned long long)i : i, i < 0);
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(unsigned int i) {
+  write_integer(i, false);
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(long i) {
+  write_integer(i < 0 ? 0ULL - (unsigned long long)i : i, i < 0);
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(unsigned long i) {
+  write_integer(i, false);
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(long long i) {
+  write_integer(i < 0 ? 0ULL - (unsigned long long)i : i, i < 0);
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(unsigned long long i) {
+  write_integer(i, false);
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(float d) {
+  write_double(d);
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(double d) {
+  write_double(d);
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(decltype(std::setprecision(0)) p) {
+  //-- the value of setprecision is only accessible by applying it to a stream
+  static thread_local std::ostringstream ss;
+  ss << p;
+  _precision = int(ss.precision());
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(std::ios_base& (*manip)(std::ios_base&)) {
+  if (manip == static_cast<std::ios_base& (*)(std::ios_base&)>(std::fixed))
+    _fixed = true;
+  else if (manip == static_cast<std::ios_base& (*)(std::ios_base&)>(std::defaultfloat))
+    _fixed = false;
+  return *this;
+}
+
+TextWriter& TextWriter::operator<<(std::ostream& (*manip)(std::ostream&)) {
+  if (manip == static_cast<std::ostream& (*)(std::ostream&)>(std::endl))
+    write("\n", 1);
+  return *this;
+}
+
+void TextWriter::write_integer(unsigned long long i, bool negative) {
+  char buf[24];
+  char* p = buf + sizeof(buf);
+  do {
+    *--p = char('0' + i % 10);
+    i /= 10;
+  } while (i != 0);
+  if (negative)
+    *--p = '-';
+  write(p, buf + sizeof(buf) - p);
+}
+
+/**
+ * fixed notation is done with integer arithmetic on the value scaled by 10^precision,
+ * values that are too close to a rounding tie to be sure to round like printf
+ * (and other notations) fall back to snprintf
+ */
+void TextWriter::write_double(double d) {
+  static const double scales[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+  static const unsigned long long iscales[] = { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+    1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL };
+  char buf[64];
+  if (_fixed && _precision >= 0 && _precision <= 9 && std::isfinite(d)) {
+    double s = std::fabs(d) * scales[_precision];
+    if (s < 1e15) {
+      double fl = std::floor(s);
+      double frac = s - fl;
+      if (std::fabs(frac - 0.5) > s * 1e-15 + 1e-9) {
+        unsigned long long r = (unsigned long long)fl + (frac > 0.5 ? 1 : 0);
+        char* end = buf + sizeof(buf);
+        char* p = end;
+        if (_precision > 0) {
+          unsigned long long f = r % iscales[_precision];
+          r /= iscales[_precision];
+          for (int i = 0; i < _precision; i++) {
+            *--p = char('0' + f % 10);
+            f /= 10;
+          }
+          *--p = '.';
+        }
+        do {
+          *--p = char('0' + r % 10);
+          r /= 10;
+        } while (r != 0);
+        if (std::signbit(d))
+          *--p = '-';
+        write(p, end - p);
+        return;
+      }
+    }
+  }
+  int n = std::snprintf(buf, sizeof(buf), _fixed ? "%.*f" : "%.*g", _precision, d);
+  if (n >= 0 && n < int(sizeof(buf)))
+    write(buf, n);
+  else {
+    std::string big(n + 1, '\0');
+    std::snprintf(&big[0], big.size(), _fixed ? "%.*f" : "%.*g", _precision, d);
+    write(big.data(), n);
+  }
+}
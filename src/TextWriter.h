@@ -0,0 +1,104 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef TEXTWRITER_H
+#define TEXTWRITER_H
+
+#include <cstdio>
+#include <string>
+#include <iomanip>
+#include <ostream>
+#include <functional>
+
+/**
+ * narrow buffered writer for the text outputs (GML, OBJ, STL, CSV, CityJSON)
+ * bytes are collected in a buffer and written to the file when it is full,
+ * without a file everything is kept in memory (see str()), or given to a sink
+ * callback each time the buffer is full
+ * numbers are formatted without locale, doubles with the precision set with
+ * std::setprecision, in fixed notation after std::fixed like an ostream
+ * files ending with .gz or .zst are compressed while writing (if 3dfier is
+ * built with zlib and zstd, see WITH_ZLIB and WITH_ZSTD); bytes_written() is
+ * the size given to the file or sink, bytes_uncompressed() the size before
+ */
+class TextWriter {
+public:
+  TextWriter();
+  ~TextWriter();
+
+  typedef std::function<void(const char*, std::size_t)> Sink;
+
+  bool                open(const std::string& filename);
+  bool                open(const Sink& sink);
+  void                close();
+  bool                is_open() const;
+  void                flush();
+  void                write(const char* s, std::size_t n);
+  std::string&        str();
+  void                copyfmt(const TextWriter& other);
+  unsigned long long  bytes_written() const;
+  unsigned long long  bytes_uncompressed() const;
+
+  static std::string  split_compression_suffix(std::string& filename);
+
+  TextWriter& operator<<(const char* s);
+  TextWriter& operator<<(const std::string& s);
+  TextWriter& operator<<(char c);
+  TextWriter& operator<<(int i);
+  TextWriter& operator<<(unsigned int i);
+  TextWriter& operator<<(long i);
+  TextWriter& operator<<(unsigned long i);
+  TextWriter& operator<<(long long i);
+  TextWriter& operator<<(unsigned long long i);
+  TextWriter& operator<<(float d);
+  TextWriter& operator<<(double d);
+  TextWriter& operator<<(decltype(std::setprecision(0)) p);
+  TextWriter& operator<<(std::ios_base& (*manip)(std::ios_base&));
+  TextWriter& operator<<(std::ostream& (*manip)(std::ostream&));
+
+private:
+  enum Compression { NONE, GZIP, ZSTD };
+
+  std::FILE*          _file;
+  Sink                _sink;
+  Compression         _compression;
+  void*               _stream; //-- z_stream or ZSTD_CCtx
+  std::string         _compressed;
+  std::string         _buffer;
+  bool                _fixed;
+  int                 _precision;
+  unsigned long long  _written;
+  unsigned long long  _uncompressed;
+
+  void write_compressed(bool end);
+  void write_out(const char* s, std::size_t n);
+  void write_integer(unsigned long long i, bool negative);
+  void write_double(double d);
+};
+
+#endif
@@ -35,6 +35,7 @@
 
 #include "TopoFeature.h"
 #include <cstddef>
+#include <cstring>
 
 TopoFeature::TopoFeature(char *wkt, std::string layername, AttributeMap attributes, std::string pid) {
   _id = pid;
@@ -44,6 +45,7 @@ TopoFeature::TopoFeature(char *wkt, std::string layername, AttributeMap attribut
   bg::read_wkt(wkt, *_p2);
   bg::unique(*_p2); //-- remove duplicate vertices
   bg::correct(*_p2); //-- correct the orientation of the polygons!
+  _p2xy.build(*_p2);
 
   _adjFeatures = new std::vector<TopoFeature*>;
   _p2z.resize(bg::num_interior_rings(*_p2) + 1);
@@ -59,7 +61,8 @@ TopoFeature::TopoFeature(char *wkt, std::string layername, AttributeMap attribut
 }
 
 TopoFeature::~TopoFeature() {
-  // TODO: clear memory properly
+  delete _p2;
+  delete _adjFeatures;
 }
 
 Box2 TopoFeature::get_bbox2d() {
@@ -70,6 +73,38 @@ std::string TopoFeature::get_id() {
   return _id;
 }
 
+/**
+ * FNV-1a hash of the rings and coordinates of the polygon, to find the
+ * features whose geometry changed since the run that saved the state
+ */
+unsigned long long TopoFeature::get_geometry_hash() {
+  unsigned long long hash = 14695981039346656037ull;
+  auto add = [&hash](const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; i++) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+  };
+  std::vector<const Ring2*> rings;
+  rings.push_back(&_p2->outer());
+  for (auto& iring : _p2->inners())
+    rings.push_back(&iring);
+  for (auto ring : rings) {
+    uint64_t n = ring->size();
+    add(&n, sizeof(n));
+    for (auto& p : *ring) {
+      double xy[2] = { p.get<0>(), p.get<1>() };
+      add(xy, sizeof(xy));
+    }
+  }
+  return hash;
+}
+
+std::size_t TopoFeature::get_number_triangles() {
+  return _triangles.size() + _triangles_vw.size();
+}
+
 std::string  TopoFeature::get_layername() {
   return _layername;
 }
@@ -284,23 +319,18 @@ void TopoFeature::get_stl(std::unordered_map< std::string, unsigned long > &dPts
 }
 
 /* Access, calculate and output STL format for a feature */
-void TopoFeature::stl_prep(std::string pointsa, std::string pointsb, std::string pointsc, std::string &fs){
+void TopoFeature::stl_prep(const std::string& pointsa, const std::string& pointsb, const std::string& pointsc, std::string &fs){
     // take vertices that are written as string and turn them into float point vectors
-    std::vector<double> v1, v2, v3;
-    double num;
-    std::stringstream ss;
-
-    ss << pointsa;
-    while (ss >> num) v1.push_back(num);
-    ss.clear();
-
-    ss << pointsb;
-    while (ss >> num) v2.push_back(num);
-    ss.clear();
-
-    ss << pointsc;
-    while (ss >> num) v3.push_back(num);
-    ss.clear();
+    double v1[3], v2[3], v3[3];
+    const char* c1 = pointsa.c_str();
+    const char* c2 = pointsb.c_str();
+    const char* c3 = pointsc.c_str();
+    char* end;
+    for (int j = 0; j < 3; j++) {
+      v1[j] = strtod(c1, &end); c1 = end;
+      v2[j] = strtod(c2, &end); c2 = end;
+      v3[j] = strtod(c3, &end); c3 = end;
+    }
 
     // calculate face normals
     double vecU[3], vecV[3];
@@ -319,7 +349,9 @@ void TopoFeature::stl_prep(std::string pointsa, std::string pointsb, std::string
       nVec[j] /= nLen;
 
     // output feature
-    fs += "  facet normal "; fs += std::to_string(nVec[0]); fs += " "; fs += std::to_string(nVec[1]); fs+= " "; fs += std::to_string(nVec[2]); fs += "\n";
+    TextWriter normal;
+    normal << std::fixed << "  facet normal " << nVec[0] << " " << nVec[1] << " " << nVec[2] << "\n";
+    fs += normal.str();
     fs += "    outer loop"; fs += "\n";
     fs += "      "; fs += "vertex "; fs += pointsa; fs += "\n";
     fs += "      "; fs += "vertex "; fs += pointsb; fs += "\n";
@@ -328,11 +360,145 @@ void TopoFeature::stl_prep(std::string pointsa, std::string pointsb, std::string
     fs += "  endfacet"; fs += "\n";
 }
 
+/**
+ * binary STL records of the triangles of the feature, the same ones as get_stl()
+ * only counted when fs is NULL, returns the number of triangles
+ */
+unsigned long TopoFeature::get_stl_binary(const Point2& offset, std::string* fs) {
+  unsigned long count = 0;
+  for (auto& t : _triangles) {
+    if (_vertices[t.v0].second != _vertices[t.v1].second &&
+        _vertices[t.v0].second != _vertices[t.v2].second &&
+        _vertices[t.v1].second != _vertices[t.v2].second) {
+      if (fs != NULL)
+        stl_binary_prep(_vertices[t.v0].first, _vertices[t.v1].first, _vertices[t.v2].first, offset, *fs);
+      count++;
+    }
+  }
+  for (auto& t : _triangles_vw) {
+    if (_vertices_vw[t.v0].second != _vertices_vw[t.v1].second &&
+        _vertices_vw[t.v0].second != _vertices_vw[t.v2].second &&
+        _vertices_vw[t.v1].second != _vertices_vw[t.v2].second) {
+      if (fs != NULL)
+        stl_binary_prep(_vertices_vw[t.v0].first, _vertices_vw[t.v1].first, _vertices_vw[t.v2].first, offset, *fs);
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * append the 50-byte binary STL record of a triangle: normal, 3 vertices as
+ * little-endian float32 relative to offset, and the class in the attribute bytes
+ */
+void TopoFeature::stl_binary_prep(const Point3& pa, const Point3& pb, const Point3& pc, const Point2& offset, std::string& fs) {
+  double v[3][3] = {
+    { pa.get<0>() - offset.x(), pa.get<1>() - offset.y(), pa.get<2>() },
+    { pb.get<0>() - offset.x(), pb.get<1>() - offset.y(), pb.get<2>() },
+    { pc.get<0>() - offset.x(), pc.get<1>() - offset.y(), pc.get<2>() }
+  };
+  double vecU[3], vecV[3];
+  for (int j = 0; j < 3; j++) {
+    vecU[j] = v[1][j] - v[0][j];
+    vecV[j] = v[2][j] - v[0][j];
+  }
+  double nVec[3];
+  nVec[0] = vecU[1]*vecV[2] - vecU[2]*vecV[1];
+  nVec[1] = vecU[2]*vecV[0] - vecU[0]*vecV[2];
+  nVec[2] = vecU[0]*vecV[1] - vecU[1]*vecV[0];
+  double nLen = sqrt(nVec[0]*nVec[0] + nVec[1]*nVec[1] + nVec[2]*nVec[2]);
+
+  float record[12];
+  for (int j = 0; j < 3; j++) {
+    record[j] = float(nLen > 0 ? nVec[j] / nLen : 0.0);
+    record[3 + j] = float(v[0][j]);
+    record[6 + j] = float(v[1][j]);
+    record[9 + j] = float(v[2][j]);
+  }
+  unsigned short attribute = (unsigned short)this->get_class();
+  fs.append(reinterpret_cast<const char*>(record), sizeof(record));
+  fs.append(reinterpret_cast<const char*>(&attribute), sizeof(attribute));
+}
+
+/**
+ * the triangles of the feature as an indexed mesh, the same ones as get_stl()
+ */
+void TopoFeature::get_mesh(const Point3& centre, float featureid, Mesh& mesh) {
+  add_mesh_triangles(_vertices, _triangles, centre, featureid, mesh);
+  add_mesh_triangles(_vertices_vw, _triangles_vw, centre, featureid, mesh);
+}
+
+/**
+ * append vertices and triangles to mesh, at height z if given
+ * the vertices are relative to centre to keep them precise as float32
+ */
+void TopoFeature::add_mesh_triangles(const std::vector< std::pair<Point3, std::string> >& vertices, const std::vector<Triangle>& triangles, const Point3& centre, float featureid, Mesh& mesh, const float* z, bool reverse) {
+  if (triangles.empty())
+    return;
+  unsigned int base = (unsigned int)(mesh.positions.size() / 3);
+  mesh.positions.reserve(mesh.positions.size() + 3 * vertices.size());
+  for (auto& v : vertices) {
+    mesh.positions.push_back(float(v.first.get<0>() - centre.get<0>()));
+    mesh.positions.push_back(float(v.first.get<1>() - centre.get<1>()));
+    mesh.positions.push_back(float((z != NULL ? *z : v.first.get<2>()) - centre.get<2>()));
+  }
+  mesh.featureids.resize(mesh.featureids.size() + vertices.size(), featureid);
+  for (auto& t : triangles) {
+    if (z != NULL) {
+      std::pair<long long, long long> a = xy_mm(vertices[t.v0].first);
+      std::pair<long long, long long> b = xy_mm(vertices[t.v1].first);
+      std::pair<long long, long long> c = xy_mm(vertices[t.v2].first);
+      if ((a == b) || (a == c) || (b == c))
+        continue;
+    }
+    else if (vertices[t.v0].second == vertices[t.v1].second ||
+             vertices[t.v0].second == vertices[t.v2].second ||
+             vertices[t.v1].second == vertices[t.v2].second) {
+      continue;
+    }
+    mesh.indices.push_back(base + t.v0);
+    mesh.indices.push_back(base + (reverse ? t.v2 : t.v1));
+    mesh.indices.push_back(base + (reverse ? t.v1 : t.v2));
+  }
+}
+
+/**
+ * the triangles as little-endian WKB MultiPolygonZ, as EWKB with the SRID if srid > 0
+ * (PostGIS), otherwise with the ISO type codes
+ */
+void TopoFeature::get_wkb(std::string& wkb, int srid) {
+  wkb_begin_multipolygon(wkb, srid);
+  add_wkb_triangles(wkb, _vertices, _triangles, srid > 0);
+  add_wkb_triangles(wkb, _vertices_vw, _triangles_vw, srid > 0);
+}
+
+void TopoFeature::add_wkb_triangles(std::string& wkb, const std::vector< std::pair<Point3, std::string> >& vertices, const std::vector<Triangle>& triangles, bool ewkb, const float* z, bool reverse) {
+  const uint32_t polygontype = ewkb ? (3 | 0x80000000) : 1003;
+  const uint32_t rings = 1;
+  const uint32_t points = 4;
+  std::size_t offset = wkb.size();
+  wkb.resize(offset + triangles.size() * (1 + 3 * 4 + 4 * 3 * 8));
+  char* c = &wkb[offset];
+  for (auto& t : triangles) {
+    *c++ = 1;
+    std::memcpy(c, &polygontype, 4); c += 4;
+    std::memcpy(c, &rings, 4); c += 4;
+    std::memcpy(c, &points, 4); c += 4;
+    int ids[4] = { t.v0, reverse ? t.v2 : t.v1, reverse ? t.v1 : t.v2, t.v0 };
+    for (int i = 0; i < 4; i++) {
+      const Point3& p = vertices[ids[i]].first;
+      double xyz[3] = { p.get<0>(), p.get<1>(), z != NULL ? *z : p.get<2>() };
+      std::memcpy(c, xyz, 24); c += 24;
+    }
+  }
+  wkb_add_count(wkb, uint32_t(triangles.size()));
+}
+
 AttributeMap &TopoFeature::get_attributes() {
     return _attributes;
 }
 
-void TopoFeature::get_imgeo_attributes(std::wostream& of, std::string id) {
+void TopoFeature::get_imgeo_attributes(TextWriter& of, std::string id) {
     std::string attribute;
     if (get_attribute("creationDate", attribute)) {
         of << "<imgeo:creationDate>" << attribute << "</imgeo:creationDate>";
@@ -391,7 +557,7 @@ void TopoFeature::get_cityjson_attributes(nlohmann::json& f, const AttributeMap&
   }
 }
 
-void TopoFeature::get_citygml_attributes(std::wostream& of, const AttributeMap& attributes) {
+void TopoFeature::get_citygml_attributes(TextWriter& of, const AttributeMap& attributes) {
   for (auto& attribute : attributes) {
     // add attributes except gml_id
     if (attribute.first.compare("gml_id") != 0) {
@@ -419,76 +585,65 @@ void TopoFeature::get_citygml_attributes(std::wostream& of, const AttributeMap&
  * geometry contains polygon and vertical walls as triangles
  */
 bool TopoFeature::get_multipolygon_features(OGRLayer* layer, std::string className, bool writeAttributes, const AttributeMap& extraAttributes) {
-  OGRFeatureDefn *featureDefn = layer->GetLayerDefn();
-  OGRFeature *feature = OGRFeature::CreateFeature(featureDefn);
-  OGRMultiPolygon multipolygon = OGRMultiPolygon();
-  Point3 p;
-
-  //-- add all triangles to the layer
-  for (auto& t : _triangles) {
-    OGRPolygon polygon = OGRPolygon();
-    OGRLinearRing ring = OGRLinearRing();
-
-    p = _vertices[t.v0].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-    p = _vertices[t.v1].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-    p = _vertices[t.v2].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-
-    ring.closeRings();
-    polygon.addRing(&ring);
-    multipolygon.addGeometry(&polygon);
-  }
-
-  //-- add all vertical wall triangles to the layer
-  for (auto& t : _triangles_vw) {
-    OGRPolygon polygon = OGRPolygon();
-    OGRLinearRing ring = OGRLinearRing();
-
-    p = _vertices_vw[t.v0].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-    p = _vertices_vw[t.v1].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-    p = _vertices_vw[t.v2].first;
-    ring.addPoint(p.get<0>(), p.get<1>(), p.get<2>());
-
-    ring.closeRings();
-    polygon.addRing(&ring);
-    multipolygon.addGeometry(&polygon);
-  }
-
-  if (feature->SetGeometry(&multipolygon) != OGRERR_NONE) {
-    std::cerr << "Creating feature geometry failed.\n";
-    OGRFeature::DestroyFeature(feature);
+  OGRFeature *feature = this->get_ogr_feature(layer->GetLayerDefn(), className, writeAttributes, extraAttributes);
+  if (feature == NULL) {
     return false;
   }
-  if (!writeAttribute(feature, featureDefn, "3df_id", this->get_id())) {
-    return false;
-  }
-  if (!writeAttribute(feature, featureDefn, "3df_class", className)) {
+  if (layer->CreateFeature(feature) != OGRERR_NONE) {
+    std::cerr << "Failed to create feature " << this->get_id() << ".\n";
+    OGRFeature::DestroyFeature(feature);
     return false;
   }
-  if (writeAttributes) {
-    for (auto attr : _attributes) {
+  OGRFeature::DestroyFeature(feature);
+  return true;
+}
+
+/**
+ * the feature with its geometry and attributes, NULL on failure
+ * it is not added to a layer so features can be created in parallel
+ */
+OGRFeature* TopoFeature::get_ogr_feature(OGRFeatureDefn* featureDefn, std::string className, bool writeAttributes, const AttributeMap& extraAttributes) {
+  OGRFeature *feature = OGRFeature::CreateFeature(featureDefn);
+  bool success = set_geometry_wkb(feature) &&
+    writeAttribute(feature, featureDefn, "3df_id", this->get_id()) &&
+    writeAttribute(feature, featureDefn, "3df_class", className);
+  if (success && writeAttributes) {
+    for (auto& attr : _attributes) {
       if (!(attr.second.first == OFTDateTime && attr.second.second == "0000/00/00 00:00:00")) {
         if (!writeAttribute(feature, featureDefn, attr.first, attr.second.second)) {
-          return false;
+          success = false;
+          break;
         }
       }
     }
-    for (auto attr : extraAttributes) {
-      if (!writeAttribute(feature, featureDefn, attr.first, attr.second.second)) {
-        return false;
+    for (auto& attr : extraAttributes) {
+      if (success && !writeAttribute(feature, featureDefn, attr.first, attr.second.second)) {
+        success = false;
       }
     }
   }
-  if (layer->CreateFeature(feature) != OGRERR_NONE) {
-    std::cerr << "Failed to create feature " << this->get_id() << ".\n";
+  if (!success) {
     OGRFeature::DestroyFeature(feature);
+    return NULL;
+  }
+  return feature;
+}
+
+/**
+ * set the geometry of the feature from the WKB of get_wkb(), in a buffer reused
+ * between features; OGR still builds its MultiPolygon from it, but in one pass
+ * and it is handed to the feature without another copy
+ */
+bool TopoFeature::set_geometry_wkb(OGRFeature* feature) {
+  static thread_local std::string wkb;
+  wkb.clear();
+  this->get_wkb(wkb);
+  OGRGeometry* geometry = NULL;
+  if (OGRGeometryFactory::createFromWkb(reinterpret_cast<unsigned char*>(&wkb[0]), NULL, &geometry, wkb.size()) != OGRERR_NONE ||
+      feature->SetGeometryDirectly(geometry) != OGRERR_NONE) {
+    std::cerr << "Creating feature geometry failed.\n";
     return false;
   }
-  OGRFeature::DestroyFeature(feature);
   return true;
 }
 
@@ -988,21 +1143,15 @@ bool TopoFeature::assign_elevation_to_vertex(const Point2& p, double z, float ra
   double sqr_radius = radius * radius;
   int zcm = int(z * 100);
 
-  int ringi = 0;
-  Ring2& oring = _p2->outer();
-  for (int i = 0; i < oring.size(); i++) {
-    if (sqr_distance(p, oring[i]) <= sqr_radius)
-      _lidarelevs[ringi][i].push_back(zcm);
-  }
-  ringi++;
-  std::vector<Ring2>& irings = _p2->inners();
-  for (Ring2& iring : irings) {
-    for (int i = 0; i < iring.size(); i++) {
-      if (sqr_distance(p, iring[i]) <= sqr_radius) {
-        _lidarelevs[ringi][i].push_back(zcm);
-      }
+  static thread_local std::vector<int> hits;
+  for (int ringi = 0; ringi < _p2xy.num_rings(); ringi++) {
+    int n = _p2xy.ring_size(ringi);
+    if (hits.size() < n)
+      hits.resize(n);
+    int nhits = vertices_within_radius(p.x(), p.y(), _p2xy.ring_x(ringi), _p2xy.ring_y(ringi), n, sqr_radius, hits.data());
+    for (int i = 0; i < nhits; i++) {
+      _lidarelevs[ringi][hits[i]].push_back(zcm);
     }
-    ringi++;
   }
   return true;
 }
@@ -1019,56 +1168,31 @@ bool TopoFeature::within_range(const Point2& p, double radius) {
   }  
   
   double sqr_radius = radius * radius;
-  const Ring2& oring = _p2->outer();
   //-- point is within range of the polygon rings
-  for (int i = 0; i < oring.size(); i++) {
-    if (sqr_distance(p, oring[i]) <= sqr_radius) {
+  for (int ringi = 0; ringi < _p2xy.num_rings(); ringi++) {
+    if (any_vertex_within_radius(p.x(), p.y(), _p2xy.ring_x(ringi), _p2xy.ring_y(ringi), _p2xy.ring_size(ringi), sqr_radius)) {
       return true;
     }
   }
-  std::vector<Ring2>& irings = _p2->inners();
-  for (Ring2& iring : irings) {
-    for (int i = 0; i < iring.size(); i++) {
-      if (sqr_distance(p, iring[i]) <= sqr_radius) {
-        return true;
-      }
-    }
-  }
   return false;
 }
 
-// based on http://stackoverflow.com/questions/217578/how-can-i-determine-whether-a-2d-point-is-within-a-polygon/2922778#2922778
+/**
+ * point is inside the outer ring and outside all inner rings
+ * crossing test on the x/y arrays of the rings, see point_in_ring()
+ */
 bool TopoFeature::point_in_polygon(const Point2& p) {
   //test outer ring
-  const Ring2& oring = _p2->outer();
-  int nvert = oring.size();
-  int i, j = 0;
-  bool insideOuter = false;
-  for (i = 0, j = nvert - 1; i < nvert; j = i++) {
-    double py = p.y();
-    if (((oring[i].y()>py) != (oring[j].y()>py)) &&
-      (p.x() < (oring[j].x() - oring[i].x()) * (py - oring[i].y()) / (oring[j].y() - oring[i].y()) + oring[i].x()))
-      insideOuter = !insideOuter;
-  }
-  if (insideOuter) {
-    //test inner rings
-    auto irings = _p2->inners();
-    for (Ring2& iring : irings) {
-      bool insideInner = false;
-      int nvert = iring.size();
-      int i, j = 0;
-      for (i = 0, j = nvert - 1; i < nvert; j = i++) {
-        double py = p.y();
-        if (((iring[i].y() > py) != (iring[j].y() > py)) &&
-          (p.x() < (iring[j].x() - iring[i].x()) * (py - iring[i].y()) / (iring[j].y() - iring[i].y()) + iring[i].x()))
-          insideInner = !insideInner;
-      }
-      if (insideInner) {
-        return false;
-      }
+  if (!point_in_ring(p.x(), p.y(), _p2xy.ring_x(0), _p2xy.ring_y(0), _p2xy.ring_size(0))) {
+    return false;
+  }
+  //test inner rings
+  for (int ringi = 1; ringi < _p2xy.num_rings(); ringi++) {
+    if (point_in_ring(p.x(), p.y(), _p2xy.ring_x(ringi), _p2xy.ring_y(ringi), _p2xy.ring_size(ringi))) {
+      return false;
     }
   }
-  return insideOuter;
+  return true;
 }
 
 /**
@@ -1082,7 +1206,120 @@ void TopoFeature::cleanup_lidarelevs() {
   _p2z.shrink_to_fit();
 }
 
-void TopoFeature::get_triangle_as_gml_surfacemember(std::wostream& of, Triangle& t, bool verticalwall) {
+/**
+ * forget the elevations, heights, adjacent features and triangles of a
+ * previous 3dfying, to 3dfy the feature again (see Map3d::select_features())
+ */
+void TopoFeature::reset() {
+  _p2z.assign(bg::num_interior_rings(*_p2) + 1, std::vector<int>());
+  _p2z[0].resize(bg::num_points(_p2->outer()));
+  _lidarelevs.assign(bg::num_interior_rings(*_p2) + 1, std::vector< std::vector<int> >());
+  _lidarelevs[0].resize(bg::num_points(_p2->outer()));
+  for (int i = 0; i < bg::num_interior_rings(*_p2); i++) {
+    _p2z[i + 1].resize(bg::num_points(_p2->inners()[i]));
+    _lidarelevs[i + 1].resize(bg::num_points(_p2->inners()[i]));
+  }
+  _adjFeatures->clear();
+  _bVerticalWalls = false;
+  _vertices.clear();
+  _triangles.clear();
+  _vertices_vw.clear();
+  _triangles_vw.clear();
+}
+
+/**
+ * write the heights of the vertices, the triangles and the vertical walls
+ * after 3dfying, read_state() restores them without 3dfying again
+ */
+void TopoFeature::write_state(std::ostream& os) {
+  write_binary(os, _p2z);
+  write_binary(os, _bVerticalWalls);
+  write_vertices_state(os, _vertices);
+  write_binary(os, _triangles);
+  write_vertices_state(os, _vertices_vw);
+  write_binary(os, _triangles_vw);
+}
+
+/**
+ * false when the state is corrupt or does not fit the rings of the polygon,
+ * the feature is then 3dfied again
+ */
+bool TopoFeature::read_state(std::istream& is) {
+  if (read_binary(is, _p2z) == false || _p2z.size() != bg::num_interior_rings(*_p2) + 1)
+    return false;
+  if (_p2z[0].size() != bg::num_points(_p2->outer()))
+    return false;
+  for (int i = 0; i < bg::num_interior_rings(*_p2); i++) {
+    if (_p2z[i + 1].size() != bg::num_points(_p2->inners()[i]))
+      return false;
+  }
+  return read_binary(is, _bVerticalWalls) &&
+    read_vertices_state(is, _vertices) &&
+    read_binary(is, _triangles) &&
+    read_vertices_state(is, _vertices_vw) &&
+    read_binary(is, _triangles_vw);
+}
+
+//-- the coordinates of the vertices, their keys are made again when read
+void TopoFeature::write_vertices_state(std::ostream& os, const std::vector< std::pair<Point3, std::string> >& vertices) {
+  std::vector<double> xyz;
+  xyz.reserve(3 * vertices.size());
+  for (auto& v : vertices) {
+    xyz.push_back(v.first.get<0>());
+    xyz.push_back(v.first.get<1>());
+    xyz.push_back(v.first.get<2>());
+  }
+  write_binary(os, xyz);
+}
+
+bool TopoFeature::read_vertices_state(std::istream& is, std::vector< std::pair<Point3, std::string> >& vertices) {
+  std::vector<double> xyz;
+  if (read_binary(is, xyz) == false || xyz.size() % 3 != 0)
+    return false;
+  vertices.clear();
+  vertices.reserve(xyz.size() / 3);
+  for (std::size_t i = 0; i < xyz.size(); i += 3) {
+    Point3 p(xyz[i], xyz[i + 1], xyz[i + 2]);
+    vertices.push_back(std::make_pair(p, gen_key_bucket(&p)));
+  }
+  return true;
+}
+
+/**
+ * add the bytes held by the feature to its subsystems: the input polygon with
+ * its attributes, the elevations collected for its vertices and the triangles
+ */
+void TopoFeature::add_memory_usage(Metrics::MemoryUsage& usage) {
+  unsigned long long polygon = sizeof(*this) + _id.capacity() + _layername.capacity() + _p2xy.bytes();
+  polygon += _p2->outer().capacity() * sizeof(Point2);
+  for (auto& iring : _p2->inners())
+    polygon += sizeof(Ring2) + iring.capacity() * sizeof(Point2);
+  for (auto& ring : _p2z)
+    polygon += sizeof(ring) + ring.capacity() * sizeof(int);
+  //-- a node of the map is about four pointers
+  for (auto& a : _attributes)
+    polygon += 4 * sizeof(void*) + sizeof(a) + a.first.capacity() + a.second.second.capacity();
+  polygon += _adjFeatures->capacity() * sizeof(TopoFeature*);
+  usage["polygons"] += polygon;
+
+  unsigned long long lidarelevs = _lidarelevs.capacity() * sizeof(_lidarelevs[0]);
+  for (auto& ring : _lidarelevs) {
+    lidarelevs += ring.capacity() * sizeof(ring[0]);
+    for (auto& v : ring)
+      lidarelevs += v.capacity() * sizeof(int);
+  }
+  usage["lidarelevs"] += lidarelevs;
+
+  unsigned long long triangulations = (_triangles.capacity() + _triangles_vw.capacity()) * sizeof(Triangle);
+  triangulations += (_vertices.capacity() + _vertices_vw.capacity()) * sizeof(_vertices[0]);
+  for (auto& v : _vertices)
+    triangulations += v.second.capacity();
+  for (auto& v : _vertices_vw)
+    triangulations += v.second.capacity();
+  usage["triangulations"] += triangulations;
+}
+
+void TopoFeature::get_triangle_as_gml_surfacemember(TextWriter& of, Triangle& t, bool verticalwall) {
   of << "<gml:surfaceMember>";
   of << "<gml:Polygon>";
   of << "<gml:exterior>";
@@ -1107,7 +1344,7 @@ void TopoFeature::get_triangle_as_gml_surfacemember(std::wostream& of, Triangle&
   of << "</gml:surfaceMember>";
 }
 
-void TopoFeature::get_floor_triangle_as_gml_surfacemember(std::wostream& of, Triangle& t, int baseheight) {
+void TopoFeature::get_floor_triangle_as_gml_surfacemember(TextWriter& of, Triangle& t, int baseheight) {
   of << "<gml:surfaceMember>";
   of << "<gml:Polygon>";
   of << "<gml:exterior>";
@@ -1129,7 +1366,7 @@ void TopoFeature::get_floor_triangle_as_gml_surfacemember(std::wostream& of, Tri
   of << "</gml:surfaceMember>";
 }
 
-void TopoFeature::get_triangle_as_gml_triangle(std::wostream& of, Triangle& t, bool verticalwall) {
+void TopoFeature::get_triangle_as_gml_triangle(TextWriter& of, Triangle& t, bool verticalwall) {
   of << "<gml:Triangle>";
   of << "<gml:exterior>";
   of << "<gml:LinearRing>";
@@ -1272,6 +1509,25 @@ void TopoFeature::lift_each_boundary_vertices(float percentile) {
 Flat::Flat(char* wkt, std::string layername, AttributeMap attributes, std::string pid)
   : TopoFeature(wkt, layername, attributes, pid) {}
 
+void Flat::add_memory_usage(Metrics::MemoryUsage& usage) {
+  TopoFeature::add_memory_usage(usage);
+  usage["zvaluesinside"] += _zvaluesinside.capacity() * sizeof(int);
+}
+
+void Flat::reset() {
+  TopoFeature::reset();
+  _zvaluesinside.clear();
+}
+
+void Flat::write_state(std::ostream& os) {
+  TopoFeature::write_state(os);
+  write_binary(os, _height_top);
+}
+
+bool Flat::read_state(std::istream& is) {
+  return TopoFeature::read_state(is) && read_binary(is, _height_top);
+}
+
 int Flat::get_number_vertices() {
   // return int(2 * _vertices.size());
   return (int(_vertices.size()) + int(_vertices_vw.size()));
@@ -1375,24 +1631,30 @@ void Boundary3D::detect_outliers(bool flatten, float max_outlier_fraction){
         z.push_back(_p2z[ringi][i]);
       }
 
-      std::vector<double> xtmp = x, ytmp = y, ztmp = z;
+      // the fit is built once and downdated for every removed outlier instead of refitted
+      polyfit3d_downdatable<double> fit(x0, y0);
+      for (int i = 0; i < ring.size(); i++) {
+        fit.Add(x[i], y[i], z[i]);
+      }
 
       int niter = _p2z[ringi].size() - 6;
       std::vector<int> indices;
+      std::vector<double> absResiduals;
       double se = 0;
       for (int i = 0; i < niter; i++) {
-        // Fit the model
-        std::vector<double> correctedvalues;
-        polyfit3d<double>(xtmp, ytmp, ztmp, x0, y0, coeffs, correctedvalues);
-        std::vector<double> residuals, absResiduals;
+        // Get the model for the remaining vertices
+        fit.Coefficients(coeffs);
+        std::vector<double> residuals;
+        absResiduals.clear();
 
         double sum = 0;
-        for (int j = 0; j < correctedvalues.size(); j++) {
-          absResiduals.push_back(abs(ztmp[j] - correctedvalues[j]));
+        for (int j = 0; j < idx.size(); j++) {
+          int v = idx[j];
+          double res = z[v] - fit.Evaluate(coeffs, x[v], y[v]);
+          absResiduals.push_back(abs(res));
           if (i == 0) {
-            double z = ztmp[j] - correctedvalues[j];
-            residuals.push_back(z);
-            sum += z;
+            residuals.push_back(res);
+            sum += res;
           }
         }
         if (i == 0) {
@@ -1419,11 +1681,15 @@ void Boundary3D::detect_outliers(bool flatten, float max_outlier_fraction){
           // store the index of the vertex marked as an outlier
           indices.push_back(vtx);
 
-          // remove the outlier from idx, xtmp, xtmp and xtmp arrays for next iteration
+          // remove the outlier from idx and from the fit for next iteration
           idx.erase(idx.begin() + imax);
-          xtmp.erase(xtmp.begin() + imax);
-          ytmp.erase(ytmp.begin() + imax);
-          ztmp.erase(ztmp.begin() + imax);
+          if (!fit.Remove(x[vtx], y[vtx], z[vtx])) {
+            // downdate is numerically unstable, refit the remaining vertices
+            fit.Clear();
+            for (int v : idx) {
+              fit.Add(x[v], y[v], z[v]);
+            }
+          }
         }
         else {
           break;
@@ -1464,6 +1730,16 @@ TIN::TIN(char* wkt, std::string layername, AttributeMap attributes, std::string
   _innerbuffer = innerbuffer;
 }
 
+void TIN::add_memory_usage(Metrics::MemoryUsage& usage) {
+  TopoFeature::add_memory_usage(usage);
+  usage["lidarpts"] += _lidarpts.capacity() * sizeof(Point3);
+}
+
+void TIN::reset() {
+  TopoFeature::reset();
+  _lidarpts.clear();
+}
+
 int TIN::get_number_vertices() {
   return (int(_vertices.size()) + int(_vertices_vw.size()));
 }
@@ -1499,3 +1775,31 @@ void TIN::cleanup_elevations() {
 bool TIN::buildCDT() {
   return getCDT(_p2, _p2z, _vertices, _triangles, _lidarpts, _simplification_tinsimp);
 }
+
+/**
+ * build one CDT for all the TIN features with their boundaries as constraints
+ * the triangles are split back into the _vertices and _triangles of each feature
+ */
+bool TIN::buildCDT_multiple(const std::vector<TIN*>& tins) {
+  std::vector<Polygon2*> pgns;
+  std::vector< const std::vector< std::vector<int> >* > zs;
+  std::vector< const std::vector<Point3>* > lidarpts;
+  std::vector<double> thresholds;
+  std::vector< std::vector< std::pair<Point3, std::string> >* > vertices;
+  std::vector< std::vector<Triangle>* > triangles;
+  for (auto& t : tins) {
+    pgns.push_back(t->_p2);
+    zs.push_back(&t->_p2z);
+    lidarpts.push_back(&t->_lidarpts);
+    thresholds.push_back(t->_simplification_tinsimp);
+    vertices.push_back(&t->_vertices);
+    triangles.push_back(&t->_triangles);
+  }
+  if (getCDT_multiple(pgns, zs, lidarpts, thresholds, vertices, triangles) == false)
+    return false;
+  for (auto& t : tins) {
+    if (t->_triangles.empty())
+      std::cerr << "WARNING: object '" << t->get_id() << "' has no triangles in the single TIN." << std::endl;
+  }
+  return true;
+}
@@ -31,14 +31,17 @@
 
 #include "definitions.h"
 #include "geomtools.h"
+#include "geomkernels.h"
 #include "io.h"
+#include "Metrics.h"
 #include "polyfit.hpp"
+#include "polyfitdowndate.h"
 #include "nlohmann-json/json.hpp"
 
 class TopoFeature {
 public:
   TopoFeature(char *wkt, std::string layername, AttributeMap attributes, std::string pid);
-  ~TopoFeature();
+  virtual ~TopoFeature();
 
   virtual bool          lift() = 0;
   virtual bool          buildCDT();
@@ -47,13 +50,20 @@ public:
   virtual TopoClass     get_class() = 0;
   virtual bool          is_hard() = 0;
   virtual std::string   get_mtl() = 0;
-  virtual void          get_citygml(std::wostream& of) = 0;
+  virtual void          get_citygml(TextWriter& of) = 0;
   virtual void          get_cityjson(nlohmann::json& j, std::unordered_map<std::string, unsigned long>& dPts) = 0;
-  virtual void          get_citygml_imgeo(std::wostream& of) = 0;
+  virtual void          get_citygml_imgeo(TextWriter& of) = 0;
   virtual bool          get_shape(OGRLayer*, bool writeAttributes, const AttributeMap& extraAttributes = AttributeMap()) = 0;
+  virtual OGRFeature*   get_ogr_feature(OGRFeatureDefn* featureDefn, std::string className, bool writeAttributes, const AttributeMap& extraAttributes = AttributeMap());
   virtual void          cleanup_elevations() = 0;
+  virtual void          get_wkb(std::string& wkb, int srid = 0);
+  virtual void          add_memory_usage(Metrics::MemoryUsage& usage);
+  virtual void          reset();
+  virtual void          write_state(std::ostream& os);
+  virtual bool          read_state(std::istream& is);
 
   std::string  get_id();
+  unsigned long long get_geometry_hash();
   void         construct_vertical_walls(const NodeColumn& nc);
   void         fix_bowtie();
   void         add_adjacent_feature(TopoFeature* adjFeature);
@@ -66,6 +76,7 @@ public:
   bool         has_segment(const Point2& a, const Point2& b, int& aringi, int& api, int& bringi, int& bpi);
   bool         adjacent(Polygon2& poly);
   float        get_distance_to_boundaries(const Point2& p);
+  std::size_t  get_number_triangles();
   int          get_vertex_elevation(int ringi, int pi);
   int          get_vertex_elevation(const Point2& p);
   void         set_vertex_elevation(int ringi, int pi, int z);
@@ -75,17 +86,22 @@ public:
   bool         get_top_level();
   bool         get_multipolygon_features(OGRLayer* layer, std::string className, bool writeAttributes, const AttributeMap& extraAttributes = AttributeMap());
   bool         writeAttribute(OGRFeature* feature, OGRFeatureDefn* featureDefn, std::string name, std::string value);
+  bool         set_geometry_wkb(OGRFeature* feature);
   void         get_obj(std::unordered_map< std::string, unsigned long >& dPts, std::string mtl, std::string& fs);
   void         get_stl(std::unordered_map< std::string, unsigned long >& dPts,std::string& fs);
-  void         stl_prep(std::string pointsa, std::string pointsb, std::string pointsc, std::string &fs);
+  void         stl_prep(const std::string& pointsa, const std::string& pointsb, const std::string& pointsc, std::string &fs);
+  unsigned long get_stl_binary(const Point2& offset, std::string* fs);
+  void         stl_binary_prep(const Point3& pa, const Point3& pb, const Point3& pc, const Point2& offset, std::string& fs);
+  void         get_mesh(const Point3& centre, float featureid, Mesh& mesh);
   AttributeMap& get_attributes();
-  void         get_imgeo_attributes(std::wostream& of, std::string id);
-  void         get_citygml_attributes(std::wostream& of, const AttributeMap& attributes);
+  void         get_imgeo_attributes(TextWriter& of, std::string id);
+  void         get_citygml_attributes(TextWriter& of, const AttributeMap& attributes);
   void         get_cityjson_attributes(nlohmann::json& f, const AttributeMap& attributes);
   void         cleanup_lidarelevs();
 protected:
   Polygon2*                         _p2;
   std::vector< std::vector<int> >   _p2z;
+  RingArrays                        _p2xy; //-- vertices of _p2 as x/y arrays for the geomkernels
   std::vector<TopoFeature*>*        _adjFeatures;
   std::string                       _id;
   bool                              _bVerticalWalls;
@@ -107,10 +123,14 @@ protected:
   void    lift_all_boundary_vertices_same_height(int height);
 
   void get_cityjson_geom(nlohmann::json& g, std::unordered_map<std::string, unsigned long>& dPts, std::string primitive = "MultiSurface");
-  void get_triangle_as_gml_surfacemember(std::wostream& of, Triangle& t, bool verticalwall = false);
-  void get_floor_triangle_as_gml_surfacemember(std::wostream& of, Triangle& t, int baseheight);
-  void get_triangle_as_gml_triangle(std::wostream& of, Triangle& t, bool verticalwall = false);
+  void get_triangle_as_gml_surfacemember(TextWriter& of, Triangle& t, bool verticalwall = false);
+  void get_floor_triangle_as_gml_surfacemember(TextWriter& of, Triangle& t, int baseheight);
+  void get_triangle_as_gml_triangle(TextWriter& of, Triangle& t, bool verticalwall = false);
+  void add_wkb_triangles(std::string& wkb, const std::vector< std::pair<Point3, std::string> >& vertices, const std::vector<Triangle>& triangles, bool ewkb, const float* z = NULL, bool reverse = false);
+  void add_mesh_triangles(const std::vector< std::pair<Point3, std::string> >& vertices, const std::vector<Triangle>& triangles, const Point3& centre, float featureid, Mesh& mesh, const float* z = NULL, bool reverse = false);
   bool get_attribute(std::string attributeName, std::string &attribute, std::string defaultValue = "");
+  static void write_vertices_state(std::ostream& os, const std::vector< std::pair<Point3, std::string> >& vertices);
+  static bool read_vertices_state(std::istream& is, std::vector< std::pair<Point3, std::string> >& vertices);
 };
 
 //---------------------------------------------
@@ -124,9 +144,13 @@ public:
   virtual TopoClass   get_class() = 0;
   virtual bool        is_hard() = 0;
   virtual bool        lift() = 0;
-  virtual void        get_citygml(std::wostream& of) = 0;
+  virtual void        get_citygml(TextWriter& of) = 0;
   virtual void        get_cityjson(nlohmann::json& j, std::unordered_map<std::string, unsigned long>& dPts) = 0;
   virtual void        cleanup_elevations() = 0;
+  virtual void        add_memory_usage(Metrics::MemoryUsage& usage);
+  virtual void        reset();
+  virtual void        write_state(std::ostream& os);
+  virtual bool        read_state(std::istream& is);
 protected:
   std::vector<int>    _zvaluesinside;
   int                  _height_top;
@@ -143,7 +167,7 @@ public:
   virtual TopoClass    get_class() = 0;
   virtual bool         is_hard() = 0;
   virtual bool         lift() = 0;
-  virtual void         get_citygml(std::wostream& of) = 0;
+  virtual void         get_citygml(TextWriter& of) = 0;
   virtual void         get_cityjson(nlohmann::json& j, std::unordered_map<std::string, unsigned long>& dPts) = 0;
   virtual void         cleanup_elevations() = 0;
   void                 detect_outliers(bool replace_all, float max_outlier_fraction=0.2);
@@ -162,10 +186,13 @@ public:
   virtual TopoClass   get_class() = 0;
   virtual bool        is_hard() = 0;
   virtual bool        lift() = 0;
-  virtual void        get_citygml(std::wostream& of) = 0;
+  virtual void        get_citygml(TextWriter& of) = 0;
   virtual void        get_cityjson(nlohmann::json& j, std::unordered_map<std::string, unsigned long>& dPts) = 0;
   virtual void        cleanup_elevations() = 0;
   bool                buildCDT();
+  static bool         buildCDT_multiple(const std::vector<TIN*>& tins);
+  void                add_memory_usage(Metrics::MemoryUsage& usage);
+  void                reset();
 protected:
   int                 _simplification;
   double              _simplification_tinsimp;
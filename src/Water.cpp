@@ -71,7 +71,7 @@ void Water::get_cityjson(nlohmann::json& j, std::unordered_map<std::string,unsig
   j["CityObjects"][this->get_id()] = f;
 }
 
-void Water::get_citygml(std::wostream& of) {
+void Water::get_citygml(TextWriter& of) {
   of << "<cityObjectMember>";
   of << "<wtr:WaterBody gml:id=\"" << this->get_id() << "\">";
   get_citygml_attributes(of, _attributes);
@@ -87,7 +87,7 @@ void Water::get_citygml(std::wostream& of) {
   of << "</cityObjectMember>";
 }
 
-void Water::get_citygml_imgeo(std::wostream& of) {
+void Water::get_citygml_imgeo(TextWriter& of) {
   bool ondersteunend = _layername == "ondersteunendwaterdeel";
   of << "<cityObjectMember>";
   if (ondersteunend) {
@@ -37,6 +37,14 @@ typedef struct Triangle {
   int v2;
 } Triangle;
 
+typedef struct Mesh {
+  std::vector<float>        positions;  //-- x y z relative to a centre, float32 as in glTF
+  std::vector<float>        featureids; //-- one per vertex, float32 since glTF has no uint32 attributes, exact up to MESH_MAX_FEATURES
+  std::vector<unsigned int> indices;
+} Mesh;
+
+const std::size_t MESH_MAX_FEATURES = 1 << 24;
+
 typedef struct PolygonFile {
   std::string filename;
   std::string idfield;
@@ -51,6 +59,20 @@ typedef struct PointFile {
   int thinning = 1;
 } PointFile;
 
+//-- points held in memory as arrays of size values (not owned), see Map3d::add_points()
+//-- without return_number and number_of_returns all points are last returns
+typedef struct PointBatch {
+  const double*         x = nullptr;
+  const double*         y = nullptr;
+  const double*         z = nullptr;
+  const unsigned char*  classification = nullptr;
+  const unsigned char*  return_number = nullptr;
+  const unsigned char*  number_of_returns = nullptr;
+  std::size_t           size = 0;
+  std::string           name = "memory"; //-- the points are counted under this name in the --metrics report
+  std::vector<int>      lasomits;
+} PointBatch;
+
 typedef enum {
    BUILDING        = 0,
    WATER           = 1,
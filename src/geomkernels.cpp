@@ -0,0 +1,296 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#include "geomkernels.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+  #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define GEOMKERNELS_SSE2
+    #include <emmintrin.h>
+  #endif
+  #if defined(__GNUC__)
+    #define GEOMKERNELS_AVX2
+    #include <immintrin.h>
+  #endif
+#endif
+
+void RingArrays::build(const Polygon2& pgn) {
+  _x.clear();
+  _y.clear();
+  _start.clear();
+  std::size_t total = pgn.outer().size() + 1;
+  for (const Ring2& iring : pgn.inners())
+    total += iring.size() + 1;
+  _x.reserve(total);
+  _y.reserve(total);
+  for (int ringi = 0; ringi <= pgn.inners().size(); ringi++) {
+    const Ring2& ring = (ringi == 0) ? pgn.outer() : pgn.inners()[ringi - 1];
+    _start.push_back(int(_x.size()));
+    for (const Point2& p : ring) {
+      _x.push_back(p.x());
+      _y.push_back(p.y());
+    }
+    if (!ring.empty()) {
+      _x.push_back(ring.front().x());
+      _y.push_back(ring.front().y());
+    }
+  }
+  _start.push_back(int(_x.size()));
+}
+
+int RingArrays::num_rings() const {
+  return int(_start.size()) - 1;
+}
+
+int RingArrays::ring_size(int ringi) const {
+  int n = _start[ringi + 1] - _start[ringi];
+  return (n > 0) ? n - 1 : 0;
+}
+
+const double* RingArrays::ring_x(int ringi) const {
+  return _x.data() + _start[ringi];
+}
+
+const double* RingArrays::ring_y(int ringi) const {
+  return _y.data() + _start[ringi];
+}
+
+std::size_t RingArrays::bytes() const {
+  return (_x.capacity() + _y.capacity()) * sizeof(double) + _start.capacity() * sizeof(int);
+}
+
+//-- scalar kernels from vertex i, also used for the tail of the vectorised ones
+static int vertices_within_radius_tail(double px, double py, const double* x, const double* y, int i, int n, double sqr_radius, int* hits) {
+  int nhits = 0;
+  for (; i < n; i++) {
+    double dx = px - x[i];
+    double dy = py - y[i];
+    if (dx * dx + dy * dy <= sqr_radius)
+      hits[nhits++] = i;
+  }
+  return nhits;
+}
+
+static bool any_vertex_within_radius_tail(double px, double py, const double* x, const double* y, int i, int n, double sqr_radius) {
+  for (; i < n; i++) {
+    double dx = px - x[i];
+    double dy = py - y[i];
+    if (dx * dx + dy * dy <= sqr_radius)
+      return true;
+  }
+  return false;
+}
+
+//-- number of ring edges from edge i crossed by the ray from p to +x
+//-- based on http://stackoverflow.com/questions/217578/how-can-i-determine-whether-a-2d-point-is-within-a-polygon/2922778#2922778
+static int ring_crossings_tail(double px, double py, const double* x, const double* y, int i, int n) {
+  int crossings = 0;
+  for (; i < n; i++) {
+    //-- edge from vertex j = i to vertex i + 1
+    double xi = x[i + 1], yi = y[i + 1];
+    double xj = x[i], yj = y[i];
+    if (((yi > py) != (yj > py)) && (px < (xj - xi) * (py - yi) / (yj - yi) + xi))
+      crossings++;
+  }
+  return crossings;
+}
+
+#ifndef GEOMKERNELS_SSE2
+static int vertices_within_radius_scalar(double px, double py, const double* x, const double* y, int n, double sqr_radius, int* hits) {
+  return vertices_within_radius_tail(px, py, x, y, 0, n, sqr_radius, hits);
+}
+
+static bool any_vertex_within_radius_scalar(double px, double py, const double* x, const double* y, int n, double sqr_radius) {
+  return any_vertex_within_radius_tail(px, py, x, y, 0, n, sqr_radius);
+}
+
+static bool point_in_ring_scalar(double px, double py, const double* x, const double* y, int n) {
+  return ring_crossings_tail(px, py, x, y, 0, n) % 2 == 1;
+}
+#endif
+
+#ifdef GEOMKERNELS_SSE2
+static int vertices_within_radius_sse2(double px, double py, const double* x, const double* y, int n, double sqr_radius, int* hits) {
+  __m128d vpx = _mm_set1_pd(px);
+  __m128d vpy = _mm_set1_pd(py);
+  __m128d vr = _mm_set1_pd(sqr_radius);
+  int nhits = 0;
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d dx = _mm_sub_pd(vpx, _mm_loadu_pd(x + i));
+    __m128d dy = _mm_sub_pd(vpy, _mm_loadu_pd(y + i));
+    __m128d d = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+    int mask = _mm_movemask_pd(_mm_cmple_pd(d, vr));
+    for (int b = 0; mask != 0; b++, mask >>= 1) {
+      if (mask & 1)
+        hits[nhits++] = i + b;
+    }
+  }
+  return nhits + vertices_within_radius_tail(px, py, x, y, i, n, sqr_radius, hits + nhits);
+}
+
+static bool any_vertex_within_radius_sse2(double px, double py, const double* x, const double* y, int n, double sqr_radius) {
+  __m128d vpx = _mm_set1_pd(px);
+  __m128d vpy = _mm_set1_pd(py);
+  __m128d vr = _mm_set1_pd(sqr_radius);
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d dx = _mm_sub_pd(vpx, _mm_loadu_pd(x + i));
+    __m128d dy = _mm_sub_pd(vpy, _mm_loadu_pd(y + i));
+    __m128d d = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+    if (_mm_movemask_pd(_mm_cmple_pd(d, vr)) != 0)
+      return true;
+  }
+  return any_vertex_within_radius_tail(px, py, x, y, i, n, sqr_radius);
+}
+
+static bool point_in_ring_sse2(double px, double py, const double* x, const double* y, int n) {
+  __m128d vpx = _mm_set1_pd(px);
+  __m128d vpy = _mm_set1_pd(py);
+  int crossings = 0;
+  int i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d xi = _mm_loadu_pd(x + i + 1);
+    __m128d yi = _mm_loadu_pd(y + i + 1);
+    __m128d xj = _mm_loadu_pd(x + i);
+    __m128d yj = _mm_loadu_pd(y + i);
+    //-- edges that straddle the horizontal line through p, the others are masked out
+    __m128d straddle = _mm_xor_pd(_mm_cmpgt_pd(yi, vpy), _mm_cmpgt_pd(yj, vpy));
+    __m128d xint = _mm_add_pd(_mm_div_pd(_mm_mul_pd(_mm_sub_pd(xj, xi), _mm_sub_pd(vpy, yi)), _mm_sub_pd(yj, yi)), xi);
+    int mask = _mm_movemask_pd(_mm_and_pd(straddle, _mm_cmplt_pd(vpx, xint)));
+    crossings += (mask & 1) + (mask >> 1);
+  }
+  crossings += ring_crossings_tail(px, py, x, y, i, n);
+  return crossings % 2 == 1;
+}
+#endif
+
+#ifdef GEOMKERNELS_AVX2
+__attribute__((target("avx2")))
+static int vertices_within_radius_avx2(double px, double py, const double* x, const double* y, int n, double sqr_radius, int* hits) {
+  __m256d vpx = _mm256_set1_pd(px);
+  __m256d vpy = _mm256_set1_pd(py);
+  __m256d vr = _mm256_set1_pd(sqr_radius);
+  int nhits = 0;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d dx = _mm256_sub_pd(vpx, _mm256_loadu_pd(x + i));
+    __m256d dy = _mm256_sub_pd(vpy, _mm256_loadu_pd(y + i));
+    __m256d d = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+    int mask = _mm256_movemask_pd(_mm256_cmp_pd(d, vr, _CMP_LE_OQ));
+    for (int b = 0; mask != 0; b++, mask >>= 1) {
+      if (mask & 1)
+        hits[nhits++] = i + b;
+    }
+  }
+  return nhits + vertices_within_radius_tail(px, py, x, y, i, n, sqr_radius, hits + nhits);
+}
+
+__attribute__((target("avx2")))
+static bool any_vertex_within_radius_avx2(double px, double py, const double* x, const double* y, int n, double sqr_radius) {
+  __m256d vpx = _mm256_set1_pd(px);
+  __m256d vpy = _mm256_set1_pd(py);
+  __m256d vr = _mm256_set1_pd(sqr_radius);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d dx = _mm256_sub_pd(vpx, _mm256_loadu_pd(x + i));
+    __m256d dy = _mm256_sub_pd(vpy, _mm256_loadu_pd(y + i));
+    __m256d d = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+    if (_mm256_movemask_pd(_mm256_cmp_pd(d, vr, _CMP_LE_OQ)) != 0)
+      return true;
+  }
+  return any_vertex_within_radius_tail(px, py, x, y, i, n, sqr_radius);
+}
+
+__attribute__((target("avx2")))
+static bool point_in_ring_avx2(double px, double py, const double* x, const double* y, int n) {
+  __m256d vpx = _mm256_set1_pd(px);
+  __m256d vpy = _mm256_set1_pd(py);
+  int crossings = 0;
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d xi = _mm256_loadu_pd(x + i + 1);
+    __m256d yi = _mm256_loadu_pd(y + i + 1);
+    __m256d xj = _mm256_loadu_pd(x + i);
+    __m256d yj = _mm256_loadu_pd(y + i);
+    //-- edges that straddle the horizontal line through p, the others are masked out
+    __m256d straddle = _mm256_xor_pd(_mm256_cmp_pd(yi, vpy, _CMP_GT_OQ), _mm256_cmp_pd(yj, vpy, _CMP_GT_OQ));
+    __m256d xint = _mm256_add_pd(_mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(xj, xi), _mm256_sub_pd(vpy, yi)), _mm256_sub_pd(yj, yi)), xi);
+    int mask = _mm256_movemask_pd(_mm256_and_pd(straddle, _mm256_cmp_pd(vpx, xint, _CMP_LT_OQ)));
+    crossings += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + (mask >> 3);
+  }
+  crossings += ring_crossings_tail(px, py, x, y, i, n);
+  return crossings % 2 == 1;
+}
+#endif
+
+//-- the kernels are selected once, based on the instruction sets of the cpu
+struct GeomKernels {
+  int (*vertices_within_radius)(double, double, const double*, const double*, int, double, int*);
+  bool (*any_vertex_within_radius)(double, double, const double*, const double*, int, double);
+  bool (*point_in_ring)(double, double, const double*, const double*, int);
+  std::string name;
+};
+
+static GeomKernels select_kernels() {
+#ifdef GEOMKERNELS_AVX2
+  __builtin_cpu_init(); //-- runs before the constructors, see the gcc manual
+  if (__builtin_cpu_supports("avx2"))
+    return GeomKernels{ vertices_within_radius_avx2, any_vertex_within_radius_avx2, point_in_ring_avx2, "AVX2" };
+#endif
+#ifdef GEOMKERNELS_SSE2
+  return GeomKernels{ vertices_within_radius_sse2, any_vertex_within_radius_sse2, point_in_ring_sse2, "SSE2" };
+#else
+  return GeomKernels{ vertices_within_radius_scalar, any_vertex_within_radius_scalar, point_in_ring_scalar, "scalar" };
+#endif
+}
+
+static const GeomKernels kernels = select_kernels();
+
+/**
+ * collect the indices of the n vertices within sqr_radius of p in hits
+ * hits must have room for n indices, returns the number of hits
+ */
+int vertices_within_radius(double px, double py, const double* x, const double* y, int n, double sqr_radius, int* hits) {
+  return kernels.vertices_within_radius(px, py, x, y, n, sqr_radius, hits);
+}
+
+bool any_vertex_within_radius(double px, double py, const double* x, const double* y, int n, double sqr_radius) {
+  return kernels.any_vertex_within_radius(px, py, x, y, n, sqr_radius);
+}
+
+/**
+ * crossing test of p against a closed ring of n vertices (n + 1 values in x and y)
+ */
+bool point_in_ring(double px, double py, const double* x, const double* y, int n) {
+  return kernels.point_in_ring(px, py, x, y, n);
+}
+
+std::string get_kernels_name() {
+  return kernels.name;
+}
@@ -0,0 +1,65 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+/**
+ * geomkernels are the point-vertex distance and point-in-polygon tests used
+ * when assigning the points of the point cloud to the polygons
+ * each test runs over the vertices of a ring stored as contiguous x/y arrays
+ * and is vectorised with SSE2 or AVX2, chosen at runtime, with a scalar fallback
+ */
+
+#ifndef geomkernels_h
+#define geomkernels_h
+
+#include "definitions.h"
+
+/**
+ * vertices of a polygon as contiguous x/y arrays, outer ring first
+ * each ring is stored closed (first vertex repeated at the end) so edge i of the
+ * ring goes from vertex i to vertex i + 1
+ */
+class RingArrays {
+public:
+  void          build(const Polygon2& pgn);
+  int           num_rings() const;
+  int           ring_size(int ringi) const;
+  const double* ring_x(int ringi) const;
+  const double* ring_y(int ringi) const;
+  std::size_t   bytes() const;
+private:
+  std::vector<double> _x;
+  std::vector<double> _y;
+  std::vector<int>    _start; //-- offset of each ring in _x/_y, plus the end of the last ring
+};
+
+int         vertices_within_radius(double px, double py, const double* x, const double* y, int n, double sqr_radius, int* hits);
+bool        any_vertex_within_radius(double px, double py, const double* x, const double* y, int n, double sqr_radius);
+bool        point_in_ring(double px, double py, const double* x, const double* y, int n);
+std::string get_kernels_name();
+
+#endif /* geomkernels_h */
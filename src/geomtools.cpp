@@ -37,8 +37,11 @@
 #include <CGAL/Projection_traits_xy_3.h>
 #include <CGAL/Triangulation_vertex_base_with_id_2.h>
 #include <CGAL/Triangulation_face_base_with_info_2.h>
-#include <CGAL/Polygon_2.h>
+#include <CGAL/spatial_sort.h>
+#include <CGAL/Spatial_sort_traits_adapter_2.h>
+#include <CGAL/property_map.h>
 
+#include <cmath>
 #include <vector>
 #include <unordered_set>
 #include <boost/heap/fibonacci_heap.hpp>
@@ -70,6 +73,7 @@ struct FaceInfo2
   bool in_domain() {
     return nesting_level % 2 == 1;
   }
+  int label = -1; //-- index of the polygon the face belongs to in a multi-polygon CDT
   heap_handle_vec* points_inside = nullptr;
   CGAL::Plane_3<K>* plane = nullptr;
 };
@@ -79,7 +83,9 @@ typedef CGAL::Triangulation_data_structure_2<Vb, Fb>              Tds;
 typedef CGAL::Exact_predicates_tag                                Itag;
 typedef CGAL::Constrained_Delaunay_triangulation_2<Gt, Tds, Itag> CDT;
 typedef CDT::Point                                                Point;
-typedef CGAL::Polygon_2<Gt>                                       Polygon_2;
+typedef std::pair<Point, int>                                     IndexedPoint; //-- point with its index in the lidarpts
+typedef CGAL::Spatial_sort_traits_adapter_2<Gt,
+  CGAL::First_of_pair_property_map<IndexedPoint> >                Sort_traits;
 
 struct PointXYHash {
   std::size_t operator()(Point const& p) const noexcept {
@@ -96,21 +102,53 @@ struct PointXYEqual {
   }
 };
 
+/**
+ * scratch vectors of getCDT() and getCDT_multiple(), one per thread so their
+ * capacity is reused from one feature to the next; they are cleared at the
+ * start of each call, so no handle of a previous CDT is used
+ * the CDT itself is on the stack of the call: CGAL frees its faces and
+ * vertices in clear() anyway, keeping it would only keep the last one alive
+ */
+struct CDTScratch {
+  std::vector<Point> ring;
+  std::vector<CDT::Face_handle> queue;
+  std::vector<CDT::Edge> border;
+  std::vector<IndexedPoint> sortedpts;
+};
+
+static CDTScratch& get_cdt_scratch() {
+  static thread_local CDTScratch scratch;
+  scratch.ring.clear();
+  scratch.queue.clear();
+  scratch.border.clear();
+  scratch.sortedpts.clear();
+  return scratch;
+}
+
+//-- iterations of the greedy insertion of the last CDT of this thread
+static thread_local unsigned long greedy_iterations = 0;
+
+unsigned long get_greedy_insert_iterations() {
+  return greedy_iterations;
+}
+
 inline double compute_error(Point &p, CDT::Face_handle &face);
 void greedy_insert(CDT &T, const std::vector<Point3> &pts, double threshold);
+void greedy_insert(CDT &T, const std::vector<Point3> &pts, const std::vector<double> &thresholds);
+void spatial_sort_points(const std::vector<Point3> &pts, std::vector<IndexedPoint> &sortedpts);
 
 void mark_domains(CDT& ct,
   CDT::Face_handle start,
   int index,
-  std::list<CDT::Edge>& border) {
+  std::vector<CDT::Face_handle>& queue,
+  std::vector<CDT::Edge>& border) {
   if (start->info().nesting_level != -1) {
     return;
   }
-  std::list<CDT::Face_handle> queue;
   queue.push_back(start);
   while (!queue.empty()) {
-    CDT::Face_handle fh = queue.front();
-    queue.pop_front();
+    CDT::Face_handle fh = queue.back();
+    queue.pop_back();
     if (fh->info().nesting_level == -1) {
       fh->info().nesting_level = index;
       for (int i = 0; i < 3; i++) {
@@ -134,20 +172,21 @@ void mark_domains(CDT& ct,
  * to constrained edges bounding the former set and increase the nesting level by 1.
  * facets in the domain are those with an odd nesting level.
  */
-void mark_domains(CDT& cdt) {
+void mark_domains(CDT& cdt, CDTScratch& scratch) {
   for (CDT::All_faces_iterator it = cdt.all_faces_begin(); it != cdt.all_faces_end(); ++it) {
     it->info().nesting_level = -1;
   }
-  std::list<CDT::Edge> border;
-  mark_domains(cdt, cdt.infinite_face(), 0, border);
-  while (!border.empty()) {
-    CDT::Edge e = border.front();
-    border.pop_front();
+  std::vector<CDT::Edge>& border = scratch.border;
+  mark_domains(cdt, cdt.infinite_face(), 0, scratch.queue, border);
+  //-- border is a FIFO, walked by index so the nesting levels grow level by level
+  for (std::size_t i = 0; i < border.size(); i++) {
+    CDT::Edge e = border[i];
     CDT::Face_handle n = e.first->neighbor(e.second);
     if (n->info().nesting_level == -1) {
-      mark_domains(cdt, n, e.first->info().nesting_level + 1, border);
+      mark_domains(cdt, n, e.first->info().nesting_level + 1, scratch.queue, border);
     }
   }
+  border.clear();
 }
 
 /**
@@ -162,21 +201,17 @@ bool getCDT(Polygon2* pgn,
   const std::vector<Point3> &lidarpts,
   double tinsimp_threshold) {
   CDT cdt;
+  CDTScratch& scratch = get_cdt_scratch();
+  greedy_iterations = 0;
 
-  //-- gather all rings
-  std::vector<Ring2> rings;
-  rings.push_back(pgn->outer());
-  for (Ring2& iring : pgn->inners())
-    rings.push_back(iring);
-
-  Polygon_2 poly;
-  int ringi = -1;
-  for (Ring2& ring : rings) {
-    ringi++;
+  //-- all rings, outer ring first, without copying them
+  std::vector<Point>& poly = scratch.ring;
+  for (int ringi = 0; ringi <= pgn->inners().size(); ringi++) {
+    const Ring2& ring = (ringi == 0) ? pgn->outer() : pgn->inners()[ringi - 1];
     for (int i = 0; i < ring.size(); i++) {
       poly.push_back(Point(bg::get<0>(ring[i]), bg::get<1>(ring[i]), z_to_float(z[ringi][i])));
     }
-    cdt.insert_constraint(poly.vertices_begin(), poly.vertices_end(), true);
+    cdt.insert_constraint(poly.begin(), poly.end(), true);
     poly.clear();
   }
 
@@ -185,14 +220,18 @@ bool getCDT(Polygon2* pgn,
     if (tinsimp_threshold != 0)
       greedy_insert(cdt, lidarpts, tinsimp_threshold);
     else {
-      for (auto &pt : lidarpts) {
-        cdt.insert(Point(bg::get<0>(pt), bg::get<1>(pt), bg::get<2>(pt)));
+      //-- insert in Hilbert order, each point located starting from the face of the previous one
+      std::vector<IndexedPoint>& sortedpts = scratch.sortedpts;
+      spatial_sort_points(lidarpts, sortedpts);
+      CDT::Face_handle hint;
+      for (auto &pt : sortedpts) {
+        hint = cdt.insert(pt.first, hint)->face();
       }
     }
   }
 
   //Mark facets that are inside the domain bounded by the polygon
-  mark_domains(cdt);
+  mark_domains(cdt, scratch);
 
   unsigned index = 0;
   int count = 0;
@@ -221,24 +260,255 @@ bool getCDT(Polygon2* pgn,
   return true;
 }
 
+/**
+ * the vertices of the constraint from va to vb in the CDT, in order: va, the
+ * vertices that split it (ends of other constraints, intersections, points on
+ * it) and vb; false when the constrained sub-edges do not reach vb
+ */
+bool constraint_vertices(CDT& cdt, CDT::Vertex_handle va, CDT::Vertex_handle vb, std::vector< std::pair<CDT::Vertex_handle, double> >& chain) {
+  double dx = vb->point().x() - va->point().x();
+  double dy = vb->point().y() - va->point().y();
+  double len2 = dx * dx + dy * dy;
+  chain.clear();
+  chain.push_back(std::make_pair(va, 0.0));
+  if (len2 == 0)
+    return false;
+  CDT::Vertex_handle current = va;
+  double tcurrent = 0;
+  for (std::size_t steps = 0; current != vb && steps <= cdt.number_of_vertices(); steps++) {
+    CDT::Vertex_handle next;
+    double tnext = 2;
+    CDT::Edge_circulator ec = cdt.incident_edges(current), done(ec);
+    do {
+      if (cdt.is_infinite(ec) || !cdt.is_constrained(*ec))
+        continue;
+      CDT::Vertex_handle v = ec->first->vertex(CDT::cw(ec->second));
+      if (v == current)
+        v = ec->first->vertex(CDT::ccw(ec->second));
+      double px = v->point().x() - va->point().x();
+      double py = v->point().y() - va->point().y();
+      double t = (px * dx + py * dy) / len2;
+      //-- on the segment, up to the rounding of the intersections
+      double dist2 = (px * dy - py * dx) * (px * dy - py * dx) / len2;
+      if (t > tcurrent && t <= 1 + 1e-9 && dist2 < 1e-6 && t < tnext) {
+        next = v;
+        tnext = t;
+      }
+    } while (++ec != done);
+    if (tnext > 1 + 1e-9)
+      return false;
+    chain.push_back(std::make_pair(next, std::min(tnext, 1.0)));
+    current = next;
+    tcurrent = tnext;
+  }
+  return current == vb;
+}
+
+/**
+ * triangulate several polygons in one CDT, all their rings are constraints
+ * faces are labelled with the polygon they are in by flooding from the inside
+ * of the boundary sub-edges (ring edges split by other constraints included)
+ * up to the next constrained edge
+ * the labelled triangles are pushed to the output vectors of their polygon,
+ * boundary vertices get the height of their own polygon so jump edges are kept,
+ * the vertices splitting a ring edge get the height interpolated along it
+ */
+bool getCDT_multiple(const std::vector<Polygon2*> &pgns,
+  const std::vector< const std::vector< std::vector<int> >* > &zs,
+  const std::vector< const std::vector<Point3>* > &lidarpts,
+  const std::vector<double> &tinsimp_thresholds,
+  std::vector< std::vector< std::pair<Point3, std::string> >* > &vertices,
+  std::vector< std::vector<Triangle>* > &triangles) {
+  CDT cdt;
+  CDTScratch& scratch = get_cdt_scratch();
+  greedy_iterations = 0;
+  //-- vertex handles with their lifted height for each ring of each polygon
+  std::vector< std::vector< std::vector< std::pair<CDT::Vertex_handle, float> > > > ringvhs(pgns.size());
+
+  CDT::Face_handle hint;
+  for (int k = 0; k < pgns.size(); k++) {
+    std::vector<Ring2> rings;
+    rings.push_back(pgns[k]->outer());
+    for (Ring2& iring : pgns[k]->inners())
+      rings.push_back(iring);
+
+    int ringi = -1;
+    for (Ring2& ring : rings) {
+      ringi++;
+      std::vector< std::pair<CDT::Vertex_handle, float> > vhs;
+      for (int i = 0; i < ring.size(); i++) {
+        float z = z_to_float((*zs[k])[ringi][i]);
+        CDT::Vertex_handle vh = cdt.insert(Point(bg::get<0>(ring[i]), bg::get<1>(ring[i]), z), hint);
+        hint = vh->face();
+        vhs.push_back(std::make_pair(vh, z));
+      }
+      for (int i = 0; i < vhs.size(); i++) {
+        CDT::Vertex_handle va = vhs[i].first;
+        CDT::Vertex_handle vb = vhs[(i + 1) % vhs.size()].first;
+        if (va != vb)
+          cdt.insert_constraint(va, vb);
+      }
+      ringvhs[k].push_back(vhs);
+    }
+  }
+
+  //-- add the lidar points, the ones of polygons without tinsimp all at once and
+  //-- the others with a single greedy insertion using the threshold of their polygon
+  std::vector<Point3> allpts;
+  std::vector<Point3> greedypts;
+  std::vector<double> thresholds;
+  for (int k = 0; k < pgns.size(); k++) {
+    if (tinsimp_thresholds[k] != 0) {
+      greedypts.insert(greedypts.end(), lidarpts[k]->begin(), lidarpts[k]->end());
+      thresholds.insert(thresholds.end(), lidarpts[k]->size(), tinsimp_thresholds[k]);
+    }
+    else
+      allpts.insert(allpts.end(), lidarpts[k]->begin(), lidarpts[k]->end());
+  }
+  if (allpts.size() > 0) {
+    std::vector<IndexedPoint>& sortedpts = scratch.sortedpts;
+    spatial_sort_points(allpts, sortedpts);
+    for (auto &pt : sortedpts) {
+      hint = cdt.insert(pt.first, hint)->face();
+    }
+  }
+  if (greedypts.size() > 0)
+    greedy_insert(cdt, greedypts, thresholds);
+
+  if (!cdt.is_valid()) {
+    throw std::runtime_error("CDT is invalid.");
+  }
+
+  //-- label the faces
+  for (CDT::All_faces_iterator it = cdt.all_faces_begin(); it != cdt.all_faces_end(); ++it) {
+    it->info().label = -1;
+  }
+  auto orientation = cdt.geom_traits().orientation_2_object();
+  std::vector<CDT::Face_handle>& queue = scratch.queue;
+  //-- vertices splitting the ring edges of each polygon, with the height interpolated along the edge
+  std::vector< std::vector< std::pair<CDT::Vertex_handle, float> > > splitvhs(pgns.size());
+  std::vector< std::pair<CDT::Vertex_handle, double> > chain;
+  for (int k = 0; k < pgns.size(); k++) {
+    for (auto& vhs : ringvhs[k]) {
+      for (int i = 0; i < vhs.size(); i++) {
+        CDT::Vertex_handle va = vhs[i].first;
+        CDT::Vertex_handle vb = vhs[(i + 1) % vhs.size()].first;
+        if (va == vb || constraint_vertices(cdt, va, vb, chain) == false)
+          continue;
+        float za = vhs[i].second;
+        float zb = vhs[(i + 1) % vhs.size()].second;
+        for (std::size_t c = 1; c + 1 < chain.size(); c++)
+          splitvhs[k].push_back(std::make_pair(chain[c].first, float(za + chain[c].second * (zb - za))));
+        for (std::size_t c = 0; c + 1 < chain.size(); c++) {
+          CDT::Vertex_handle ca = chain[c].first;
+          CDT::Vertex_handle cb = chain[c + 1].first;
+          CDT::Face_handle fh;
+          int ei;
+          if (!cdt.is_edge(ca, cb, fh, ei))
+            continue;
+          //-- the interior of the polygon is right of each ring edge (cw outer ring, ccw inner rings)
+          if (cdt.is_infinite(fh) || orientation(ca->point(), cb->point(), fh->vertex(ei)->point()) != CGAL::RIGHT_TURN)
+            fh = fh->neighbor(ei);
+          if (cdt.is_infinite(fh) || fh->info().label != -1)
+            continue;
+          fh->info().label = k;
+          queue.push_back(fh);
+          while (!queue.empty()) {
+            CDT::Face_handle f = queue.back();
+            queue.pop_back();
+            for (int j = 0; j < 3; j++) {
+              CDT::Face_handle n = f->neighbor(j);
+              if (n->info().label == -1 && !cdt.is_infinite(n) && !cdt.is_constrained(CDT::Edge(f, j))) {
+                n->info().label = k;
+                queue.push_back(n);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  //-- split the labelled triangles per polygon
+  std::vector< std::vector<CDT::Face_handle> > faces(pgns.size());
+  for (CDT::Finite_faces_iterator fit = cdt.finite_faces_begin();
+    fit != cdt.finite_faces_end(); ++fit) {
+    if (fit->info().label != -1)
+      faces[fit->info().label].push_back(fit);
+  }
+  for (CDT::Finite_vertices_iterator vit = cdt.finite_vertices_begin();
+    vit != cdt.finite_vertices_end(); ++vit) {
+    vit->id() = -1;
+  }
+  //-- vertex id is the index in the output of the current polygon, reset after each polygon
+  std::vector<CDT::Vertex_handle> used;
+  for (int k = 0; k < pgns.size(); k++) {
+    for (auto& vhs : ringvhs[k]) {
+      for (auto& vz : vhs) {
+        if (vz.first->id() == -1) {
+          Point3 p = Point3(vz.first->point().x(), vz.first->point().y(), vz.second);
+          vz.first->id() = vertices[k]->size();
+          vertices[k]->push_back(std::make_pair(p, gen_key_bucket(&p)));
+          used.push_back(vz.first);
+        }
+      }
+    }
+    for (auto& vz : splitvhs[k]) {
+      if (vz.first->id() == -1) {
+        Point3 p = Point3(vz.first->point().x(), vz.first->point().y(), vz.second);
+        vz.first->id() = vertices[k]->size();
+        vertices[k]->push_back(std::make_pair(p, gen_key_bucket(&p)));
+        used.push_back(vz.first);
+      }
+    }
+    for (auto& fh : faces[k]) {
+      for (int j = 0; j < 3; j++) {
+        CDT::Vertex_handle v = fh->vertex(j);
+        if (v->id() == -1) {
+          Point3 p = Point3(v->point().x(), v->point().y(), v->point().z());
+          v->id() = vertices[k]->size();
+          vertices[k]->push_back(std::make_pair(p, gen_key_bucket(&p)));
+          used.push_back(v);
+        }
+      }
+      Triangle t;
+      t.v0 = fh->vertex(0)->id();
+      t.v1 = fh->vertex(1)->id();
+      t.v2 = fh->vertex(2)->id();
+      triangles[k]->push_back(t);
+    }
+    for (auto& v : used) {
+      v->id() = -1;
+    }
+    used.clear();
+  }
+  return true;
+}
+
 std::string gen_key_bucket(const Point2* p) {
-  std::stringstream ss;
+  TextWriter ss;
   ss << std::fixed << std::setprecision(3) << p->get<0>() << " " << p->get<1>();
   return ss.str();
 }
 
 std::string gen_key_bucket(const Point3* p) {
-  std::stringstream ss;
+  TextWriter ss;
   ss << std::fixed << std::setprecision(3) << p->get<0>() << " " << p->get<1>() << " " << std::setprecision(2) << p->get<2>();
   return ss.str();
 }
 
 std::string gen_key_bucket(const Point3* p, float z) {
-  std::stringstream ss;
+  TextWriter ss;
   ss << std::fixed << std::setprecision(3) << p->get<0>() << " " << p->get<1>() << " " << std::setprecision(2) << z;
   return ss.str();
 }
 
+//-- x and y in mm: for two vertices of a flat surface they are equal when their
+//-- gen_key_bucket() at that height are equal, except at rounding ties
+std::pair<long long, long long> xy_mm(const Point3& p) {
+  return std::make_pair(std::llround(p.get<0>() * 1000.0), std::llround(p.get<1>() * 1000.0));
+}
+
 double distance(const Point2 &p1, const Point2 &p2) {
   double dx = p1.x() - p2.x();
   double dy = p1.y() - p2.y();
@@ -251,6 +521,48 @@ double sqr_distance(const Point2 &p1, const Point2 &p2) {
   return dx * dx + dy * dy;
 }
 
+/**
+ * index of p on a Hilbert curve of 2^16 x 2^16 cells over box,
+ * sorting with it keeps features that are close together
+ */
+uint64_t hilbert_index(const Point2 &p, const Box2 &box) {
+  const uint32_t n = 1 << 16;
+  double w = bg::get<bg::max_corner, 0>(box) - bg::get<bg::min_corner, 0>(box);
+  double h = bg::get<bg::max_corner, 1>(box) - bg::get<bg::min_corner, 1>(box);
+  uint32_t x = w > 0 ? uint32_t(std::min(n - 1.0, std::max(0.0, (p.x() - bg::get<bg::min_corner, 0>(box)) / w * n))) : 0;
+  uint32_t y = h > 0 ? uint32_t(std::min(n - 1.0, std::max(0.0, (p.y() - bg::get<bg::min_corner, 1>(box)) / h * n))) : 0;
+  uint64_t d = 0;
+  for (uint32_t s = n / 2; s > 0; s /= 2) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+    d += uint64_t(s) * s * ((3 * rx) ^ ry);
+    //-- rotate the quadrant
+    if (ry == 0) {
+      if (rx == 1) {
+        x = s - 1 - x;
+        y = s - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+/**
+ * sort the points along a Hilbert curve (CGAL::spatial_sort)
+ * consecutive points are close to each other so point location can start
+ * from the face found for the previous point instead of walking from scratch
+ * the index of each point in the input vector is kept with the point
+ */
+void spatial_sort_points(const std::vector<Point3> &pts, std::vector<IndexedPoint> &sortedpts) {
+  sortedpts.clear();
+  sortedpts.reserve(pts.size());
+  for (int i = 0; i < pts.size(); i++) {
+    sortedpts.push_back(std::make_pair(Point(bg::get<0>(pts[i]), bg::get<1>(pts[i]), bg::get<2>(pts[i])), i));
+  }
+  CGAL::spatial_sort(sortedpts.begin(), sortedpts.end(), Sort_traits());
+}
+
 //--- TIN Simplification
 // Greedy insertion/incremental refinement algorithm adapted from "Fast polygonal approximation of terrain and height fields" by Garland, Michael and Heckbert, Paul S.
 inline double compute_error(Point &p, CDT::Face_handle &face) {
@@ -269,19 +581,30 @@ inline double compute_error(Point &p, CDT::Face_handle &face) {
 }
 
 void greedy_insert(CDT &T, const std::vector<Point3> &pts, double threshold) {
+  greedy_insert(T, pts, std::vector<double>(pts.size(), threshold));
+}
+
+// thresholds holds the threshold of each point, the heap stores the error relative to it
+// so points of polygons with different thresholds can be inserted in the same triangulation
+void greedy_insert(CDT &T, const std::vector<Point3> &pts, const std::vector<double> &thresholds) {
   // assumes all lidar points are inside a triangle
   Heap heap;
 
   // compute initial point errors, build heap, store point indices in triangles
+  // points are visited in Hilbert order so each locate starts from the previous face
   {
-    for (int i = 0; i < pts.size(); i++) {
-      Point p = Point(bg::get<0>(pts[i]), bg::get<1>(pts[i]), bg::get<2>(pts[i]));
+    std::vector<IndexedPoint> sortedpts;
+    spatial_sort_points(pts, sortedpts);
+    CDT::Face_handle hint;
+    for (auto &sp : sortedpts) {
+      Point p = sp.first;
       CDT::Locate_type lt;
       int li;
-      CDT::Face_handle face = T.locate(p, lt, li);
+      CDT::Face_handle face = T.locate(p, lt, li, hint);
       if (lt == CDT::FACE) {
-        double e = compute_error(p, face);
-        auto handle = heap.push(point_error(i, e, p));
+        hint = face;
+        double e = compute_error(p, face) / thresholds[sp.second];
+        auto handle = heap.push(point_error(sp.second, e, p));
         face->info().points_inside->push_back(handle);
       }
       else {
@@ -304,7 +627,8 @@ void greedy_insert(CDT &T, const std::vector<Point3> &pts, double threshold) {
   }
   
   // insert points, update errors of affected triangles until threshold error is reached
-  while (!heap.empty() && heap.top().error > threshold){
+  while (!heap.empty() && heap.top().error > 1.0){
+    greedy_iterations++;
     // get top element (with largest error) from heap
     point_error maxelement = heap.top();
     auto max_p = maxelement.point;
@@ -379,7 +703,7 @@ void greedy_insert(CDT &T, const std::vector<Point3> &pts, double threshold) {
       int li;
       CDT::Face_handle containing_face = T.locate(p, lt, li, face_hint);
       if (lt == CDT::EDGE || lt == CDT::FACE) {
-        element.error = compute_error(p, containing_face);
+        element.error = compute_error(p, containing_face) / thresholds[element.index];
         heap.update(curelement, element);
         containing_face->info().points_inside->push_back(curelement);
       }
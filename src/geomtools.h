@@ -31,18 +31,28 @@
 
 #include "definitions.h"
 #include <random>
+#include <cstdint>
 
 std::string gen_key_bucket(const Point2* p);
 std::string gen_key_bucket(const Point3* p);
 std::string gen_key_bucket(const Point3* p, float z);
+std::pair<long long, long long> xy_mm(const Point3& p);
 
 double distance(const Point2 &p1, const Point2 &p2);
 double sqr_distance(const Point2 &p1, const Point2 &p2);
+uint64_t hilbert_index(const Point2 &p, const Box2 &box);
 bool   getCDT(Polygon2* pgn,
             const std::vector< std::vector<int> > &z, 
             std::vector< std::pair<Point3, std::string> > &vertices, 
             std::vector<Triangle> &triangles, 
             const std::vector<Point3> &lidarpts = std::vector<Point3>(),
             double tinsimp_threshold=0);
+unsigned long get_greedy_insert_iterations();
+bool   getCDT_multiple(const std::vector<Polygon2*> &pgns,
+            const std::vector< const std::vector< std::vector<int> >* > &zs,
+            const std::vector< const std::vector<Point3>* > &lidarpts,
+            const std::vector<double> &tinsimp_thresholds,
+            std::vector< std::vector< std::pair<Point3, std::string> >* > &vertices,
+            std::vector< std::vector<Triangle>* > &triangles);
 
 #endif /* geomtools_h */
@@ -31,8 +31,9 @@
   */
 
 #include "io.h"
+#include <cstring>
 
-void printProgressBar(int percent) {
+void printProgressBar(int percent, const std::string& info) {
   std::string bar;
   for (int i = 0; i < 50; i++) {
     if (i < (percent / 2)) {
@@ -47,14 +48,24 @@ void printProgressBar(int percent) {
   }
   std::clog << "\r" "[" << bar << "] ";
   std::clog.width(3);
-  std::clog << percent << "%     " << std::flush;
+  std::clog << percent << "%  " << info << "     " << std::flush;
 }
 
-void get_xml_header(std::wostream& of) {
+void print_duration(std::string message, boost::chrono::time_point<boost::chrono::steady_clock> startTime) {
+  auto duration = boost::chrono::high_resolution_clock::now() - startTime;
+  printf(message.c_str(),
+    boost::chrono::duration_cast<boost::chrono::seconds>(duration).count(),
+    boost::chrono::duration_cast<boost::chrono::hours>(duration).count(),
+    boost::chrono::duration_cast<boost::chrono::minutes>(duration).count() % 60,
+    (int)boost::chrono::duration_cast<boost::chrono::seconds>(duration).count() % 60
+  );
+}
+
+void get_xml_header(TextWriter& of) {
   of << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
 }
 
-void get_citygml_namespaces(std::wostream& of) {
+void get_citygml_namespaces(TextWriter& of) {
   of << "<CityModel xmlns=\"http://www.opengis.net/citygml/2.0\"\n";
   of << "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n";
   of << "xmlns:xAL=\"urn:oasis:names:tc:ciq:xsdschema:xAL:2.0\"\n";
@@ -74,7 +85,7 @@ void get_citygml_namespaces(std::wostream& of) {
   of << "xsi:schemaLocation=\"http://www.opengis.net/citygml/2.0 http://schemas.opengis.net/citygml/profiles/base/2.0/CityGML.xsd\">\n";
 }
 
-void get_citygml_imgeo_namespaces(std::wostream& of) {
+void get_citygml_imgeo_namespaces(TextWriter& of) {
   of << "<CityModel xmlns=\"http://www.opengis.net/citygml/2.0\"\n";
   of << "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\"\n";
   of << "xmlns:xAL=\"urn:oasis:names:tc:ciq:xsdschema:xAL:2.0\"\n";
@@ -95,7 +106,7 @@ void get_citygml_imgeo_namespaces(std::wostream& of) {
   of << "xsi:schemaLocation=\"http://www.opengis.net/citygml/2.0 http://schemas.opengis.net/citygml/2.0/cityGMLBase.xsd http://www.geostandaarden.nl/imgeo/2.1 http://schemas.geonovum.nl/imgeo/2.1/imgeo-2.1.1.xsd\">\n";
 }
 
-void get_polygon_lifted_gml(std::wostream& of, Polygon2* p2, double height, bool reverse) {
+void get_polygon_lifted_gml(TextWriter& of, Polygon2* p2, double height, bool reverse) {
   if (reverse)
     bg::reverse(*p2);
   of << "<gml:surfaceMember>";
@@ -130,7 +141,7 @@ void get_polygon_lifted_gml(std::wostream& of, Polygon2* p2, double height, bool
     bg::reverse(*p2);
 }
 
-void get_extruded_line_gml(std::wostream& of, Point2* a, Point2* b, double high, double low, bool reverse) {
+void get_extruded_line_gml(TextWriter& of, Point2* a, Point2* b, double high, double low, bool reverse) {
   of << "<gml:surfaceMember>";
   of << "<gml:Polygon>";
   of << "<gml:exterior>";
@@ -148,7 +159,7 @@ void get_extruded_line_gml(std::wostream& of, Point2* a, Point2* b, double high,
   of << "</gml:surfaceMember>";
 }
 
-void get_extruded_lod1_block_gml(std::wostream& of, Polygon2* p2, double high, double low, bool building_include_floor) {
+void get_extruded_lod1_block_gml(TextWriter& of, Polygon2* p2, double high, double low, bool building_include_floor) {
   if (building_include_floor) {
     //-- get floor
     get_polygon_lifted_gml(of, p2, low, false);
@@ -196,7 +207,41 @@ std::vector<std::string> stringsplit(std::string str, char delimiter) {
    return elems;
 }
 
-std::wostream& operator<< (std::wostream& of, const std::string& str) {
-  std::copy(str.begin(), str.end(), std::ostream_iterator<char, wchar_t>(of));
-  return of;
+/**
+ * start a little-endian WKB MultiPolygonZ with 0 polygons, as EWKB with
+ * the SRID if srid > 0; the polygons are appended after it
+ */
+void wkb_begin_multipolygon(std::string& wkb, int srid) {
+  uint32_t type = (srid > 0) ? (6 | 0x80000000 | 0x20000000) : 1006;
+  uint32_t count = 0;
+  wkb.push_back(1);
+  wkb.append(reinterpret_cast<const char*>(&type), 4);
+  if (srid > 0) {
+    uint32_t s = uint32_t(srid);
+    wkb.append(reinterpret_cast<const char*>(&s), 4);
+  }
+  wkb.append(reinterpret_cast<const char*>(&count), 4);
+}
+
+/**
+ * add n to the number of geometries of the collection at the start of wkb
+ */
+void wkb_add_count(std::string& wkb, uint32_t n) {
+  uint32_t type, count;
+  std::memcpy(&type, &wkb[1], 4);
+  std::size_t offset = (type & 0x20000000) ? 9 : 5;
+  std::memcpy(&count, &wkb[offset], 4);
+  count += n;
+  std::memcpy(&wkb[offset], &count, 4);
+}
+
+void append_hex(std::string& out, const std::string& bytes) {
+  static const char digits[] = "0123456789ABCDEF";
+  std::size_t offset = out.size();
+  out.resize(offset + 2 * bytes.size());
+  for (std::size_t i = 0; i < bytes.size(); i++) {
+    unsigned char b = (unsigned char)bytes[i];
+    out[offset + 2 * i] = digits[b >> 4];
+    out[offset + 2 * i + 1] = digits[b & 15];
+  }
 }
@@ -30,27 +30,249 @@
 #define INPUT_H
 
 #include "definitions.h"
+#include "TextWriter.h"
 #include "TopoFeature.h"
+#include "boost/chrono.hpp"
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
 
-void printProgressBar(int percent);
-void get_xml_header(std::wostream& of);
-void get_citygml_namespaces(std::wostream& of);
-void get_citygml_imgeo_namespaces(std::wostream& of);
+void printProgressBar(int percent, const std::string& info = "");
+void print_duration(std::string message, boost::chrono::time_point<boost::chrono::steady_clock> startTime);
+void get_xml_header(TextWriter& of);
+void get_citygml_namespaces(TextWriter& of);
+void get_citygml_imgeo_namespaces(TextWriter& of);
 
-void get_polygon_lifted_gml(std::wostream& of, Polygon2* p2, double height, bool reverse = false);
-void get_extruded_line_gml(std::wostream& of, Point2* a, Point2* b, double high, double low, bool reverse = false);
-void get_extruded_lod1_block_gml(std::wostream& of, Polygon2* p2, double high, double low = 0.0, bool building_include_floor = false);
+void get_polygon_lifted_gml(TextWriter& of, Polygon2* p2, double height, bool reverse = false);
+void get_extruded_line_gml(TextWriter& of, Point2* a, Point2* b, double high, double low, bool reverse = false);
+void get_extruded_lod1_block_gml(TextWriter& of, Polygon2* p2, double high, double low = 0.0, bool building_include_floor = false);
 
 bool  is_string_integer(std::string s, int min = 0, int max = 1e6);
 float z_to_float(int z);
 std::vector<std::string> stringsplit(std::string str, char delimiter);
-std::wostream& operator<< (std::wostream& of, const std::string& str);
+void  wkb_begin_multipolygon(std::string& wkb, int srid = 0);
+void  wkb_add_count(std::string& wkb, uint32_t n);
+void  append_hex(std::string& out, const std::string& bytes);
 
-template<class I, class E, class S>
-struct codecvt : std::codecvt<I, E, S>
-{
-    ~codecvt()
-    { }
+/**
+ * binary values, vectors and strings of the state file (see Map3d::write_state()),
+ * in the byte order of the machine; vectors and strings are preceded by their size
+ * the read functions return false at the end of the stream or on a corrupt size
+ */
+template<typename T>
+inline void write_binary(std::ostream& os, const T& value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+inline bool read_binary(std::istream& is, T& value) {
+  return (bool)is.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+inline void write_binary(std::ostream& os, const std::string& s) {
+  write_binary(os, (uint64_t)s.size());
+  os.write(s.data(), s.size());
+}
+
+inline bool read_binary(std::istream& is, std::string& s) {
+  uint64_t n;
+  if (read_binary(is, n) == false || n > (1ull << 32))
+    return false;
+  s.resize(n);
+  return n == 0 || (bool)is.read(&s[0], n);
+}
+
+template<typename T>
+inline void write_binary(std::ostream& os, const std::vector<T>& values) {
+  write_binary(os, (uint64_t)values.size());
+  if (values.empty() == false)
+    os.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template<typename T>
+inline bool read_binary(std::istream& is, std::vector<T>& values) {
+  uint64_t n;
+  if (read_binary(is, n) == false || n > (1ull << 32) / sizeof(T))
+    return false;
+  values.resize(n);
+  return n == 0 || (bool)is.read(reinterpret_cast<char*>(values.data()), n * sizeof(T));
+}
+
+template<typename T>
+inline void write_binary(std::ostream& os, const std::vector< std::vector<T> >& values) {
+  write_binary(os, (uint64_t)values.size());
+  for (auto& each : values)
+    write_binary(os, each);
+}
+
+template<typename T>
+inline bool read_binary(std::istream& is, std::vector< std::vector<T> >& values) {
+  uint64_t n;
+  if (read_binary(is, n) == false || n > (1ull << 32))
+    return false;
+  values.resize(n);
+  for (auto& each : values) {
+    if (read_binary(is, each) == false)
+      return false;
+  }
+  return true;
+}
+
+inline void write_binary(std::ostream& os, const std::vector<std::string>& values) {
+  write_binary(os, (uint64_t)values.size());
+  for (auto& each : values)
+    write_binary(os, each);
+}
+
+inline bool read_binary(std::istream& is, std::vector<std::string>& values) {
+  uint64_t n;
+  if (read_binary(is, n) == false || n > (1ull << 32))
+    return false;
+  values.resize(n);
+  for (auto& each : values) {
+    if (read_binary(is, each) == false)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * true in the threads started by parallel_for() and parallel_ordered(),
+ * nested calls then run in the calling thread
+ */
+inline bool& in_parallel_region() {
+  static thread_local bool nested = false;
+  return nested;
+}
+
+/**
+ * run fn(begin, end) over [0, n) with one contiguous range per thread
+ */
+inline void parallel_for(std::size_t n, const std::function<void(std::size_t, std::size_t)>& fn) {
+  if (in_parallel_region()) {
+    if (n > 0)
+      fn(0, n);
+    return;
+  }
+  std::size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t chunk = (n + nthreads - 1) / nthreads;
+  std::vector<std::thread> threads;
+  for (std::size_t begin = 0; begin < n; begin += chunk) {
+    std::size_t end = std::min(n, begin + chunk);
+    threads.push_back(std::thread([&fn, begin, end]() {
+      in_parallel_region() = true;
+      fn(begin, end);
+    }));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+/**
+ * bytes the buffers of one batch of parallel_ordered() may hold, 0 for no limit
+ * (see Map3d::check_memory()); over it the next batches get fewer items
+ */
+inline std::atomic<unsigned long long>& parallel_buffer_budget() {
+  static std::atomic<unsigned long long> budget(0);
+  return budget;
+}
+
+/**
+ * largest batch of buffers of parallel_ordered() so far in bytes, for the memory report
+ */
+inline std::atomic<unsigned long long>& parallel_buffer_peak() {
+  static std::atomic<unsigned long long> peak(0);
+  return peak;
+}
+
+//-- bytes held by a buffer of parallel_ordered(), 0 when not known
+template<typename Buffer>
+inline std::size_t buffer_bytes(const Buffer&) {
+  return 0;
+}
+
+inline std::size_t buffer_bytes(const std::string& buffer) {
+  return buffer.capacity();
+}
+
+inline std::size_t buffer_bytes(const std::vector<std::string>& buffer) {
+  std::size_t bytes = buffer.capacity() * sizeof(std::string);
+  for (auto& s : buffer)
+    bytes += s.capacity();
+  return bytes;
+}
+
+inline std::size_t buffer_bytes(const Mesh& mesh) {
+  return (mesh.positions.capacity() + mesh.featureids.capacity()) * sizeof(float) + mesh.indices.capacity() * sizeof(unsigned int);
+}
+
+//-- what Map3d::get_outputs() renders for a range of features: the text of each format and the STL facets per class
+struct OutputsBuffer {
+  std::string sink[7];
+  std::string stl[7];
 };
 
+inline std::size_t buffer_bytes(const OutputsBuffer& buffer) {
+  std::size_t bytes = 0;
+  for (int i = 0; i < 7; i++)
+    bytes += buffer.sink[i].capacity() + buffer.stl[i].capacity();
+  return bytes;
+}
+
+/**
+ * render the items [0, n) in parallel and write them in their original order
+ * render(begin, end, buffer) renders a contiguous range of items in a buffer of
+ * its thread, write(begin, end, buffer) is then called for the ranges in order
+ * items are done in batches so only one batch of output is kept in memory
+ */
+template<typename Buffer>
+void parallel_ordered(std::size_t n,
+  const std::function<void(std::size_t, std::size_t, Buffer&)>& render,
+  const std::function<void(std::size_t, std::size_t, Buffer&)>& write,
+  std::size_t chunk = 256) {
+  if (in_parallel_region()) {
+    for (std::size_t begin = 0; begin < n; begin += chunk) {
+      Buffer buffer;
+      render(begin, std::min(n, begin + chunk), buffer);
+      write(begin, std::min(n, begin + chunk), buffer);
+    }
+    return;
+  }
+  std::size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<Buffer> buffers(nthreads);
+  for (std::size_t batch = 0; batch < n; ) {
+    std::size_t next = std::min(n, batch + nthreads * chunk);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < nthreads && batch + t * chunk < n; t++) {
+      buffers[t] = Buffer();
+      std::size_t begin = batch + t * chunk;
+      std::size_t end = std::min(n, batch + (t + 1) * chunk);
+      Buffer& buffer = buffers[t];
+      threads.push_back(std::thread([&render, &buffer, begin, end]() {
+        in_parallel_region() = true;
+        render(begin, end, buffer);
+      }));
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    unsigned long long bytes = 0;
+    for (std::size_t t = 0; t < threads.size(); t++) {
+      bytes += buffer_bytes(buffers[t]);
+      write(batch + t * chunk, std::min(n, batch + (t + 1) * chunk), buffers[t]);
+      buffers[t] = Buffer();
+    }
+    unsigned long long peak = parallel_buffer_peak();
+    while (bytes > peak && !parallel_buffer_peak().compare_exchange_weak(peak, bytes)) {}
+    //-- over the budget the next batches are smaller, so they are written sooner
+    unsigned long long budget = parallel_buffer_budget();
+    if (budget > 0 && bytes > budget && chunk > 1)
+      chunk = std::max<std::size_t>(1, (std::size_t)(chunk * (double(budget) / bytes)));
+    batch = next;
+  }
+}
+
 #endif
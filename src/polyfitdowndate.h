@@ -0,0 +1,179 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+#ifndef polyfitdowndate_h
+#define polyfitdowndate_h
+
+#include <cmath>
+#include <vector>
+
+/*
+Least squares fit of the polynomial surface of combineXY() (polyfit.hpp) kept up to
+date while points are removed, used to remove outliers one by one without
+refitting. The upper triangular R of the QR decomposition of A and d = Qt*z are
+built with Givens rotations one row at a time. Removing a point downdates R and d
+with Givens rotations (LINPACK dchdd) in O(p^2) instead of a full refit.
+
+Coordinates are relative to x0, y0 like in polyfit3d().
+*/
+template<typename T>
+class polyfit3d_downdatable {
+public:
+  static const int nCols = 6;
+
+  polyfit3d_downdatable(T x0, T y0) : m_x0(x0), m_y0(y0) {
+    Clear();
+  }
+
+  void Clear() {
+    for (int i = 0; i < nCols; i++) {
+      m_d[i] = 0;
+      for (int j = 0; j < nCols; j++) {
+        m_R[i][j] = 0;
+      }
+    }
+  }
+
+  // Add the point to the fit, rotating its row into R.
+  void Add(T x, T y, T z) {
+    T a[nCols];
+    Row(x, y, a);
+    for (int j = 0; j < nCols; j++) {
+      if (a[j] == 0) {
+        continue;
+      }
+      T h = std::sqrt(m_R[j][j] * m_R[j][j] + a[j] * a[j]);
+      T c = m_R[j][j] / h;
+      T s = a[j] / h;
+      m_R[j][j] = h;
+      for (int k = j + 1; k < nCols; k++) {
+        T t = c * m_R[j][k] + s * a[k];
+        a[k] = c * a[k] - s * m_R[j][k];
+        m_R[j][k] = t;
+      }
+      T t = c * m_d[j] + s * z;
+      z = c * z - s * m_d[j];
+      m_d[j] = t;
+    }
+  }
+
+  // Remove a point that was added before. Returns false if the downdate is
+  // numerically impossible, the fit is then left untouched and has to be rebuilt.
+  bool Remove(T x, T y, T z) {
+    T a[nCols], c[nCols], s[nCols];
+    Row(x, y, a);
+
+    // solve trans(R)*s = a
+    T norm = 0;
+    for (int j = 0; j < nCols; j++) {
+      if (m_R[j][j] == 0) {
+        return false;
+      }
+      s[j] = a[j];
+      for (int i = 0; i < j; i++) {
+        s[j] -= m_R[i][j] * s[i];
+      }
+      s[j] /= m_R[j][j];
+      norm += s[j] * s[j];
+    }
+    if (norm >= 1 - 1e-12) {
+      return false;
+    }
+
+    // determine the rotations
+    T alpha = std::sqrt(1 - norm);
+    for (int i = nCols - 1; i >= 0; i--) {
+      T scale = alpha + std::fabs(s[i]);
+      T ca = alpha / scale;
+      T sb = s[i] / scale;
+      T n = std::sqrt(ca * ca + sb * sb);
+      c[i] = ca / n;
+      s[i] = sb / n;
+      alpha = scale * n;
+    }
+
+    // apply the rotations to R and d
+    for (int j = 0; j < nCols; j++) {
+      T xx = 0;
+      for (int i = j; i >= 0; i--) {
+        T t = c[i] * xx + s[i] * m_R[i][j];
+        m_R[i][j] = c[i] * m_R[i][j] - s[i] * xx;
+        xx = t;
+      }
+    }
+    T zeta = z;
+    for (int i = 0; i < nCols; i++) {
+      m_d[i] = (m_d[i] - s[i] * zeta) / c[i];
+      zeta = c[i] * zeta - s[i] * m_d[i];
+    }
+    return true;
+  }
+
+  // Solve R*coeffs = d, a singular column gets a zero coefficient.
+  void Coefficients(std::vector<T>& coeffs) {
+    coeffs.assign(nCols, 0);
+    for (int i = nCols - 1; i >= 0; i--) {
+      if (m_R[i][i] == 0) {
+        continue;
+      }
+      T v = m_d[i];
+      for (int j = i + 1; j < nCols; j++) {
+        v -= coeffs[j] * m_R[i][j];
+      }
+      coeffs[i] = v / m_R[i][i];
+    }
+  }
+
+  T Evaluate(const std::vector<T>& coeffs, T x, T y) {
+    T a[nCols];
+    Row(x, y, a);
+    T v = 0;
+    for (int j = 0; j < nCols; j++) {
+      v += coeffs[j] * a[j];
+    }
+    return v;
+  }
+
+private:
+  void Row(T x, T y, T* a) {
+    x -= m_x0;
+    y -= m_y0;
+    a[0] = 1;
+    a[1] = x;
+    a[2] = y;
+    a[3] = x * y;
+    a[4] = x * x;
+    a[5] = y * y;
+  }
+
+  T m_x0, m_y0;
+  T m_R[nCols][nCols];
+  T m_d[nCols];
+};
+
+#endif
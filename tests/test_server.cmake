@@ -0,0 +1,71 @@
+# 3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+# Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+# This file is part of 3dfier, distributed under the GNU General Public License,
+# see the header of the source files.
+
+# test of --server: on synthetic data of 3dfier_generate, the reply of the
+# server for an extent must be the CityJSON of a batch run with that extent;
+# a first request of another extent is made so features kept in memory between
+# requests are tested too
+#   cmake -DTHREEDFIER=3dfier -DGENERATE=3dfier_generate -DWORKDIR=dir -P test_server.cmake
+
+set( EXTENT_OTHER "85000,445000,85080,445080" )
+set( EXTENT "85040,445040,85160,445160" )
+
+file( REMOVE_RECURSE ${WORKDIR} )
+execute_process(
+  COMMAND ${GENERATE} --output ${WORKDIR} --area 0.04 --format las --threads 1
+  RESULT_VARIABLE result
+)
+if ( NOT result EQUAL 0 )
+  message( FATAL_ERROR "3dfier_generate failed: ${result}" )
+endif()
+
+#-- the batch run, with the extent in the options of the config
+file( READ ${WORKDIR}/config.yml config )
+file( WRITE ${WORKDIR}/config_extent.yml "${config}  extent: ${EXTENT}\n" )
+execute_process(
+  COMMAND ${THREEDFIER} config_extent.yml --CityJSON batch.json
+  WORKING_DIRECTORY ${WORKDIR}
+  RESULT_VARIABLE result
+)
+if ( NOT result EQUAL 0 )
+  message( FATAL_ERROR "3dfier with extent ${EXTENT} failed: ${result}" )
+endif()
+
+#-- the server, the reply of each request is a JSON line followed by the output
+file( WRITE ${WORKDIR}/requests.txt
+  "{\"id\": 1, \"extent\": [${EXTENT_OTHER}], \"format\": \"CityJSON\"}\n"
+  "{\"id\": 2, \"extent\": [${EXTENT}], \"format\": \"CityJSON\"}\n"
+)
+execute_process(
+  COMMAND ${THREEDFIER} config.yml --server
+  WORKING_DIRECTORY ${WORKDIR}
+  INPUT_FILE ${WORKDIR}/requests.txt
+  OUTPUT_FILE ${WORKDIR}/replies.txt
+  RESULT_VARIABLE result
+)
+if ( NOT result EQUAL 0 )
+  message( FATAL_ERROR "3dfier --server failed: ${result}" )
+endif()
+
+file( READ ${WORKDIR}/replies.txt replies )
+file( READ ${WORKDIR}/batch.json batch )
+string( LENGTH "${batch}" batchlength )
+string( FIND "${replies}" "{\"bytes\":${batchlength}," start REVERSE )
+if ( start EQUAL -1 )
+  message( FATAL_ERROR "no reply of ${batchlength} bytes like the batch output:\n${replies}" )
+endif()
+string( SUBSTRING "${replies}" ${start} -1 reply )
+string( FIND "${reply}" "\n" eol )
+string( SUBSTRING "${reply}" 0 ${eol} header )
+math( EXPR eol "${eol} + 1" )
+string( SUBSTRING "${reply}" ${eol} ${batchlength} output )
+if ( NOT header MATCHES "\"id\":2" OR NOT header MATCHES "\"status\":\"ok\"" )
+  message( FATAL_ERROR "unexpected reply: ${header}" )
+endif()
+if ( NOT output STREQUAL batch )
+  file( WRITE ${WORKDIR}/server.json "${output}" )
+  message( FATAL_ERROR "the reply of the server differs from the batch run, see ${WORKDIR}/server.json and batch.json" )
+endif()
+message( STATUS "server reply of ${batchlength} bytes is the same as the batch run" )
@@ -0,0 +1,153 @@
+/*
+  3dfier: takes 2D GIS datasets and "3dfies" to create 3D city models.
+  
+  Copyright (C) 2015-2020 3D geoinformation research group, TU Delft
+
+  This file is part of 3dfier.
+
+  3dfier is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  3dfier is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with 3difer.  If not, see <http://www.gnu.org/licenses/>.
+
+  For any information or further details about the use of 3dfier, contact
+  Hugo Ledoux 
+  <h.ledoux@tudelft.nl>
+  Faculty of Architecture & the Built Environment
+  Delft University of Technology
+  Julianalaan 134, Delft 2628BL, the Netherlands
+*/
+
+/**
+ * tests of getCDT_multiple(), the single TIN of the Terrain and Forest features:
+ * polygons whose ring edges are split by the vertices of their neighbours
+ * must keep all their triangles, and the vertices splitting an edge get the
+ * height interpolated along the edge of each polygon
+ */
+
+#include "definitions.h"
+#include "geomtools.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+  printf("%s %s\n", ok ? "ok  " : "FAIL", what.c_str());
+  if (!ok)
+    failures++;
+}
+
+static Polygon2* polygon(const std::string& wkt) {
+  Polygon2* p = new Polygon2();
+  bg::read_wkt(wkt, *p);
+  bg::unique(*p);
+  bg::correct(*p);
+  return p;
+}
+
+//-- the heights of the rings of p in cm, from a function of x and y in m
+static std::vector< std::vector<int> > heights(Polygon2* p, double (*z)(double, double)) {
+  std::vector< std::vector<int> > zs;
+  std::vector<Ring2> rings(1, p->outer());
+  rings.insert(rings.end(), p->inners().begin(), p->inners().end());
+  for (auto& ring : rings) {
+    zs.push_back(std::vector<int>());
+    for (auto& pt : ring)
+      zs.back().push_back(int(std::round(100 * z(bg::get<0>(pt), bg::get<1>(pt)))));
+  }
+  return zs;
+}
+
+static double area(const std::vector< std::pair<Point3, std::string> >& vertices, const std::vector<Triangle>& triangles) {
+  double total = 0;
+  for (auto& t : triangles) {
+    const Point3& a = vertices[t.v0].first;
+    const Point3& b = vertices[t.v1].first;
+    const Point3& c = vertices[t.v2].first;
+    total += std::abs((bg::get<0>(b) - bg::get<0>(a)) * (bg::get<1>(c) - bg::get<1>(a)) -
+      (bg::get<0>(c) - bg::get<0>(a)) * (bg::get<1>(b) - bg::get<1>(a))) / 2;
+  }
+  return total;
+}
+
+//-- the height of the vertex at (x, y), NAN when there is none
+static double height_at(const std::vector< std::pair<Point3, std::string> >& vertices, double x, double y) {
+  for (auto& v : vertices) {
+    if (std::abs(bg::get<0>(v.first) - x) < 1e-6 && std::abs(bg::get<1>(v.first) - y) < 1e-6)
+      return bg::get<2>(v.first);
+  }
+  return NAN;
+}
+
+static double slope_x(double x, double) { return x / 5; }
+static double slope_y(double, double y) { return y / 5; }
+static double flat_5(double, double) { return 5; }
+
+/**
+ * triangulate the polygons in one CDT and check the area of the triangles of
+ * each polygon, returns the vertices of each polygon
+ */
+static std::vector< std::vector< std::pair<Point3, std::string> > > triangulate(const std::string& name,
+  const std::vector<Polygon2*>& pgns, const std::vector< std::vector< std::vector<int> > >& zs, const std::vector<double>& areas) {
+  std::vector< const std::vector< std::vector<int> >* > zsp;
+  std::vector<Point3> nopts;
+  std::vector< const std::vector<Point3>* > lidarpts;
+  std::vector< std::vector< std::pair<Point3, std::string> > > vertices(pgns.size());
+  std::vector< std::vector<Triangle> > triangles(pgns.size());
+  std::vector< std::vector< std::pair<Point3, std::string> >* > verticesp;
+  std::vector< std::vector<Triangle>* > trianglesp;
+  for (std::size_t k = 0; k < pgns.size(); k++) {
+    zsp.push_back(&zs[k]);
+    lidarpts.push_back(&nopts);
+    verticesp.push_back(&vertices[k]);
+    trianglesp.push_back(&triangles[k]);
+  }
+  getCDT_multiple(pgns, zsp, lidarpts, std::vector<double>(pgns.size(), 0), verticesp, trianglesp);
+  for (std::size_t k = 0; k < pgns.size(); k++) {
+    double a = area(vertices[k], triangles[k]);
+    check(std::abs(a - areas[k]) < 1e-6, name + ": area of polygon " + std::to_string(k) + " is " + std::to_string(a) + ", expected " + std::to_string(areas[k]));
+  }
+  return vertices;
+}
+
+int main() {
+  //-- two squares sharing a part of an edge, each splits the edge of the other
+  {
+    std::vector<Polygon2*> pgns{
+      polygon("POLYGON((0 0,10 0,10 10,0 10,0 0))"),
+      polygon("POLYGON((10 5,20 5,20 15,10 15,10 5))") };
+    std::vector< std::vector< std::vector<int> > > zs{ heights(pgns[0], slope_y), heights(pgns[1], flat_5) };
+    auto vertices = triangulate("partly shared edge", pgns, zs, { 100, 100 });
+    check(std::abs(height_at(vertices[0], 10, 5) - 1) < 0.01, "partly shared edge: (10 5) interpolated on the first square");
+    check(std::abs(height_at(vertices[1], 10, 10) - 5) < 0.01, "partly shared edge: (10 10) interpolated on the second square");
+    for (auto p : pgns)
+      delete p;
+  }
+  //-- a square with each edge split by a vertex of the polygon around it
+  {
+    std::vector<Polygon2*> pgns{
+      polygon("POLYGON((0 0,10 0,10 10,0 10,0 0))"),
+      polygon("POLYGON((-10 -10,20 -10,20 20,-10 20,-10 -10),(0 0,0 5,0 10,5 10,10 10,10 5,10 0,5 0,0 0))") };
+    std::vector< std::vector< std::vector<int> > > zs{ heights(pgns[0], slope_x), heights(pgns[1], flat_5) };
+    auto vertices = triangulate("all edges split", pgns, zs, { 100, 800 });
+    check(std::abs(height_at(vertices[0], 5, 0) - 1) < 0.01, "all edges split: (5 0) interpolated on the square");
+    check(std::abs(height_at(vertices[1], 5, 0) - 5) < 0.01, "all edges split: (5 0) of the polygon around");
+    for (auto p : pgns)
+      delete p;
+  }
+  if (failures > 0) {
+    printf("%d checks failed\n", failures);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}